@@ -5,6 +5,8 @@ from matplotlib.ticker import ScalarFormatter
 import argparse
 import sys
 from pathlib import Path
+from scipy import stats as sps
+from scipy.optimize import least_squares
 
 # Timer runs at 100 MHz
 TIMER_FREQ_MHZ = 100.0
@@ -18,6 +20,9 @@ DDR4_BANDWIDTH_BS = DDR4_BANDWIDTH_GBS * 1e9  # Convert to bytes/s
 # Cache line size on Cortex-A53/R5F
 CACHE_LINE_SIZE = 64  # bytes
 
+# The R5 D-cache line, what Xil_DCacheInvalidateRange actually walks
+RPU_CACHE_LINE_SIZE = 32  # bytes
+
 # Rough latency estimates based on ARM specs (in nanoseconds)
 DRAM_ACCESS_LATENCY_NS = 100  # Per DRAM access
 CACHE_HIT_LATENCY_NS = 10     # L1 cache hit
@@ -25,12 +30,30 @@ CCI_SNOOP_LATENCY_NS = 50     # CCI snoop operation
 SOFTWARE_OVERHEAD_NS = 200    # Function calls, polling, etc.
 
 
+def read_run_header(filename):
+    """Parse the '# key=value' calibration lines apu_sender_ddr writes first."""
+    header = {}
+    with open(filename) as f:
+        for line in f:
+            if not line.startswith('#'):
+                break
+            key, sep, value = line[1:].strip().partition('=')
+            if not sep:
+                continue
+            try:
+                header[key] = float(value)
+            except ValueError:
+                header[key] = value
+    return header
+
+
 def load_data(filename):
     """Load and validate the CSV data."""
     print(f"Loading data from {filename}...")
     
     try:
-        df = pd.read_csv(filename)
+        header = read_run_header(filename)
+        df = pd.read_csv(filename, comment='#')
     except Exception as e:
         print(f"Error loading file: {e}")
         sys.exit(1)
@@ -53,9 +76,53 @@ def load_data(filename):
         print(f"Warning: Filtered out {initial_count - filtered_count} invalid entries")
     
     print(f"Loaded {filtered_count} valid measurements")
+    df.attrs['run_header'] = header
     return df
 
 
+def measurement_bias_us(header, mode):
+    """
+    Fixed cost to take off every delta_us, from the run header.
+    
+    'timer': each timestamp lands somewhere inside its own timer read, on
+    average half way, so half an APU read plus half an RPU read is counted
+    on top of the real interval.
+    'empty-loop': median delta of the zero-size calibration packets, i.e.
+    the whole fixed protocol cost (doorbell, poll, both timer reads).
+    """
+    if mode == 'timer':
+        keys = ['apu_timer_read_ticks_mean', 'rpu_timer_read_ticks_mean']
+        if not all(k in header for k in keys):
+            return None
+        return (header[keys[0]] + header[keys[1]]) / 2 / TIMER_FREQ_MHZ
+    if mode == 'empty-loop':
+        return header.get('empty_loop_us_median')
+    return 0.0
+
+
+def print_run_header(header):
+    """Show the calibration results recorded with the run."""
+    if not header:
+        print("\nNo run header (older result file), no calibration data")
+        return
+    
+    print("\n" + "="*70)
+    print("RUN CALIBRATION")
+    print("="*70)
+    for side in ('apu', 'rpu'):
+        key = f'{side}_timer_read_ticks_mean'
+        if key in header:
+            print(f"{side.upper()} timer read: {header[key]:.3f} ticks mean, "
+                  f"std {header[f'{side}_timer_read_ticks_std']:.3f}, "
+                  f"min {int(header[f'{side}_timer_read_ticks_min'])}, "
+                  f"max {int(header[f'{side}_timer_read_ticks_max'])}")
+    if 'empty_loop_us_median' in header:
+        print(f"Empty loop: {header['empty_loop_us_median']:.3f} us median, "
+              f"{header['empty_loop_us_mean']:.3f} mean, std {header['empty_loop_us_std']:.3f}, "
+              f"min {header['empty_loop_us_min']:.3f} "
+              f"({int(header['empty_loop_samples'])} packets)")
+
+
 def compute_statistics(df):
     """Compute stats for each packet size."""
     print("\nComputing statistics...")
@@ -78,7 +145,188 @@ def compute_statistics(df):
     return stats
 
 
-def theoretical_coherent_time(packet_size):
+# Counter columns apu_sender_ddr -p writes, in CSV order
+APU_PMU_COLUMNS = ['apu_l1d_refill', 'apu_l2d_refill', 'apu_bus_access',
+                   'apu_stall_cycles', 'apu_dtlb_refill']
+RPU_INV_PMU_COLUMNS = ['rpu_inv_cycles', 'rpu_inv_dcache_miss',
+                       'rpu_inv_ext_mem_req', 'rpu_inv_lsu_stall']
+RPU_READ_PMU_COLUMNS = ['rpu_read_cycles', 'rpu_read_dcache_miss',
+                        'rpu_read_ext_mem_req', 'rpu_read_lsu_stall']
+PMU_COLUMNS = APU_PMU_COLUMNS + RPU_INV_PMU_COLUMNS + RPU_READ_PMU_COLUMNS
+
+
+def pmu_columns(df):
+    """
+    PMU counter columns written by apu_sender_ddr -p (empty if not sampled).
+
+    The RPU invalidate counters only exist in -p runs, so they decide
+    whether the run was sampled. Older runs may lack some APU counters.
+    """
+    if not all(c in df.columns for c in RPU_INV_PMU_COLUMNS):
+        return []
+    return [c for c in PMU_COLUMNS if c in df.columns]
+
+
+def compute_pmu_correlation(df):
+    """
+    Spearman correlation of every PMU counter with latency, per packet size.
+
+    Rank correlation because the counters and the latency are both heavy
+    tailed, we care about "more misses -> slower", not about linearity.
+    Counters that weren't available are written as -1 and skipped.
+    """
+    counters = pmu_columns(df)
+    rows = []
+
+    for size, group in df.groupby('packet_size'):
+        row = {'packet_size': size}
+        for c in counters:
+            valid = group[group[c] >= 0]
+            # Constant counters (e.g. always 0) have no meaningful correlation
+            if len(valid) < 3 or valid[c].nunique() < 2 or valid['delta_us'].nunique() < 2:
+                row[c] = np.nan
+                continue
+            rho, _ = sps.spearmanr(valid[c], valid['delta_us'])
+            row[c] = rho
+        rows.append(row)
+
+    return pd.DataFrame(rows)
+
+
+def print_pmu_summary(df, corr):
+    """Show mean counter values and which counters track latency best."""
+    counters = pmu_columns(df)
+
+    print("\n" + "="*70)
+    print("PMU COUNTERS vs LATENCY (Spearman rho, per packet size)")
+    print("="*70)
+
+    available = [c for c in counters if df[c].max() >= 0]
+    values = df[available].where(df[available] >= 0)
+    values['packet_size'] = df['packet_size']
+    means = values.groupby('packet_size')[available].mean()
+
+    for c in counters:
+        if c not in available:
+            print(f"{c:<24} not available")
+            continue
+        col = corr[c]
+        if col.isna().all():
+            print(f"{c:<24} constant, no correlation")
+            continue
+        best = corr.loc[col.abs().idxmax()]
+        print(f"{c:<24} mean rho = {col.mean():+.2f}   "
+              f"strongest at {int(best['packet_size'])} B (rho = {best[c]:+.2f})")
+
+    print("\nMean counter values per packet size:")
+    print(means.round(1).to_string())
+    print("="*70)
+
+
+def first_byte_medians(df):
+    """Median time-to-first-byte and total latency per size, -1 = not recorded."""
+    cols = ['ttfb_us', 'total_us']
+    values = df[cols].where(df[cols] >= 0)
+    values['packet_size'] = df['packet_size']
+    return values.groupby('packet_size')[cols].median()
+
+
+def print_first_byte_summary(df, baseline=None):
+    """
+    Time-to-first-byte and total latency, optionally next to a baseline run.
+
+    Both are measured from the start of the APU copy, so a streamed run (-s)
+    and a monolithic one line up even though their delta_us don't.
+    """
+    current = first_byte_medians(df)
+
+    print("\n" + "="*70)
+    print("TIME TO FIRST BYTE / TOTAL LATENCY (median, us)")
+    print("="*70)
+
+    if baseline is None:
+        print(f"{'Size':<10} {'TTFB':>12} {'Total':>12}")
+        for size, row in current.iterrows():
+            print(f"{size:<10} {row['ttfb_us']:>12.3f} {row['total_us']:>12.3f}")
+    else:
+        base = first_byte_medians(baseline)
+        both = base.join(current, lsuffix='_base', how='inner')
+        print(f"{'Size':<10} {'TTFB base':>12} {'TTFB':>12} {'Total base':>12} {'Total':>12} {'Speedup':>8}")
+        for size, row in both.iterrows():
+            speedup = row['total_us_base'] / row['total_us'] if row['total_us'] > 0 else np.nan
+            print(f"{size:<10} {row['ttfb_us_base']:>12.3f} {row['ttfb_us']:>12.3f} "
+                  f"{row['total_us_base']:>12.3f} {row['total_us']:>12.3f} {speedup:>7.2f}x")
+    print("="*70)
+
+
+# Sweep order used by apu_sender_ddr -m
+MEM_ATTR_ORDER = ['wb', 'wt', 'nc', 'device', 'so']
+
+
+def mem_attr_matrix(df):
+    """Median latency per packet size (rows) and RPU memory attribute (columns)."""
+    matrix = df.pivot_table(index='packet_size', columns='mem_attr',
+                            values='delta_us', aggfunc='median')
+    cols = [c for c in MEM_ATTR_ORDER if c in matrix.columns]
+    return matrix[cols + [c for c in matrix.columns if c not in cols]]
+
+
+def print_mem_attr_matrix(matrix):
+    """
+    Show which attribute wins per size.
+
+    In -m runs the RPU reads the payload while timed, so cached modes pay
+    for the invalidate and uncached ones for the slow reads.
+    """
+    print("\n" + "="*70)
+    print("RPU MEMORY ATTRIBUTE MATRIX (median us, invalidate + read)")
+    print("="*70)
+    print(f"{'Size':<10}" + "".join(f"{c:>10}" for c in matrix.columns) + f"{'Best':>10}")
+    for size, row in matrix.iterrows():
+        cells = "".join(f"{v:>10.3f}" for v in row.values)
+        print(f"{size:<10}{cells}{row.idxmin():>10}")
+
+    if 'wb' in matrix.columns:
+        uncached = [c for c in ('nc', 'device', 'so') if c in matrix.columns]
+        if uncached:
+            wins = matrix[uncached].min(axis=1) < matrix['wb']
+            if wins.any():
+                print(f"\nSkipping the cache beats invalidating for: "
+                      f"{', '.join(str(s) for s in matrix.index[wins])} B")
+            else:
+                print("\nInvalidating cached memory wins at every size")
+    print("="*70)
+
+
+def plot_pmu_correlation(corr, output_prefix="perf"):
+    """Heatmap of rho, counters x packet size."""
+    data = corr.set_index('packet_size').T
+    data = data[data.notna().any(axis=1)]
+    if data.empty:
+        print("No PMU counter varied enough to correlate, skipping heatmap")
+        return
+
+    fig, ax = plt.subplots(figsize=(14, 0.5 * len(data) + 2))
+    im = ax.imshow(data.values.astype(float), cmap='RdBu_r', vmin=-1, vmax=1, aspect='auto')
+
+    ax.set_xticks(range(data.shape[1]))
+    ax.set_xticklabels([f"{int(s)}" if s < 1024 else f"{int(s)//1024}K" for s in data.columns],
+                       rotation=45)
+    ax.set_yticks(range(data.shape[0]))
+    ax.set_yticklabels(data.index)
+    ax.set_xlabel('Packet Size (bytes)', fontsize=11)
+    ax.set_title('PMU Counter vs Latency Correlation (Spearman rho)', fontsize=12, fontweight='bold')
+    fig.colorbar(im, ax=ax)
+
+    plt.tight_layout()
+    plot_file = f"{output_prefix}_pmu_correlation.png"
+    plt.savefig(plot_file, dpi=300, bbox_inches='tight')
+    print(f"Saved plot to {plot_file}")
+    plt.close()
+
+
+def theoretical_coherent_time(packet_size, overhead_ns=SOFTWARE_OVERHEAD_NS,
+                              bandwidth_bs=DDR4_BANDWIDTH_BS):
     """
     Calculate theoretical time WITH CCI-400 working.
     
@@ -92,9 +340,12 @@ def theoretical_coherent_time(packet_size):
     - No manual cache flush needed
     - Direct cache-to-cache transfers for small stuff
     - Way less software overhead
+    
+    overhead_ns and bandwidth_bs default to the spec-sheet guesses above,
+    --fit-model passes the values fitted from the run instead.
     """
     # Base latency is always there
-    base_latency_us = SOFTWARE_OVERHEAD_NS / 1000.0
+    base_latency_us = overhead_ns / 1000.0
     
     # For small packets (fits in a couple cache lines), snoop latency dominates
     if packet_size <= 2 * CACHE_LINE_SIZE:
@@ -107,7 +358,7 @@ def theoretical_coherent_time(packet_size):
         num_lines = (packet_size + CACHE_LINE_SIZE - 1) // CACHE_LINE_SIZE
         snoop_time_us = (CCI_SNOOP_LATENCY_NS * num_lines) / 1000.0
         # Bandwidth starts mattering here
-        bw_time_us = (packet_size / DDR4_BANDWIDTH_BS) * 1e6
+        bw_time_us = (packet_size / bandwidth_bs) * 1e6
         return base_latency_us + max(snoop_time_us, bw_time_us)
     
     # Large packets, bandwidth limited
@@ -115,7 +366,7 @@ def theoretical_coherent_time(packet_size):
         # Fixed snoop overhead for initial cache line invalidation
         snoop_overhead_us = (CCI_SNOOP_LATENCY_NS * 10) / 1000.0  # ~10 lines
         # Then it's all about bandwidth
-        bw_time_us = (packet_size / DDR4_BANDWIDTH_BS) * 1e6
+        bw_time_us = (packet_size / bandwidth_bs) * 1e6
         return base_latency_us + snoop_overhead_us + bw_time_us
 
 
@@ -149,8 +400,177 @@ def theoretical_non_coherent_time(packet_size):
     return base_latency_us + flush_time_us + max(dram_read_time_us, bw_time_us)
 
 
-def plot_results(stats, output_prefix="perf"):
-    """Generate plots showing the results."""
+def rpu_lines(packet_size):
+    """R5 cache lines the RPU invalidates for one packet."""
+    return np.maximum(1, (np.asarray(packet_size) + RPU_CACHE_LINE_SIZE - 1) // RPU_CACHE_LINE_SIZE)
+
+
+def robust_scale(x):
+    """Normal-consistent MAD, so one bad packet doesn't set the loss scale."""
+    mad = np.median(np.abs(x - np.median(x)))
+    return max(1.4826 * mad, 1e-3)
+
+
+def fit_model(df):
+    """
+    Fit the non-coherent cost model to the measured samples.
+    
+    Two things are measured per packet, so two equations are fitted together:
+      delta_us             = overhead + line_cost * lines      (doorbell -> RPU done)
+      total_us - delta_us  = copy_overhead + size / bandwidth  (the APU copy)
+    Lines and bytes grow together, so bandwidth can only be told apart from
+    the per-line cost through the copy, which needs total_us (runs since -s
+    was added). Without it bandwidth keeps its spec-sheet value.
+    
+    soft_l1 loss keeps preempted or interrupted packets from dragging the
+    fit. Each equation is scaled by its MAD. The uncertainties come from the
+    Jacobian at the solution, scaled by the robust spread of the residuals.
+    """
+    # Memory attribute sweeps read the payload too, only WB matches the model
+    if 'mem_attr' in df.columns:
+        df = df[df['mem_attr'] == 'wb']
+    
+    size = df['packet_size'].values.astype(float)
+    lines = rpu_lines(df['packet_size'].values).astype(float)
+    delta = df['delta_us'].values
+    
+    has_copy = 'total_us' in df.columns and (df['total_us'] > 0).any()
+    if has_copy:
+        ok = (df['total_us'] > 0).values
+        copy_size = size[ok]
+        copy = df['total_us'].values[ok] - delta[ok]
+    
+    # Scale each equation by the spread within its packet sizes
+    delta_scale = robust_scale(delta - df.groupby('packet_size')['delta_us'].transform('median').values)
+    if has_copy:
+        copy_med = pd.Series(copy).groupby(copy_size).transform('median').values
+        copy_scale = robust_scale(copy - copy_med)
+    
+    # p = overhead_us, line_ns, [copy_overhead_us, bandwidth_gbs]
+    def residuals(p):
+        r = (p[0] + p[1] * lines / 1000.0 - delta) / delta_scale
+        if has_copy:
+            # GB/s == bytes/ns, so bytes / (GB/s * 1000) is in us
+            r_copy = (p[2] + copy_size / (p[3] * 1000.0) - copy) / copy_scale
+            r = np.concatenate([r, r_copy])
+        return r
+    
+    x0 = [SOFTWARE_OVERHEAD_NS / 1000.0, DRAM_ACCESS_LATENCY_NS]
+    lower, upper = [0.0, 0.0], [np.inf, np.inf]
+    if has_copy:
+        x0 += [0.1, DDR4_BANDWIDTH_GBS]
+        lower += [0.0, 1e-3]
+        upper += [np.inf, np.inf]
+    
+    res = least_squares(residuals, x0, bounds=(lower, upper), loss='soft_l1', f_scale=1.0)
+    
+    dof = max(1, len(res.fun) - len(res.x))
+    sigma2 = robust_scale(res.fun) ** 2 * len(res.fun) / dof
+    try:
+        cov = np.linalg.inv(res.jac.T @ res.jac) * sigma2
+        err = np.sqrt(np.diag(cov))
+    except np.linalg.LinAlgError:
+        err = np.full(len(res.x), np.nan)
+    
+    fit = {
+        'overhead_us': res.x[0], 'overhead_us_err': err[0],
+        'line_ns': res.x[1], 'line_ns_err': err[1],
+        'bandwidth_gbs': res.x[3] if has_copy else DDR4_BANDWIDTH_GBS,
+        'bandwidth_gbs_err': err[3] if has_copy else np.nan,
+        'copy_overhead_us': res.x[2] if has_copy else np.nan,
+        'copy_overhead_us_err': err[2] if has_copy else np.nan,
+        'samples': len(delta),
+        'converged': res.success,
+    }
+    return fit
+
+
+def fitted_non_coherent_time(packet_size, fit):
+    """Predicted delta_us (doorbell -> RPU done) from the fitted model."""
+    return fit['overhead_us'] + fit['line_ns'] * rpu_lines(packet_size) / 1000.0
+
+
+def fitted_coherent_time(packet_size, fit):
+    """
+    Coherent projection with the fitted parameters.
+    
+    Same structure as theoretical_coherent_time(): keep the measured fixed
+    protocol overhead and bandwidth, swap the invalidate for snoops.
+    """
+    return theoretical_coherent_time(packet_size, overhead_ns=fit['overhead_us'] * 1000.0,
+                                     bandwidth_bs=fit['bandwidth_gbs'] * 1e9)
+
+
+def print_model_fit(fit):
+    """Fitted parameters with 95% intervals next to the hardcoded guesses."""
+    print("\n" + "="*70)
+    print(f"FITTED COST MODEL ({fit['samples']} samples, robust soft-L1 fit"
+          f"{'' if fit['converged'] else ', NOT CONVERGED'})")
+    print("="*70)
+    print(f"{'Parameter':<28} {'Fitted':>12} {'± 95%':>10} {'Guess':>10}")
+    print("-"*70)
+    rows = [('Fixed overhead (us)', 'overhead_us', SOFTWARE_OVERHEAD_NS / 1000.0),
+            ('Invalidate per line (ns)', 'line_ns', DRAM_ACCESS_LATENCY_NS),
+            ('Copy bandwidth (GB/s)', 'bandwidth_gbs', DDR4_BANDWIDTH_GBS),
+            ('Copy overhead (us)', 'copy_overhead_us', np.nan)]
+    for label, key, guess in rows:
+        if np.isnan(fit[key]):
+            continue
+        err = fit[f'{key}_err']
+        err_str = f"{1.96 * err:>10.3f}" if not np.isnan(err) else f"{'(guess)':>10}"
+        guess_str = f"{guess:>10.3f}" if not np.isnan(guess) else f"{'-':>10}"
+        print(f"{label:<28} {fit[key]:>12.3f} {err_str} {guess_str}")
+    print("="*70)
+
+
+def model_residuals(stats, fit):
+    """Median and mean per size against the fitted curve."""
+    pred = fitted_non_coherent_time(stats['packet_size'].values, fit)
+    out = stats[['packet_size', 'median', 'mean']].copy()
+    out['fitted_us'] = pred
+    out['residual_us'] = out['median'] - pred
+    out['residual_pct'] = 100.0 * out['residual_us'] / pred
+    out['coherent_fitted_us'] = [fitted_coherent_time(s, fit) for s in out['packet_size']]
+    out['speedup_fitted'] = out['mean'] / out['coherent_fitted_us']
+    return out
+
+
+def plot_model_fit(df, residuals, output_prefix="perf"):
+    """Measured samples vs the fitted curve, and the residuals per size."""
+    fig, (ax1, ax2) = plt.subplots(2, 1, figsize=(12, 10), sharex=True)
+    
+    ax1.scatter(df['packet_size'], df['delta_us'], s=4, alpha=0.2, color='steelblue',
+                label='Samples')
+    ax1.plot(residuals['packet_size'], residuals['median'], 'bo', label='Median')
+    ax1.plot(residuals['packet_size'], residuals['fitted_us'], 'r-', linewidth=2,
+             label='Fitted (non-coherent)')
+    ax1.plot(residuals['packet_size'], residuals['coherent_fitted_us'], 'g--', linewidth=2,
+             label='Projected coherent (fitted)')
+    ax1.set_xscale('log', base=2)
+    ax1.set_yscale('log')
+    ax1.set_ylabel('Transfer Time (µs)', fontsize=11)
+    ax1.set_title('Cost Model Fit', fontsize=12, fontweight='bold')
+    ax1.legend(loc='upper left', fontsize=10)
+    ax1.grid(True, which='both', linestyle='--', alpha=0.7)
+    
+    ax2.bar(residuals['packet_size'], residuals['residual_pct'],
+            width=residuals['packet_size'] * 0.3, color='coral', edgecolor='black')
+    ax2.axhline(y=0.0, color='black', linewidth=1)
+    ax2.set_xscale('log', base=2)
+    ax2.set_xlabel('Packet Size (bytes)', fontsize=11)
+    ax2.set_ylabel('Median Residual (%)', fontsize=11)
+    ax2.grid(True, axis='y', linestyle='--', alpha=0.7)
+    ax2.xaxis.set_major_formatter(ScalarFormatter())
+    
+    plt.tight_layout()
+    plot_file = f"{output_prefix}_model_fit.png"
+    plt.savefig(plot_file, dpi=300, bbox_inches='tight')
+    print(f"Saved plot to {plot_file}")
+    plt.close()
+
+
+def plot_results(stats, output_prefix="perf", fit=None):
+    """Generate plots showing the results (fitted model curves if fit is given)."""
     print("\nGenerating plots...")
     
     # Make a 2x2 grid to show different aspects
@@ -163,8 +583,12 @@ def plot_results(stats, output_prefix="perf"):
     measured_std = stats['std'].values
     
     # Calculate what we'd get with CCI-400 working
-    theory_coherent = np.array([theoretical_coherent_time(s) for s in packet_sizes])
-    theory_non_coherent = np.array([theoretical_non_coherent_time(s) for s in packet_sizes])
+    if fit is None:
+        theory_coherent = np.array([theoretical_coherent_time(s) for s in packet_sizes])
+        theory_non_coherent = np.array([theoretical_non_coherent_time(s) for s in packet_sizes])
+    else:
+        theory_coherent = np.array([fitted_coherent_time(s, fit) for s in packet_sizes])
+        theory_non_coherent = fitted_non_coherent_time(packet_sizes, fit)
     
     # Plot 1: Main comparison (log-log scale works well here)
     ax1 = axes[0, 0]
@@ -268,8 +692,8 @@ def plot_results(stats, output_prefix="perf"):
     
     plt.close()
 
-def print_summary(stats):
-    """Print nice summary to console."""
+def print_summary(stats, fit=None):
+    """Print nice summary to console (speedups from the fitted model if given)."""
     print("\n" + "="*70)
     print("PERFORMANCE MEASUREMENT SUMMARY")
     print("="*70)
@@ -285,7 +709,10 @@ def print_summary(stats):
         else:
             size_str = str(size)
         
-        theory_coh = theoretical_coherent_time(row['packet_size'])
+        if fit is None:
+            theory_coh = theoretical_coherent_time(row['packet_size'])
+        else:
+            theory_coh = fitted_coherent_time(row['packet_size'], fit)
         speedup = row['mean'] / theory_coh
         
         print(f"{size_str:<15} {row['mean']:<12.3f} {row['std']:<12.3f} "
@@ -305,7 +732,8 @@ def print_summary(stats):
           f"(CV = {stats.loc[worst_cv_idx, 'cv']:.1f}%)")
     
     # Calculate potential speedup with working CCI-400
-    speedups = [stats.loc[i, 'mean'] / theoretical_coherent_time(stats.loc[i, 'packet_size']) 
+    coherent = fitted_coherent_time if fit is not None else (lambda s, _: theoretical_coherent_time(s))
+    speedups = [stats.loc[i, 'mean'] / coherent(stats.loc[i, 'packet_size'], fit)
                 for i in stats.index]
     avg_speedup = np.mean(speedups)
     max_speedup = np.max(speedups)
@@ -323,26 +751,87 @@ def main():
                         help='Prefix for output files (default: perf)')
     parser.add_argument('--latex', action='store_true',
                         help='Generate LaTeX table')
+    parser.add_argument('--baseline', metavar='CSV',
+                        help='Earlier run (e.g. monolithic) to compare TTFB/total latency against')
+    parser.add_argument('--bias', choices=['none', 'timer', 'empty-loop'], default='none',
+                        help='Subtract the calibrated timer-read cost or the empty-loop '
+                             'protocol overhead from delta_us (default: none)')
+    parser.add_argument('--fit-model', action='store_true',
+                        help='Fit overhead, per-line invalidate cost and bandwidth to the run '
+                             'and use them for the predicted curves and speedups')
     
     args = parser.parse_args()
     
     # Load data
     df = load_data(args.csv_file)
+    header = df.attrs['run_header']
+    print_run_header(header)
+    
+    if args.bias != 'none':
+        bias = measurement_bias_us(header, args.bias)
+        if bias is None:
+            print(f"Error: no {args.bias} calibration in {args.csv_file}")
+            sys.exit(1)
+        df = df.copy()
+        df['delta_us'] -= bias
+        print(f"Subtracted {args.bias} bias of {bias:.3f} us from every delta_us")
     
     # Crunch numbers
     stats = compute_statistics(df)
     
+    fit = None
+    if args.fit_model:
+        fit = fit_model(df)
+        print_model_fit(fit)
+    
     # Show summary
-    print_summary(stats)
+    print_summary(stats, fit)
     
     # Make plots
-    plot_results(stats, args.output_prefix)
+    plot_results(stats, args.output_prefix, fit)
+    
+    if fit is not None:
+        residuals = model_residuals(stats, fit)
+        print("\nMedian residuals against the fitted model:")
+        print(residuals[['packet_size', 'median', 'fitted_us', 'residual_us', 'residual_pct']]
+              .round(3).to_string(index=False))
+        plot_model_fit(df, residuals, args.output_prefix)
+        fit_file = f"{args.output_prefix}_model_fit.csv"
+        residuals.to_csv(fit_file, index=False)
+        print(f"Saved model fit to {fit_file}")
     
     # Save stats to CSV
     stats_file = f"{args.output_prefix}_statistics.csv"
     stats.to_csv(stats_file, index=False)
     print(f"\nSaved statistics to {stats_file}")
     
+    # Memory attribute sweep, only present in runs made with -m
+    if 'mem_attr' in df.columns:
+        matrix = mem_attr_matrix(df)
+        print_mem_attr_matrix(matrix)
+        matrix_file = f"{args.output_prefix}_mem_attr_matrix.csv"
+        matrix.to_csv(matrix_file)
+        print(f"Saved memory attribute matrix to {matrix_file}")
+    
+    # First-byte timing, not present in older result files
+    if 'ttfb_us' in df.columns:
+        baseline = None
+        if args.baseline:
+            baseline = load_data(args.baseline)
+            if 'ttfb_us' not in baseline.columns:
+                print(f"Warning: {args.baseline} has no first-byte timing, ignoring it")
+                baseline = None
+        print_first_byte_summary(df, baseline)
+    
+    # PMU counters, only present in runs made with -p
+    if pmu_columns(df):
+        corr = compute_pmu_correlation(df)
+        print_pmu_summary(df, corr)
+        plot_pmu_correlation(corr, args.output_prefix)
+        corr_file = f"{args.output_prefix}_pmu_correlation.csv"
+        corr.to_csv(corr_file, index=False)
+        print(f"Saved PMU correlation to {corr_file}")
+    
     print("\nAnalysis complete!")
 
 
@@ -0,0 +1,239 @@
+import pandas as pd
+import numpy as np
+import argparse
+import re
+import sys
+from pathlib import Path
+
+from analyze_performance import read_run_header
+
+# "<task>-<pid> [cpu] flags timestamp: event: details", flags and the tgid column are optional
+FTRACE_LINE = re.compile(r'^\s*(?P<task>.+?)-(?P<pid>\d+)\s+(?:\(\s*[\d-]+\)\s+)?\[(?P<cpu>\d+)\]\s+'
+                         r'(?:\S+\s+)?(?P<ts>\d+\.\d+):\s+(?P<event>\w+):\s*(?P<info>.*)$')
+FIELD = re.compile(r'(\w+)=(\S+)')
+
+
+def sibling(filename, suffix):
+    """Same naming as the sender: '<output without extension><suffix>'."""
+    path = Path(filename)
+    return str(path.with_name(path.stem + suffix))
+
+
+def load_samples(filename, metric):
+    """Samples with an OS-clock window (sender run with -k)."""
+    header = read_run_header(filename)
+    df = pd.read_csv(filename, comment='#')
+
+    for col in (metric, 'start_mono_ns', 'end_mono_ns'):
+        if col not in df.columns:
+            print(f"Error: {filename} has no '{col}' column (run the sender with -k)")
+            sys.exit(1)
+
+    df = df[(df[metric] > 0) & (df['start_mono_ns'] > 0)].reset_index(drop=True)
+    print(f"Loaded {len(df)} samples from {filename}")
+    return df, header
+
+
+def parse_ftrace(filename, sender_pid):
+    """
+    Turn the sender CPU's trace into labelled intervals (start_ns, end_ns).
+
+    Hard IRQs, softirqs and IPIs run between their entry and exit events.
+    Any task other than the sender runs from the sched_switch to it until
+    the next switch. A wakeup is an instant.
+    """
+    intervals = []
+    open_irq, open_softirq, open_ipi = {}, {}, []
+    running = None          # (label, start) of a non-sender task on the CPU
+    lines = bad = 0
+
+    with open(filename) as f:
+        for line in f:
+            if line.startswith('#'):
+                continue
+            m = FTRACE_LINE.match(line)
+            if not m:
+                bad += 1
+                continue
+            lines += 1
+            ts = int(round(float(m['ts']) * 1e9))
+            event, info = m['event'], m['info']
+            fields = dict(FIELD.findall(info))
+
+            if event == 'irq_handler_entry':
+                open_irq[fields.get('irq')] = (f"irq {fields.get('irq')} {fields.get('name', '?')}", ts)
+            elif event == 'irq_handler_exit' and fields.get('irq') in open_irq:
+                label, start = open_irq.pop(fields['irq'])
+                intervals.append((label, start, ts))
+            elif event == 'softirq_entry':
+                action = re.search(r'action=(\w+)', info)
+                open_softirq[fields.get('vec')] = (f"softirq {action[1] if action else fields.get('vec')}", ts)
+            elif event == 'softirq_exit' and fields.get('vec') in open_softirq:
+                label, start = open_softirq.pop(fields['vec'])
+                intervals.append((label, start, ts))
+            elif event == 'ipi_entry':
+                open_ipi.append((f"ipi {info.strip('() ')}", ts))
+            elif event == 'ipi_exit' and open_ipi:
+                label, start = open_ipi.pop()
+                intervals.append((label, start, ts))
+            elif event == 'sched_switch':
+                if running:
+                    intervals.append((running[0], running[1], ts))
+                    running = None
+                next_pid = int(fields.get('next_pid', -1))
+                if next_pid != sender_pid:
+                    name = 'idle' if next_pid == 0 else f"task {fields.get('next_comm', '?')}"
+                    running = (name, ts)
+            elif event == 'sched_wakeup':
+                intervals.append((f"wakeup {fields.get('comm', '?')}", ts, ts))
+
+    print(f"Parsed {lines} trace events from {filename} ({bad} lines skipped)")
+    return pd.DataFrame(intervals, columns=['label', 'start_ns', 'end_ns'])
+
+
+def attribute(samples, intervals):
+    """
+    For every sample, which labels overlapped its window and for how long.
+    Returns a list (one entry per sample) of {label: overlap_ns}.
+    """
+    starts = samples['start_mono_ns'].to_numpy(dtype=np.int64)
+    ends = samples['end_mono_ns'].to_numpy(dtype=np.int64)
+    hits = [dict() for _ in range(len(samples))]
+
+    for label, group in intervals.groupby('label'):
+        group = group.sort_values('start_ns')
+        g_start = group['start_ns'].to_numpy(dtype=np.int64)
+        g_end = group['end_ns'].to_numpy(dtype=np.int64)
+        # Running max of the ends is sorted, so it can be searched; the
+        # overlap itself needs each interval's own end
+        g_end_max = np.maximum.accumulate(g_end)
+
+        # Overlap: interval starts before the window ends and ends after it starts
+        first = np.searchsorted(g_end_max, starts, side='right')
+        last = np.searchsorted(g_start, ends, side='left')
+        for i in np.nonzero(last > first)[0]:
+            overlap = 0
+            for k in range(first[i], last[i]):
+                overlap += max(0, min(g_end[k], ends[i]) - max(g_start[k], starts[i]))
+            hits[i][label] = overlap
+
+    return hits
+
+
+def mark_outliers(df, metric, percentile, per_size):
+    """Samples above the percentile, per packet size by default."""
+    if per_size:
+        limit = df.groupby('packet_size')[metric].transform(lambda s: s.quantile(percentile / 100))
+    else:
+        limit = df[metric].quantile(percentile / 100)
+    return df[metric] > limit
+
+
+def attribution_table(hits, outlier):
+    """How much more often each label shows up in outliers than in normal samples."""
+    n_out = int(outlier.sum())
+    n_norm = int((~outlier).sum())
+    rows = {}
+
+    for i, sample_hits in enumerate(hits):
+        for label, overlap in sample_hits.items():
+            row = rows.setdefault(label, {'label': label, 'outliers': 0, 'normal': 0,
+                                          'outlier_overlap_us': 0.0})
+            if outlier[i]:
+                row['outliers'] += 1
+                row['outlier_overlap_us'] += overlap / 1000.0
+            else:
+                row['normal'] += 1
+
+    table = pd.DataFrame(list(rows.values()),
+                         columns=['label', 'outliers', 'normal', 'outlier_overlap_us'])
+    table['outlier_rate'] = table['outliers'] / max(n_out, 1)
+    table['normal_rate'] = table['normal'] / max(n_norm, 1)
+    table['excess'] = table['outlier_rate'] - table['normal_rate']
+    table['mean_overlap_us'] = table['outlier_overlap_us'] / table['outliers'].clip(lower=1)
+    return table.sort_values(['excess', 'outliers'], ascending=False)
+
+
+def print_table(table, n_outliers, unexplained, metric, percentile):
+    print("\n" + "="*86)
+    print(f"OS EVENTS OVERLAPPING {metric} OUTLIERS (> p{percentile:g}, {n_outliers} samples)")
+    print("="*86)
+    print(f"{'Event':<36} {'Outliers':>9} {'% out':>7} {'% normal':>9} {'Excess':>8} {'Mean (µs)':>11}")
+    print("-"*86)
+    for row in table.head(25).itertuples():
+        print(f"{row.label[:36]:<36} {row.outliers:>9} {100 * row.outlier_rate:>6.1f}% "
+              f"{100 * row.normal_rate:>8.1f}% {100 * row.excess:>7.1f}% {row.mean_overlap_us:>11.3f}")
+    print("-"*86)
+    print(f"Outliers with no OS event on the sender CPU: {unexplained} of {n_outliers}")
+    print("="*86)
+
+
+def print_irq_deltas(filename):
+    """Interrupt lines that fired on the sender CPU during the sweep."""
+    irq = pd.read_csv(filename, comment='#')
+    irq = irq[irq['cpu_delta'] > 0].sort_values('cpu_delta', ascending=False)
+    if irq.empty:
+        return
+
+    print("\nInterrupts on the sender CPU during the sweep (/proc/interrupts):")
+    for row in irq.head(15).itertuples():
+        print(f"  {str(row.irq):>6} {row.cpu_delta:>10} of {row.total_delta:<10} {row.description}")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Join latency outliers to the OS events that overlapped them (sender run with -k)')
+    parser.add_argument('file', help='Result CSV from apu_sender_ddr -k')
+    parser.add_argument('--ftrace', help='Sender CPU trace (default: <file>_ftrace.txt)')
+    parser.add_argument('--metric', default='total_us',
+                        help='Latency column, its window is copy start to RPU timestamp '
+                             '(default: total_us)')
+    parser.add_argument('--percentile', type=float, default=99.0,
+                        help='Samples above this percentile are outliers (default: 99)')
+    parser.add_argument('--global-percentile', action='store_true',
+                        help='One threshold for all sizes instead of one per packet size')
+    parser.add_argument('--output-prefix', default='perf',
+                        help='Prefix for output files (default: perf)')
+
+    args = parser.parse_args()
+
+    df, header = load_samples(args.file, args.metric)
+    sender_pid = int(header.get('sender_pid', -1))
+    ftrace_file = args.ftrace or sibling(args.file, '_ftrace.txt')
+    irq_file = sibling(args.file, '_irq.csv')
+
+    if Path(irq_file).exists():
+        print_irq_deltas(irq_file)
+
+    if not Path(ftrace_file).exists():
+        print(f"\nNo trace at {ftrace_file} (os_trace={header.get('os_trace', '?')}), "
+              f"only interrupt counts are available")
+        return
+
+    intervals = parse_ftrace(ftrace_file, sender_pid)
+    outlier = mark_outliers(df, args.metric, args.percentile, not args.global_percentile).to_numpy()
+    hits = attribute(df, intervals)
+
+    table = attribution_table(hits, outlier)
+    unexplained = sum(1 for i, h in enumerate(hits) if outlier[i] and not h)
+    print_table(table, int(outlier.sum()), unexplained, args.metric, args.percentile)
+
+    # One row per outlier with everything that overlapped it, longest first
+    rows = []
+    for i in np.nonzero(outlier)[0]:
+        events = sorted(hits[i].items(), key=lambda kv: -kv[1])
+        rows.append({'packet_size': df.at[i, 'packet_size'], args.metric: df.at[i, args.metric],
+                     'start_mono_ns': df.at[i, 'start_mono_ns'], 'end_mono_ns': df.at[i, 'end_mono_ns'],
+                     'events': '; '.join(f"{label} ({ns / 1000:.1f} us)" for label, ns in events)})
+
+    outlier_file = f"{args.output_prefix}_outliers.csv"
+    pd.DataFrame(rows).to_csv(outlier_file, index=False)
+    print(f"Saved: {outlier_file}")
+
+    table_file = f"{args.output_prefix}_attribution.csv"
+    table.to_csv(table_file, index=False)
+    print(f"Saved: {table_file}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,157 @@
+import pandas as pd
+import numpy as np
+import argparse
+import sys
+
+# Percentiles compared for every packet size
+STATISTICS = [('median', 50.0), ('p99', 99.0)]
+
+
+def load_run(filename, metric):
+    """Load one result CSV (run header lines are skipped)."""
+    print(f"Loading {filename}...")
+
+    try:
+        df = pd.read_csv(filename, comment='#')
+    except Exception as e:
+        print(f"Error loading file: {e}")
+        sys.exit(2)
+
+    if metric not in df.columns:
+        print(f"Error: {filename} has no '{metric}' column")
+        sys.exit(2)
+
+    # Same filtering as analyze_performance.py (negative = failed sample)
+    df = df[df[metric] > 0]
+    print(f"  {len(df)} valid samples")
+    return df
+
+
+def bootstrap_diff(base, cand, q, resamples, rng):
+    """
+    Bootstrap distribution of percentile q, candidate minus baseline.
+
+    Both runs are resampled independently, so the interval covers the
+    sampling noise of each side.
+    """
+    b = base[rng.integers(0, len(base), (resamples, len(base)))]
+    c = cand[rng.integers(0, len(cand), (resamples, len(cand)))]
+    return np.percentile(c, q, axis=1) - np.percentile(b, q, axis=1)
+
+
+def compare(baseline, candidate, metric, threshold_pct, confidence, resamples, min_samples, seed):
+    """One row per (size, statistic) with the CI and the verdict."""
+    rng = np.random.default_rng(seed)
+    alpha = (100.0 - confidence) / 2
+    rows = []
+
+    sizes = sorted(set(baseline['packet_size']) & set(candidate['packet_size']))
+    for size in sizes:
+        base = baseline.loc[baseline['packet_size'] == size, metric].values
+        cand = candidate.loc[candidate['packet_size'] == size, metric].values
+
+        for name, q in STATISTICS:
+            row = {'packet_size': size, 'statistic': name,
+                   'baseline_us': np.percentile(base, q), 'candidate_us': np.percentile(cand, q),
+                   'n_baseline': len(base), 'n_candidate': len(cand)}
+            row['diff_us'] = row['candidate_us'] - row['baseline_us']
+            row['diff_pct'] = 100.0 * row['diff_us'] / row['baseline_us']
+
+            # p99 of a handful of samples is just the max, don't judge on it
+            if min(len(base), len(cand)) < min_samples:
+                row.update(ci_low_pct=np.nan, ci_high_pct=np.nan, verdict='too few samples')
+                rows.append(row)
+                continue
+
+            diffs = bootstrap_diff(base, cand, q, resamples, rng)
+            low, high = np.percentile(diffs, [alpha, 100.0 - alpha])
+            row['ci_low_pct'] = 100.0 * low / row['baseline_us']
+            row['ci_high_pct'] = 100.0 * high / row['baseline_us']
+
+            # Significant = the whole interval is on one side of zero
+            if low > 0 and row['ci_low_pct'] > threshold_pct:
+                row['verdict'] = 'REGRESSION'
+            elif low > 0:
+                row['verdict'] = 'slower'
+            elif high < 0:
+                row['verdict'] = 'faster'
+            else:
+                row['verdict'] = 'same'
+            rows.append(row)
+
+    return pd.DataFrame(rows)
+
+
+def print_report(report, metric, threshold_pct, confidence):
+    """Table of every size and statistic, regressions stand out."""
+    print("\n" + "="*96)
+    print(f"REGRESSION CHECK ({metric}, {confidence:g}% bootstrap CI, threshold {threshold_pct:g}%)")
+    print("="*96)
+    print(f"{'Size':<10} {'Stat':<7} {'Baseline (µs)':>14} {'Candidate (µs)':>15} "
+          f"{'Diff (%)':>9} {'CI (%)':>20}  Verdict")
+    print("-"*96)
+
+    for row in report.itertuples():
+        size = f"{row.packet_size // 1024} KB" if row.packet_size >= 1024 else str(row.packet_size)
+        ci = (f"[{row.ci_low_pct:+.1f}, {row.ci_high_pct:+.1f}]"
+              if not np.isnan(row.ci_low_pct) else "-")
+        print(f"{size:<10} {row.statistic:<7} {row.baseline_us:>14.3f} {row.candidate_us:>15.3f} "
+              f"{row.diff_pct:>+9.1f} {ci:>20}  {row.verdict}")
+
+    print("="*96)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare a candidate run against a baseline, exit 1 on a significant regression, '
+                    '3 if no packet size had enough samples to compare')
+    parser.add_argument('baseline', help='Baseline result CSV')
+    parser.add_argument('candidate', help='Candidate result CSV')
+    parser.add_argument('--metric', default='delta_us',
+                        help='Latency column to compare (default: delta_us)')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='Fail if the lower CI bound of a median/p99 increase is above '
+                             'this many percent (default: 10)')
+    parser.add_argument('--confidence', type=float, default=95.0,
+                        help='Confidence level of the intervals in percent (default: 95)')
+    parser.add_argument('--resamples', type=int, default=2000,
+                        help='Bootstrap resamples (default: 2000)')
+    parser.add_argument('--min-samples', type=int, default=30,
+                        help='Skip sizes with fewer samples than this on either side (default: 30)')
+    parser.add_argument('--seed', type=int, default=1,
+                        help='RNG seed, fixed so the verdict is reproducible (default: 1)')
+    parser.add_argument('-o', '--output', help='Also save the comparison table as CSV')
+
+    args = parser.parse_args()
+
+    baseline = load_run(args.baseline, args.metric)
+    candidate = load_run(args.candidate, args.metric)
+
+    report = compare(baseline, candidate, args.metric, args.threshold, args.confidence,
+                     args.resamples, args.min_samples, args.seed)
+    if report.empty:
+        print("Error: the two runs have no packet size in common")
+        sys.exit(2)
+
+    print_report(report, args.metric, args.threshold, args.confidence)
+
+    if args.output:
+        report.to_csv(args.output, index=False)
+        print(f"\nSaved comparison to {args.output}")
+
+    regressions = report[report['verdict'] == 'REGRESSION']
+    if not regressions.empty:
+        print(f"\nFAIL: {len(regressions)} significant regression(s) above {args.threshold:g}%")
+        sys.exit(1)
+
+    # A gate that judged nothing must not pass
+    if (report['verdict'] == 'too few samples').all():
+        print(f"\nNOT TESTED: no packet size has {args.min_samples} samples in both runs, "
+              f"nothing was compared")
+        sys.exit(3)
+
+    print("\nPASS: no significant regression")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,265 @@
+import pandas as pd
+import numpy as np
+import matplotlib.pyplot as plt
+import argparse
+import itertools
+import sys
+from pathlib import Path
+from scipy import stats as sps
+
+from analyze_performance import read_run_header
+
+
+def parse_run_arg(arg):
+    """'label=file.csv' or just 'file.csv' (label = file name without extension)."""
+    label, sep, filename = arg.partition('=')
+    if not sep:
+        return Path(arg).stem, arg
+    return label, filename
+
+
+def load_configs(run_args, metric):
+    """
+    One entry per configuration: {label: samples of metric by packet size}.
+
+    A run swept over memory attributes (-m, mem_attr column) is split into
+    one configuration per attribute, 'label/attr'.
+    """
+    configs = {}
+    for arg in run_args:
+        label, filename = parse_run_arg(arg)
+        header = read_run_header(filename)
+        try:
+            df = pd.read_csv(filename, comment='#')
+        except Exception as e:
+            print(f"Error loading {filename}: {e}")
+            sys.exit(1)
+
+        if metric not in df.columns:
+            print(f"Error: {filename} has no '{metric}' column")
+            sys.exit(1)
+        df = df[df[metric] > 0]
+
+        parts = df.groupby('mem_attr') if 'mem_attr' in df.columns else [(None, df)]
+        for attr, part in parts:
+            name = f"{label}/{attr}" if attr is not None else label
+            if name in configs:
+                print(f"Error: configuration '{name}' given twice")
+                sys.exit(1)
+            configs[name] = part[['packet_size', metric]]
+            print(f"  {name}: {filename}, {len(part)} samples"
+                  f" ({header.get('mode', '?')}, wait={header.get('rpu_wait', 'spin')})")
+
+    return configs
+
+
+def size_label(size):
+    return f"{size // 1024} KB" if size >= 1024 else f"{size} B"
+
+
+def build_matrices(configs, metric, sizes):
+    """Median/p99 latency and throughput, packet sizes x configurations."""
+    median = pd.DataFrame(index=sizes, columns=list(configs), dtype=float)
+    p99 = median.copy()
+    count = median.copy()
+
+    for name, df in configs.items():
+        grouped = df.groupby('packet_size')[metric]
+        median[name] = grouped.median()
+        p99[name] = grouped.quantile(0.99)
+        count[name] = grouped.count()
+
+    # One transfer of packet_size bytes in median time: bytes per µs = MB/s
+    throughput = median.rdiv(pd.Series(sizes, index=sizes), axis=0)
+    for m in (median, p99, count, throughput):
+        m.index.name = 'packet_size'
+    return median, p99, throughput, count
+
+
+def holm(pvalues):
+    """Holm-Bonferroni adjusted p-values, same order as given."""
+    p = np.asarray(pvalues, dtype=float)
+    order = np.argsort(p)
+    adjusted = np.empty_like(p)
+    running = 0.0
+    for rank, i in enumerate(order):
+        running = max(running, (len(p) - rank) * p[i])
+        adjusted[i] = min(running, 1.0)
+    return adjusted
+
+
+def pairwise_tests(configs, metric, sizes, min_samples):
+    """
+    Mann-Whitney U for every pair of configurations at every size.
+
+    Latency distributions are skewed and often multi-modal, so the test is
+    on ranks rather than means. p-values are Holm-corrected over all tests.
+    prob_a_faster is the common-language effect size, P(a sample < b sample).
+    """
+    rows = []
+    for size in sizes:
+        for a, b in itertools.combinations(configs, 2):
+            xa = configs[a].loc[configs[a]['packet_size'] == size, metric].values
+            xb = configs[b].loc[configs[b]['packet_size'] == size, metric].values
+            if len(xa) < min_samples or len(xb) < min_samples:
+                continue
+
+            u, p = sps.mannwhitneyu(xa, xb, alternative='two-sided')
+            rows.append({'packet_size': size, 'config_a': a, 'config_b': b,
+                         'median_a_us': np.median(xa), 'median_b_us': np.median(xb),
+                         'ratio_b_over_a': np.median(xb) / np.median(xa),
+                         'prob_a_faster': 1.0 - u / (len(xa) * len(xb)),
+                         'u': u, 'p': p, 'n_a': len(xa), 'n_b': len(xb)})
+
+    tests = pd.DataFrame(rows)
+    if not tests.empty:
+        tests['p_holm'] = holm(tests['p'])
+    return tests
+
+
+def significant(tests, size, a, b, alpha):
+    """Whether a and b differ at this size after correction (False if untested)."""
+    if tests.empty:
+        return False
+    pair = tests[(tests['packet_size'] == size) &
+                 (((tests['config_a'] == a) & (tests['config_b'] == b)) |
+                  ((tests['config_a'] == b) & (tests['config_b'] == a)))]
+    return bool(len(pair)) and pair['p_holm'].iloc[0] < alpha
+
+
+def ranking(median, tests, alpha):
+    """
+    Configurations per size, fastest median first. tied_with_next marks a
+    step to the next one that isn't significant, so '1st' may be shared.
+    """
+    rows = []
+    for size, row in median.iterrows():
+        ordered = row.dropna().sort_values()
+        best = ordered.iloc[0]
+        names = list(ordered.index)
+        for rank, name in enumerate(names):
+            nxt = names[rank + 1] if rank + 1 < len(names) else None
+            rows.append({'packet_size': size, 'rank': rank + 1, 'config': name,
+                         'median_us': ordered[name], 'vs_fastest': ordered[name] / best,
+                         'tied_with_next': nxt is not None and not significant(tests, size, name, nxt, alpha)})
+    return pd.DataFrame(rows)
+
+
+def print_matrix(title, matrix, fmt):
+    print("\n" + "="*(12 + 13 * len(matrix.columns)))
+    print(title)
+    print("="*(12 + 13 * len(matrix.columns)))
+    print(f"{'Size':<12}" + "".join(f"{str(c)[:12]:>13}" for c in matrix.columns))
+    print("-"*(12 + 13 * len(matrix.columns)))
+    for size, row in matrix.iterrows():
+        print(f"{size_label(size):<12}" +
+              "".join(f"{v:>13{fmt}}" if pd.notna(v) else f"{'-':>13}" for v in row))
+
+
+def print_ranking(ranked):
+    """Fastest configuration per size, '=' where it isn't significantly ahead."""
+    print("\n" + "="*90)
+    print("FASTEST CONFIGURATION PER PACKET SIZE (median, '=' = not significantly different)")
+    print("="*90)
+    for size, group in ranked.groupby('packet_size'):
+        order = ""
+        for row in group.itertuples():
+            order += f"{row.config} ({row.median_us:.3f})"
+            if row.rank < len(group):
+                order += " = " if row.tied_with_next else " < "
+        print(f"{size_label(size):<10} {order}")
+    print("="*90)
+
+
+def plot_configs(median, p99, throughput, output_prefix):
+    """Latency and throughput per configuration, and slowdown vs the fastest per size."""
+    fig, axes = plt.subplots(1, 3, figsize=(20, 6))
+
+    for name in median.columns:
+        line, = axes[0].plot(median.index, median[name], 'o-', label=name)
+        axes[0].plot(p99.index, p99[name], '--', color=line.get_color(), alpha=0.5)
+        axes[1].plot(throughput.index, throughput[name], 'o-', label=name)
+
+    axes[0].set_title('Latency (median solid, p99 dashed)', fontsize=12, fontweight='bold')
+    axes[0].set_ylabel('Latency (µs)', fontsize=11)
+    axes[0].set_yscale('log')
+    axes[1].set_title('Throughput of one transfer', fontsize=12, fontweight='bold')
+    axes[1].set_ylabel('MB/s', fontsize=11)
+    axes[1].set_yscale('log')
+    for ax in axes[:2]:
+        ax.set_xscale('log', base=2)
+        ax.set_xlabel('Packet Size (bytes)', fontsize=11)
+        ax.grid(True, alpha=0.3)
+        ax.legend(fontsize=8)
+
+    # Slowdown vs the fastest configuration at each size
+    slowdown = median.div(median.min(axis=1), axis=0)
+    im = axes[2].imshow(slowdown.T.values.astype(float), aspect='auto', cmap='RdYlGn_r',
+                        vmin=1.0, vmax=max(2.0, float(np.nanmax(slowdown.values))))
+    axes[2].set_xticks(range(len(slowdown.index)))
+    axes[2].set_xticklabels([size_label(s) for s in slowdown.index], rotation=90, fontsize=8)
+    axes[2].set_yticks(range(len(slowdown.columns)))
+    axes[2].set_yticklabels(slowdown.columns, fontsize=8)
+    axes[2].set_title('Median vs fastest per size', fontsize=12, fontweight='bold')
+    fig.colorbar(im, ax=axes[2], label='x fastest')
+
+    plt.tight_layout()
+    plot_file = f"{output_prefix}_configs.png"
+    plt.savefig(plot_file, dpi=300, bbox_inches='tight')
+    print(f"Saved: {plot_file}")
+    plt.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare any number of labelled runs: latency/throughput matrices, '
+                    'pairwise Mann-Whitney tests and the fastest configuration per size')
+    parser.add_argument('runs', nargs='+',
+                        help='Result CSVs as label=file.csv (label defaults to the file name); '
+                             'runs with a mem_attr column are split per attribute')
+    parser.add_argument('--metric', default='delta_us',
+                        help='Latency column (default: delta_us)')
+    parser.add_argument('--alpha', type=float, default=0.05,
+                        help='Significance level after Holm correction (default: 0.05)')
+    parser.add_argument('--min-samples', type=int, default=10,
+                        help='Skip the test for a size with fewer samples on either side (default: 10)')
+    parser.add_argument('--output-prefix', default='perf',
+                        help='Prefix for output files (default: perf)')
+
+    args = parser.parse_args()
+
+    print("Loading runs...")
+    configs = load_configs(args.runs, args.metric)
+    if len(configs) < 2:
+        print("Error: need at least two configurations")
+        sys.exit(1)
+
+    sizes = sorted(set().union(*(df['packet_size'].unique() for df in configs.values())))
+    median, p99, throughput, count = build_matrices(configs, args.metric, sizes)
+    tests = pairwise_tests(configs, args.metric, sizes, args.min_samples)
+    ranked = ranking(median, tests, args.alpha)
+
+    print_matrix(f"MEDIAN {args.metric} (µs)", median, '.3f')
+    print_matrix(f"p99 {args.metric} (µs)", p99, '.3f')
+    print_matrix("THROUGHPUT (MB/s, packet size / median)", throughput, '.1f')
+    print_ranking(ranked)
+
+    if tests.empty:
+        print(f"\nNo size had {args.min_samples}+ samples in two configurations, no tests run")
+    else:
+        n_sig = int((tests['p_holm'] < args.alpha).sum())
+        print(f"\n{n_sig} of {len(tests)} pairwise differences significant at alpha={args.alpha} (Holm)")
+
+    plot_configs(median, p99, throughput, args.output_prefix)
+
+    for name, table in (('latency_median', median), ('latency_p99', p99),
+                        ('throughput', throughput), ('samples', count)):
+        table.to_csv(f"{args.output_prefix}_{name}.csv")
+    tests.to_csv(f"{args.output_prefix}_pairwise.csv", index=False)
+    ranked.to_csv(f"{args.output_prefix}_ranking.csv", index=False)
+    print(f"Saved: {args.output_prefix}_{{latency_median,latency_p99,throughput,samples,"
+          f"pairwise,ranking}}.csv")
+
+
+if __name__ == "__main__":
+    main()
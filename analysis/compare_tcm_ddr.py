@@ -11,7 +11,7 @@ def load_and_compute_real_latency(filename, label):
     """Load CSV and calculate the actual latency from the timestamps."""
     print(f"\nLoading {label} data from {filename}...")
     
-    df = pd.read_csv(filename)
+    df = pd.read_csv(filename, comment='#')  # skip the run header
     
     # Real latency is just the difference between RPU receiving and APU sending
     df['real_latency_ticks'] = df['rpu_timestamp'] - df['apu_timestamp']
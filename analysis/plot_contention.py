@@ -0,0 +1,133 @@
+import pandas as pd
+import numpy as np
+import matplotlib.pyplot as plt
+import argparse
+import sys
+
+from analyze_performance import read_run_header
+
+# Sizes plotted by default, one curve each
+DEFAULT_SIZES = [64, 1024, 16384, 65536]
+
+
+def load_run(filename, metric):
+    """One sweep plus the interference it ran under (0 = no -i, idle board)."""
+    header = read_run_header(filename)
+    df = pd.read_csv(filename, comment='#')
+
+    if metric not in df.columns:
+        print(f"Error: {filename} has no '{metric}' column")
+        sys.exit(1)
+
+    df = df[df[metric] > 0]
+    mbps = header.get('interference_mbps', 0.0)
+    kernel = header.get('interference_kernel', 'idle')
+
+    if mbps < 0:
+        print(f"Warning: {filename} has no measured interference bandwidth, skipped")
+        return None
+
+    print(f"  {filename}: {kernel}, {mbps:.0f} MB/s, {len(df)} samples")
+    return df, float(mbps), kernel
+
+
+def contention_table(runs, metric):
+    """Median and p99 per (run, size), sorted by interference bandwidth."""
+    rows = []
+    for filename, (df, mbps, kernel) in runs.items():
+        for size, group in df.groupby('packet_size'):
+            rows.append({'file': filename, 'kernel': kernel, 'interference_mbps': mbps,
+                         'packet_size': size, 'n': len(group),
+                         'median_us': group[metric].median(),
+                         'p99_us': group[metric].quantile(0.99)})
+
+    return pd.DataFrame(rows).sort_values(['packet_size', 'interference_mbps'])
+
+
+def print_table(table, sizes):
+    """Latency at each load level, relative to the least loaded run."""
+    print("\n" + "="*78)
+    print("LATENCY vs MEMORY CONTENTION")
+    print("="*78)
+    print(f"{'Size':<10} {'Kernel':<8} {'Load (MB/s)':>12} {'Median (µs)':>12} "
+          f"{'p99 (µs)':>10} {'vs lowest load':>15}")
+    print("-"*78)
+
+    for size in sizes:
+        group = table[table['packet_size'] == size]
+        if group.empty:
+            continue
+        base = group['median_us'].iloc[0]
+        label = f"{size // 1024} KB" if size >= 1024 else f"{size} B"
+        for row in group.itertuples():
+            print(f"{label:<10} {row.kernel:<8} {row.interference_mbps:>12.0f} "
+                  f"{row.median_us:>12.3f} {row.p99_us:>10.3f} {row.median_us / base:>14.2f}x")
+
+    print("="*78)
+
+
+def plot_contention(table, sizes, metric, output_prefix):
+    """One curve per packet size, median solid and p99 dashed."""
+    fig, ax = plt.subplots(figsize=(10, 6))
+
+    for size in sizes:
+        group = table[table['packet_size'] == size]
+        if group.empty:
+            continue
+        label = f"{size // 1024} KB" if size >= 1024 else f"{size} B"
+        line, = ax.plot(group['interference_mbps'], group['median_us'], 'o-',
+                        label=f"{label} median")
+        ax.plot(group['interference_mbps'], group['p99_us'], 's--',
+                color=line.get_color(), alpha=0.6, label=f"{label} p99")
+
+    ax.set_xlabel('Measured interference bandwidth (MB/s)', fontsize=12)
+    ax.set_ylabel(f'{metric} (µs)', fontsize=12)
+    ax.set_yscale('log')
+    ax.set_title('Latency vs DDR contention', fontsize=14, fontweight='bold')
+    ax.grid(True, alpha=0.3)
+    ax.legend(fontsize=9, ncol=2)
+
+    plt.tight_layout()
+    plot_file = f"{output_prefix}_contention.png"
+    plt.savefig(plot_file, dpi=300, bbox_inches='tight')
+    print(f"Saved: {plot_file}")
+    plt.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Latency-vs-contention curves from sweeps run next to mem_interference')
+    parser.add_argument('files', nargs='+',
+                        help='Result CSVs, one per load level (runs without -i count as idle)')
+    parser.add_argument('--metric', default='delta_us',
+                        help='Latency column (default: delta_us)')
+    parser.add_argument('--sizes', default=','.join(str(s) for s in DEFAULT_SIZES),
+                        help='Packet sizes to plot, comma separated (default: %(default)s)')
+    parser.add_argument('--output-prefix', default='perf',
+                        help='Prefix for output files (default: perf)')
+
+    args = parser.parse_args()
+    sizes = [int(s) for s in args.sizes.split(',')]
+
+    print("Loading runs...")
+    runs = {}
+    for f in args.files:
+        run = load_run(f, args.metric)
+        if run is not None:
+            runs[f] = run
+
+    if not runs:
+        print("Error: no usable runs")
+        sys.exit(1)
+
+    table = contention_table(runs, args.metric)
+    print_table(table, sizes)
+    plot_contention(table, sizes, args.metric, args.output_prefix)
+
+    table_file = f"{args.output_prefix}_contention.csv"
+    table.to_csv(table_file, index=False)
+    print(f"Saved: {table_file}")
+
+
+if __name__ == "__main__":
+    main()
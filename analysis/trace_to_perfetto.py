@@ -0,0 +1,157 @@
+import pandas as pd
+import numpy as np
+import argparse
+import json
+import sys
+
+# Timer runs at 100 MHz
+TIMER_FREQ_MHZ = 100.0
+
+# Event IDs written by apu_sender_ddr.c (-t) and rpu_receiver_ddr.c
+EVENT_NAMES = {
+    1: 'copy',
+    2: 'metadata',
+    3: 'doorbell',
+    4: 'ack wait',
+    5: 'slot wait',
+    10: 'poll detect',
+    11: 'invalidate metadata',
+    12: 'invalidate payload',
+    13: 'store result',
+    14: 'ack',
+    15: 'chunk ready',
+}
+
+PHASE_BEGIN = 0
+PHASE_END = 1
+PHASE_INSTANT = 2
+
+# One "process" per core in the trace viewer
+APU_PID = 1
+RPU_PID = 2
+PACKET_PID = 3
+
+
+def load_trace(filename, label):
+    """Load one trace CSV and unwrap the 32-bit TTC counter."""
+    print(f"Loading {label} trace from {filename}...")
+
+    try:
+        df = pd.read_csv(filename)
+    except Exception as e:
+        print(f"Error loading file: {e}")
+        sys.exit(1)
+
+    # Events are already in recording order, so any backwards jump is a wrap
+    ts = df['timestamp'].values.astype(np.int64)
+    wraps = np.cumsum(np.diff(ts, prepend=ts[0]) < -(1 << 31))
+    df['ticks'] = ts + wraps * (1 << 32)
+
+    print(f"  Loaded {len(df)} events")
+    return df
+
+
+def align(apu, rpu):
+    """Put both sides on the same unwrapped timeline (they share TTC0)."""
+    base = apu['ticks'].iloc[0]
+
+    # RPU unwrap started from its own first sample, shift it next to the APU one
+    offset = (int(rpu['timestamp'].iloc[0]) - int(apu['timestamp'].iloc[0])) & 0xFFFFFFFF
+    if offset >= (1 << 31):
+        offset -= (1 << 32)
+    rpu_base = rpu['ticks'].iloc[0] - offset
+
+    apu['ts_us'] = (apu['ticks'] - base) / TIMER_FREQ_MHZ
+    rpu['ts_us'] = (rpu['ticks'] - rpu_base) / TIMER_FREQ_MHZ
+    return apu, rpu
+
+
+def to_events(df, pid):
+    """Convert trace rows to Chrome trace events."""
+    events = []
+    for row in df.itertuples():
+        name = EVENT_NAMES.get(row.event, f'event {row.event}')
+        ph = {PHASE_BEGIN: 'B', PHASE_END: 'E', PHASE_INSTANT: 'i'}[row.phase]
+        ev = {'name': name, 'ph': ph, 'ts': row.ts_us, 'pid': pid, 'tid': 1,
+              'args': {'seq': int(row.seq), 'size': int(row.arg)}}
+        if ph == 'i':
+            ev['s'] = 't'
+        events.append(ev)
+    return events
+
+
+def packet_spans(apu, rpu, outlier_pct):
+    """
+    One span per packet from doorbell to RPU ack, on its own track.
+
+    Packets above the chosen percentile get flagged so they're easy to find.
+    """
+    start = apu[(apu['event'] == 3) & (apu['phase'] == PHASE_BEGIN)].set_index('seq')
+    end = rpu[(rpu['event'] == 14) & (rpu['phase'] == PHASE_END)].set_index('seq')
+    both = start[['ts_us', 'arg']].join(end[['ts_us']], rsuffix='_end', how='inner')
+    both['dur'] = both['ts_us_end'] - both['ts_us']
+
+    events = []
+    if both.empty:
+        return events, 0
+
+    # Outliers are judged per packet size, big packets are slow by design
+    threshold = both.groupby('arg')['dur'].transform(lambda d: np.percentile(d, outlier_pct))
+    both['outlier'] = both['dur'] > threshold
+
+    for seq, row in both.iterrows():
+        name = f"{int(row['arg'])}B" + (" OUTLIER" if row['outlier'] else "")
+        events.append({'name': name, 'ph': 'X', 'ts': row['ts_us'], 'dur': row['dur'],
+                       'pid': PACKET_PID, 'tid': 2 if row['outlier'] else 1,
+                       'args': {'seq': int(seq), 'size': int(row['arg']),
+                                'latency_us': round(row['dur'], 3)}})
+
+    return events, int(both['outlier'].sum())
+
+
+def metadata_events():
+    """Process/thread names shown in the trace viewer."""
+    names = [(APU_PID, 'APU (Cortex-A53)'), (RPU_PID, 'RPU (Cortex-R5F)'),
+             (PACKET_PID, 'Packets (doorbell -> ack)')]
+    events = [{'name': 'process_name', 'ph': 'M', 'pid': pid, 'args': {'name': n}}
+              for pid, n in names]
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': PACKET_PID, 'tid': 1,
+                   'args': {'name': 'normal'}})
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': PACKET_PID, 'tid': 2,
+                   'args': {'name': 'outliers'}})
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Merge APU and RPU trace CSVs into a Chrome/Perfetto JSON trace')
+    parser.add_argument('apu_trace', help='<output>_apu_trace.csv from apu_sender_ddr -t')
+    parser.add_argument('rpu_trace', help='<output>_rpu_trace.csv from apu_sender_ddr -t')
+    parser.add_argument('-o', '--output', default='trace.json',
+                        help='Output JSON file (default: trace.json)')
+    parser.add_argument('--outlier-pct', type=float, default=99.0,
+                        help='Percentile above which packets are flagged (default: 99)')
+
+    args = parser.parse_args()
+
+    apu = load_trace(args.apu_trace, "APU")
+    rpu = load_trace(args.rpu_trace, "RPU")
+    if apu.empty or rpu.empty:
+        print("Error: empty trace")
+        sys.exit(1)
+
+    apu, rpu = align(apu, rpu)
+
+    spans, outliers = packet_spans(apu, rpu, args.outlier_pct)
+    events = metadata_events() + to_events(apu, APU_PID) + to_events(rpu, RPU_PID) + spans
+
+    with open(args.output, 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, f)
+
+    print(f"\nSaved {len(events)} events to {args.output}")
+    print(f"Flagged {outliers} packets above the {args.outlier_pct:g}th percentile")
+    print("Open it in https://ui.perfetto.dev or chrome://tracing")
+
+
+if __name__ == "__main__":
+    main()
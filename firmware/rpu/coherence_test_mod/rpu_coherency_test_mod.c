@@ -1,12 +1,96 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "xil_printf.h"
+#include "xil_io.h"
+#include "xil_cache.h"
+#include "../performance_test/ddr_layout.h"
 
 #define SHARED_MEM 0x18A0000UL  // Should match whatever the kernel module printed
 #define PATTERN_OLD 0x0F0F0F0F  // What's actually sitting in DDR
 #define PATTERN_NEW 0xF0F0F0F0  // What APU wrote to its cache (but didn't flush)
 #define NUM_READS 100000        // Number of reads to perform
 
+// Timed mode, must match coherency_stress.c
+#define STALE_BASE          (SHARED_MEM_BASE + STALE_OFFSET)
+#define STALE_CTRL          (STALE_BASE + 0x0000)  // magic, count, observed
+#define STALE_DATA          (STALE_BASE + 0x1000)  // seq the APU keeps bumping
+#define STALE_RESULTS       (STALE_BASE + 0x2000)  // {seq, rpu_ts} per change we saw
+#define STALE_MAX_COUNT     4096
+#define STALE_MAGIC_RUN     0x57A1E001UL
+#define STALE_MAGIC_READY   0x57A1E002UL
+#define STALE_MAGIC_STOP    0x57A1E003UL
+#define STALE_MAGIC_DONE    0x57A1E004UL
+#define STALE_STOP_CHECK    256           // Data polls between looks at the control line
+#define RPU_LINE_SIZE       32            // R5F D-cache line
+
+// TTC0, same timebase the APU side reads
+#define TTC0_CLK_CTRL       0xFF110000UL
+#define TTC0_CNT_CTRL       0xFF11000CUL
+#define TTC0_CNT_VAL        0xFF110018UL
+
+static void init_timer(void)
+{
+    Xil_Out32(TTC0_CNT_CTRL, 0x01);  // Stop
+    Xil_Out32(TTC0_CLK_CTRL, 0x00);  // No prescaler, 100 MHz
+    Xil_Out32(TTC0_CNT_CTRL, 0x00);  // Go
+}
+
+// Control words live in DDR like everything else, so drop our copy first
+static uint32_t read_ctrl(int word)
+{
+    Xil_DCacheInvalidateRange(STALE_CTRL, RPU_LINE_SIZE);
+    return ((volatile uint32_t *)STALE_CTRL)[word];
+}
+
+static void write_ctrl(int word, uint32_t val)
+{
+    ((volatile uint32_t *)STALE_CTRL)[word] = val;
+    Xil_DCacheFlushRange(STALE_CTRL, RPU_LINE_SIZE);
+}
+
+/*
+ * One timed run: re-read the sequence line from DDR as fast as we can and
+ * log the first time each new value shows up. Values the APU overwrites
+ * before we get to see them are simply never logged.
+ */
+static void stale_run(uint32_t count)
+{
+    volatile uint32_t *data = (volatile uint32_t *)STALE_DATA;
+    volatile uint32_t *results = (volatile uint32_t *)STALE_RESULTS;
+    uint32_t last, seq, now;
+    uint32_t observed = 0;
+    uint32_t polls = 0;
+
+    Xil_DCacheInvalidateRange(STALE_DATA, RPU_LINE_SIZE);
+    last = data[0];
+    write_ctrl(0, STALE_MAGIC_READY);
+
+    while (1) {
+        Xil_DCacheInvalidateRange(STALE_DATA, RPU_LINE_SIZE);
+        seq = data[0];
+
+        if (seq != last) {
+            now = Xil_In32(TTC0_CNT_VAL);
+            if (observed < STALE_MAX_COUNT) {
+                results[observed * 2] = seq;
+                results[observed * 2 + 1] = now;
+                observed++;
+            }
+            last = seq;
+        }
+
+        if (++polls % STALE_STOP_CHECK == 0 && read_ctrl(0) == STALE_MAGIC_STOP) {
+            break;
+        }
+    }
+
+    Xil_DCacheFlushRange(STALE_RESULTS, observed * 8);
+    write_ctrl(2, observed);
+    write_ctrl(0, STALE_MAGIC_DONE);
+
+    xil_printf("Timed run: %lu changes seen for %lu values written\r\n", observed, count);
+}
+
 int main(void)
 {
     // Point to shared memory - volatile so compiler doesn't optimize reads away
@@ -63,6 +147,13 @@ int main(void)
 
     xil_printf("\r\nTest complete.\r\n");
 
-    while(1);  // Done, just hang here
+    // Stick around for timed runs started from /proc/coherency_stale
+    init_timer();
+    xil_printf("\r\nWaiting for timed runs on 0x%08lX\r\n", STALE_BASE);
+    while (1) {
+        if (read_ctrl(0) == STALE_MAGIC_RUN) {
+            stale_run(read_ctrl(1));
+        }
+    }
     return 0;
 }
\ No newline at end of file
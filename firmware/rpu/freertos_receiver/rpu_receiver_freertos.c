@@ -0,0 +1,506 @@
+#include <stdint.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "xil_printf.h"
+#include "xil_cache.h"
+#include "xil_io.h"
+#include "xpseudo_asm.h"
+#include "../performance_test/ddr_layout.h"
+
+/*
+ * FreeRTOS receiver (DDR)
+ *
+ * Same APU -> RPU protocol as performance_test/rpu_receiver_ddr.c (plain
+ * mode), but split over tasks the way our production R5F firmware is:
+ *
+ *   wake    - notices MAGIC_START, either a low priority polling task or
+ *             the tick hook (RX_WAKE_FROM_TICK), and notifies rx
+ *   rx      - highest priority, invalidates header + payload, hands a
+ *             descriptor to the processing task through a queue
+ *   process - timestamps when it holds the packet, reads the payload,
+ *             ACKs the APU
+ *   measure - stores results off the critical path, prints a per-size
+ *             breakdown of where the time went when the run is over
+ *
+ * Like the bare-metal receiver it stays resident: MAGIC_CONFIG starts a
+ * run with clean results areas, MAGIC_DONE ends it and we go back to
+ * MAGIC_READY once the results are flushed. The descriptor's invalidate
+ * strategy is ignored, rx always invalidates by range.
+ *
+ * The RPU timestamp in the results is taken by the processing task, so
+ * delta includes notification, context switches and the queue handoff.
+ * The per-stage timestamps go to STAGE_OFFSET for a closer look.
+ *
+ * Board build: Vitis application on a freertos10_xilinx domain, with
+ * use_task_notifications = true and, for RX_WAKE_FROM_TICK, use_tick_hook
+ * = true in the BSP settings (the BSP generates FreeRTOSConfig.h). Host
+ * build: FreeRTOS POSIX port, see linux/host-emulator/Makefile.
+ */
+
+/* Shared window layout and control word values are in ddr_layout.h */
+#define CACHE_LINE_SIZE     64  /* ARM cache line size */
+
+/* Flags word (must match APU side), only the sequence number is used here */
+#define FLAG_STREAM         0x00000008UL
+#define FLAG_SEQ_SHIFT      8
+
+/* TTC0 Timer 0 Registers */
+#define TTC0_BASE           0xFF110000UL
+#define TTC0_CLK_CTRL       (TTC0_BASE + 0x00)
+#define TTC0_CNT_CTRL       (TTC0_BASE + 0x0C)
+#define TTC0_CNT_VAL        (TTC0_BASE + 0x18)
+#define TIMER_NS_PER_TICK   10  /* 100 MHz */
+
+/* Marks a filled stage_entry_t */
+#define STAGE_MARKER        0x57A6E5A5UL
+
+/* Wake-up source: 0 = polling task, 1 = tick hook (one check per tick) */
+#ifndef RX_WAKE_FROM_TICK
+#define RX_WAKE_FROM_TICK   0
+#endif
+
+/* Task setup */
+#define PRIO_WAKE           (tskIDLE_PRIORITY + 1)
+#define PRIO_MEASURE        (tskIDLE_PRIORITY + 2)
+#define PRIO_PROCESS        (tskIDLE_PRIORITY + 3)
+#define PRIO_RX             (tskIDLE_PRIORITY + 4)
+#define TASK_STACK_WORDS    (configMINIMAL_STACK_SIZE * 4)
+#define QUEUE_DEPTH         4
+
+/* Same sweep as apu_sender_ddr.c, only used to bucket the breakdown */
+static const uint32_t packet_sizes[] = {
+    1, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+#define NUM_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
+
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+} __attribute__((packed)) first_byte_entry_t;
+
+/*
+ * Where one packet's time went. The APU timestamp and the result's RPU
+ * timestamp bracket all of it, these split the RPU part.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t detect_ts;     /* wake source saw MAGIC_START */
+    uint32_t rx_ts;         /* rx task running */
+    uint32_t ready_ts;      /* processing task holds the invalidated packet */
+    uint32_t done_ts;       /* payload processed, ACK flushed */
+    uint32_t marker;
+} __attribute__((packed)) stage_entry_t;
+
+CHAN_ASSERT_SIZE(first_byte_entry_t, FIRST_BYTE_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(stage_entry_t, STAGE_ENTRY_SIZE);
+
+/* Handed from rx to process to measure. size == MAGIC_DONE ends the run. */
+typedef struct {
+    uint32_t size;
+    uint32_t apu_ts;
+    stage_entry_t stage;
+} packet_desc_t;
+
+volatile uint32_t *shared_mem = (volatile uint32_t *)SHARED_MEM_BASE;
+volatile uint32_t *results_mem = (volatile uint32_t *)(SHARED_MEM_BASE + RESULTS_OFFSET);
+volatile uint32_t *first_byte_mem = (volatile uint32_t *)(SHARED_MEM_BASE + FIRST_BYTE_OFFSET);
+volatile uint32_t *stage_mem = (volatile uint32_t *)(SHARED_MEM_BASE + STAGE_OFFSET);
+volatile uint32_t *config_mem = (volatile uint32_t *)(SHARED_MEM_BASE + CONFIG_OFFSET);
+
+#if !RX_WAKE_FROM_TICK
+static TaskHandle_t wake_task_handle = NULL;
+#endif
+static TaskHandle_t rx_task_handle = NULL;
+static QueueHandle_t process_queue = NULL;
+static QueueHandle_t measure_queue = NULL;
+
+/* Written by the wake source, read by rx */
+static volatile uint32_t detect_ts = 0;
+
+/* Set by the wake source, cleared once the APU has its ACK */
+static volatile int packet_pending = 0;
+
+static uint32_t result_count = 0;
+static volatile uint32_t consume_sink;
+
+/**
+ * Initialize TTC0 Timer 0
+ */
+static void init_timer(void)
+{
+    xil_printf("RPU: Initializing TTC0 Timer 0...\r\n");
+    
+    // Stop counter first
+    Xil_Out32(TTC0_CNT_CTRL, 0x01);
+    
+    // No prescaler, just run at full speed
+    Xil_Out32(TTC0_CLK_CTRL, 0x00);
+    
+    // Start it up
+    Xil_Out32(TTC0_CNT_CTRL, 0x00);
+}
+
+/**
+ * Read timer value
+ */
+static inline uint32_t read_timer(void)
+{
+    return Xil_In32(TTC0_CNT_VAL);
+}
+
+static inline void invalidate_control_word(void)
+{
+    Xil_DCacheInvalidateRange((INTPTR)shared_mem, CACHE_LINE_SIZE);
+}
+
+static inline void flush_control_word(void)
+{
+    Xil_DCacheFlushRange((INTPTR)shared_mem, CACHE_LINE_SIZE);
+}
+
+/**
+ * Store a result entry (same format as rpu_receiver_ddr.c)
+ */
+static void store_result(const packet_desc_t *desc)
+{
+    if (result_count >= MAX_RESULTS) return;
+    
+    uint32_t offset = 1 + (result_count * 5);
+    results_mem[offset + 0] = desc->size;
+    results_mem[offset + 1] = desc->apu_ts;
+    results_mem[offset + 2] = desc->stage.ready_ts;
+    results_mem[offset + 3] = desc->stage.ready_ts - desc->apu_ts;  /* unsigned, wraps correctly */
+    results_mem[offset + 4] = 0xA5A5A5A5UL;
+    
+    volatile first_byte_entry_t *fb = &((volatile first_byte_entry_t *)first_byte_mem)[result_count];
+    fb->seq = desc->stage.seq;
+    fb->timestamp = desc->stage.ready_ts;
+    
+    volatile stage_entry_t *st = &((volatile stage_entry_t *)stage_mem)[result_count];
+    st->seq = desc->stage.seq;
+    st->detect_ts = desc->stage.detect_ts;
+    st->rx_ts = desc->stage.rx_ts;
+    st->ready_ts = desc->stage.ready_ts;
+    st->done_ts = desc->stage.done_ts;
+    st->marker = STAGE_MARKER;
+    
+    result_count++;
+}
+
+/**
+ * Clear the results, first-byte and stage areas for a new run
+ *
+ * Only called while no run is in flight, so the measurement task isn't
+ * storing anything.
+ */
+static void clear_run_areas(void)
+{
+    memset((void *)results_mem, 0, 4 + MAX_RESULTS * 20);
+    Xil_DCacheFlushRange((INTPTR)results_mem, 4 + MAX_RESULTS * 20);
+    
+    memset((void *)first_byte_mem, 0, MAX_RESULTS * sizeof(first_byte_entry_t));
+    Xil_DCacheFlushRange((INTPTR)first_byte_mem, MAX_RESULTS * sizeof(first_byte_entry_t));
+    
+    memset((void *)stage_mem, 0, MAX_RESULTS * sizeof(stage_entry_t));
+    Xil_DCacheFlushRange((INTPTR)stage_mem, MAX_RESULTS * sizeof(stage_entry_t));
+    
+    result_count = 0;
+}
+
+/**
+ * Let the wake source look at the control word again
+ */
+static void release_control_word(void)
+{
+    packet_pending = 0;
+#if !RX_WAKE_FROM_TICK
+    xTaskNotifyGive(wake_task_handle);
+#endif
+}
+
+/**
+ * Check the control word, called by whichever wake source is built in
+ *
+ * Returns 1 when there's something for rx (a packet, CONFIG or DONE). The
+ * pending flag keeps us from reporting the same packet twice while it's
+ * still in the pipeline.
+ */
+static int check_control_word(void)
+{
+    if (packet_pending) {
+        return 0;
+    }
+    
+    invalidate_control_word();
+    if (shared_mem[0] != MAGIC_START && shared_mem[0] != MAGIC_DONE &&
+        shared_mem[0] != MAGIC_CONFIG) {
+        return 0;
+    }
+    
+    detect_ts = read_timer();
+    packet_pending = 1;
+    return 1;
+}
+
+#if RX_WAKE_FROM_TICK
+/**
+ * Tick hook wake source, runs in the tick interrupt
+ *
+ * Detection is only as fine as the tick, like a periodic driver poll.
+ * The kernel switches to rx on the way out of the tick if we woke it.
+ */
+void vApplicationTickHook(void)
+{
+    BaseType_t woken = pdFALSE;
+    
+    if (rx_task_handle != NULL && check_control_word()) {
+        vTaskNotifyGiveFromISR(rx_task_handle, &woken);
+    }
+    (void)woken;
+}
+#else
+/**
+ * Polling wake source, runs whenever nothing else is ready
+ *
+ * Lowest priority above idle, so detection is immediate when the RPU is
+ * otherwise idle and gets pushed back by anything else that is running.
+ */
+static void wake_task(void *arg)
+{
+    (void)arg;
+    
+    for (;;) {
+        if (check_control_word()) {
+            xTaskNotifyGive(rx_task_handle);
+            
+            // Woken again once the packet is ACKed
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+}
+#endif
+
+/**
+ * Receive task: cache maintenance, then hand the packet on
+ */
+static void rx_task(void *arg)
+{
+    packet_desc_t desc;
+    
+    (void)arg;
+    
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        memset(&desc, 0, sizeof(desc));
+        desc.stage.rx_ts = read_timer();
+        desc.stage.detect_ts = detect_ts;
+        
+        if (shared_mem[0] == MAGIC_DONE) {
+            desc.size = MAGIC_DONE;
+            xQueueSend(process_queue, &desc, portMAX_DELAY);
+            continue;
+        }
+        
+        // New run, the last one's results have been read by now
+        if (shared_mem[0] == MAGIC_CONFIG) {
+            Xil_DCacheInvalidateRange((INTPTR)config_mem, CACHE_LINE_SIZE);
+            clear_run_areas();
+            xil_printf("RPU: Run %u configured\r\n", config_mem[0]);
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            release_control_word();
+            continue;
+        }
+        
+        // Metadata area is the first 256 bytes = 4 cache lines
+        Xil_DCacheInvalidateRange((INTPTR)shared_mem, 256);
+        desc.size = shared_mem[1];
+        desc.apu_ts = shared_mem[2];
+        desc.stage.seq = shared_mem[3] >> FLAG_SEQ_SHIFT;
+        
+        if (shared_mem[3] & FLAG_STREAM) {
+            xil_printf("RPU: Streaming not supported here, invalidating the whole payload\r\n");
+        }
+        
+        Xil_DCacheInvalidateRange((INTPTR)&shared_mem[4], desc.size);
+        dsb();
+        
+        xQueueSend(process_queue, &desc, portMAX_DELAY);
+    }
+}
+
+/**
+ * Processing task: the consumer the data is for
+ *
+ * Reads every word of the payload, then ACKs. The ACK comes after the
+ * read because the APU reuses the buffer for the next packet.
+ */
+static void process_task(void *arg)
+{
+    packet_desc_t desc;
+    
+    (void)arg;
+    
+    for (;;) {
+        xQueueReceive(process_queue, &desc, portMAX_DELAY);
+        desc.stage.ready_ts = read_timer();
+        
+        if (desc.size != MAGIC_DONE) {
+            volatile uint8_t *payload = (volatile uint8_t *)&shared_mem[4];
+            uint32_t sum = 0;
+            
+            for (uint32_t i = 0; i < desc.size; i += 4) {
+                sum += payload[i];
+            }
+            consume_sink = sum;
+            
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+        }
+        desc.stage.done_ts = read_timer();
+        
+        xQueueSend(measure_queue, &desc, portMAX_DELAY);
+        
+        // Next packet can be detected now, after DONE once the results are out
+        if (desc.size != MAGIC_DONE) {
+            release_control_word();
+        }
+    }
+}
+
+/**
+ * Per-size mean and max of each stage, in ns
+ */
+static void print_breakdown(void)
+{
+    xil_printf("\r\nRPU: Stage breakdown (ns, mean/max)\r\n");
+    xil_printf("%8s %16s %16s %16s\r\n", "Size", "detect->rx", "rx->process", "process");
+    
+    for (uint32_t s = 0; s < NUM_SIZES; s++) {
+        uint64_t sum[3] = { 0, 0, 0 };
+        uint32_t max[3] = { 0, 0, 0 };
+        uint32_t n = 0;
+        
+        for (uint32_t i = 0; i < result_count; i++) {
+            volatile stage_entry_t *st = &((volatile stage_entry_t *)stage_mem)[i];
+            uint32_t d[3];
+            
+            if (results_mem[1 + i * 5] != packet_sizes[s]) continue;
+            
+            d[0] = st->rx_ts - st->detect_ts;
+            d[1] = st->ready_ts - st->rx_ts;
+            d[2] = st->done_ts - st->ready_ts;
+            for (int k = 0; k < 3; k++) {
+                sum[k] += d[k];
+                if (d[k] > max[k]) max[k] = d[k];
+            }
+            n++;
+        }
+        
+        if (n == 0) continue;
+        
+        xil_printf("%8u %7u/%8u %7u/%8u %7u/%8u\r\n", packet_sizes[s],
+                   (uint32_t)(sum[0] * TIMER_NS_PER_TICK / n), max[0] * TIMER_NS_PER_TICK,
+                   (uint32_t)(sum[1] * TIMER_NS_PER_TICK / n), max[1] * TIMER_NS_PER_TICK,
+                   (uint32_t)(sum[2] * TIMER_NS_PER_TICK / n), max[2] * TIMER_NS_PER_TICK);
+    }
+}
+
+/**
+ * Measurement task: bookkeeping nobody should wait for
+ *
+ * Lower priority than rx and process, so storing results only runs in
+ * the gaps between packets, and ends the run on DONE.
+ */
+static void measure_task(void *arg)
+{
+    packet_desc_t desc;
+    uint32_t packets_received = 0;
+    
+    (void)arg;
+    
+    for (;;) {
+        xQueueReceive(measure_queue, &desc, portMAX_DELAY);
+        
+        if (desc.size != MAGIC_DONE) {
+            store_result(&desc);
+            packets_received++;
+            
+            // Print progress every 100 packets
+            if (packets_received % 100 == 0) {
+                xil_printf("RPU: Received %u packets\r\n", packets_received);
+            }
+            continue;
+        }
+        
+        xil_printf("RPU: Received DONE signal\r\n");
+        xil_printf("RPU: Total packets: %u\r\n", packets_received);
+        
+        // Write count and flush everything to memory
+        results_mem[0] = result_count;
+        Xil_DCacheFlushRange((INTPTR)results_mem, 4 + result_count * 20);
+        Xil_DCacheFlushRange((INTPTR)first_byte_mem, result_count * sizeof(first_byte_entry_t));
+        Xil_DCacheFlushRange((INTPTR)stage_mem, result_count * sizeof(stage_entry_t));
+        
+        // The APU reads the results now, the next CONFIG waits for the breakdown
+        shared_mem[0] = MAGIC_READY;
+        flush_control_word();
+        
+        print_breakdown();
+        xil_printf("\r\nRPU: Experiment complete, ready for the next run.\r\n");
+        
+        packets_received = 0;
+        release_control_word();
+    }
+}
+
+/**
+ * Main
+ */
+int main(void)
+{
+    xil_printf("\r\n========================================\r\n");
+    xil_printf("RPU FreeRTOS Receiver\r\n");
+    xil_printf("========================================\r\n");
+    xil_printf("Shared Memory: 0x%08X\r\n", (uint32_t)SHARED_MEM_BASE);
+    xil_printf("Results Area:  0x%08X\r\n", (uint32_t)(SHARED_MEM_BASE + RESULTS_OFFSET));
+    xil_printf("Stage Area:    0x%08X\r\n", (uint32_t)(SHARED_MEM_BASE + STAGE_OFFSET));
+    xil_printf("Wake source:   %s\r\n", RX_WAKE_FROM_TICK ? "tick hook" : "polling task");
+    xil_printf("========================================\r\n\r\n");
+    
+    init_timer();
+    
+    clear_run_areas();
+    
+    process_queue = xQueueCreate(QUEUE_DEPTH, sizeof(packet_desc_t));
+    measure_queue = xQueueCreate(QUEUE_DEPTH, sizeof(packet_desc_t));
+    if (process_queue == NULL || measure_queue == NULL) {
+        xil_printf("RPU: ERROR - Cannot create queues\r\n");
+        return -1;
+    }
+    
+    xTaskCreate(rx_task, "rx", TASK_STACK_WORDS, NULL, PRIO_RX, &rx_task_handle);
+    xTaskCreate(process_task, "process", TASK_STACK_WORDS, NULL, PRIO_PROCESS, NULL);
+    xTaskCreate(measure_task, "measure", TASK_STACK_WORDS, NULL, PRIO_MEASURE, NULL);
+#if !RX_WAKE_FROM_TICK
+    xTaskCreate(wake_task, "wake", TASK_STACK_WORDS, NULL, PRIO_WAKE, &wake_task_handle);
+#endif
+    
+    // Tell APU we're ready to go
+    shared_mem[0] = MAGIC_READY;
+    flush_control_word();
+    xil_printf("RPU: Waiting for packets at 0x%08X\r\n", (uint32_t)shared_mem);
+    
+    vTaskStartScheduler();
+    
+    // Only get here if the scheduler couldn't start
+    xil_printf("RPU: ERROR - Scheduler returned\r\n");
+    while (1) {
+        for (volatile int i = 0; i < 1000000; i++);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * DDR shared window layout, the one copy every side includes
+ *
+ * 8 MB at SHARED_MEM_BASE. Control words (magic, size, timestamp, flags)
+ * and the payload start the window, every other area has a fixed offset
+ * below. The MAGIC_* values of the first control word live here too. Record sizes are spelled out here so the areas can be checked
+ * against each other at compile time; each side checks its own structs
+ * against them with CHAN_ASSERT_SIZE.
+ */
+#ifndef DDR_LAYOUT_H
+#define DDR_LAYOUT_H
+
+#include "shm_channel.h"
+
+/* Shared Memory Setup */
+#define SHARED_MEM_BASE     0x3E000000UL
+#define SHARED_MEM_SIZE     0x00800000UL  /* 8 MB */
+#define PAYLOAD_MAX         65536         /* Largest packet, after the 16 B of control words */
+
+/* Control word (shared_mem[0]) values */
+#define MAGIC_START         0x0F0F0F0FUL
+#define MAGIC_ACK           0xF0F0F0F0UL
+#define MAGIC_DONE          0xFFFFFFFFUL
+#define MAGIC_READY         0xAAAAAAAAUL
+#define MAGIC_NBUF          0x5A5A5A5AUL  /* Switch to N-buffer mode, shared_mem[1] = slots */
+#define MAGIC_ATTR          0x3C3C3C3CUL  /* Set memory attributes, shared_mem[1] = attr, [2] = consume */
+#define MAGIC_MPSC          0x6B6B6B6BUL  /* Switch to the MPSC queue, shared_mem[1] = slots */
+#define MAGIC_WAIT          0x4D4D4D4DUL  /* Set the RPU idle wait, shared_mem[1] = WAIT_* */
+#define MAGIC_LANES         0x1E1E1E1EUL  /* Priority lane on/off, shared_mem[1] = 1/0 */
+#define MAGIC_CONFIG        0xC3C3C3C3UL  /* Start a run from the descriptor at CONFIG_OFFSET */
+#define MAGIC_SHUTDOWN      0x2D2D2D2DUL  /* Stop the resident RPU server */
+#define MAGIC_REVERSE       0x96969696UL  /* Start the reverse sweep, [1] = iterations, [2] = duplex */
+
+/* Dirty extents: count, then {offset, length} pairs */
+#define EXTENT_OFFSET       0x00020000UL
+#define MAX_EXTENTS         32
+
+/* Streaming chunk markers, one word per chunk */
+#define MARKER_OFFSET       0x00021000UL
+#define MAX_CHUNKS          1024
+
+/* Startup calibration, one calib_block_t */
+#define CALIB_OFFSET        0x00022000UL
+
+/* Run descriptor, one run_desc_t */
+#define CONFIG_OFFSET       0x00023000UL
+#define CONFIG_MAX_SIZES    32
+
+/* Stale-window test (coherency_stress.ko and rpu_coherency_test_mod) */
+#define STALE_OFFSET        0x00024000UL
+#define STALE_SIZE          0x0000C000UL
+
+/* MPSC queue: counters line, then one slot per MPSC_SLOT_STRIDE */
+#define MPSC_OFFSET         0x00030000UL
+#define MPSC_SLOT_STRIDE    0x00001040UL  /* Header line + up to 4 KB payload */
+#define MPSC_MAX_SLOTS      64
+
+/* N-buffer slots */
+#define SLOT_OFFSET         0x00100000UL
+#define SLOT_STRIDE         0x00020000UL  /* Header line + up to 64 KB payload */
+#define MAX_SLOTS           8
+
+/* Reverse (RPU -> APU) buffer: header line + payload */
+#define REV_OFFSET          0x00200000UL
+
+/* Priority lane: one line, then count + hp_entry_t records */
+#define HP_LANE_OFFSET      0x00280000UL
+#define HP_RESULTS_OFFSET   0x00281000UL
+#define MAX_HP_RESULTS      10000
+
+/* RPU trace ring: 16-byte header (count, capacity), then the events */
+#define TRACE_OFFSET        0x00300000UL
+#define TRACE_CAPACITY      16384         /* 256 KB of events */
+
+/* Per-sample RPU PMU counters, one pmu_entry_t per result */
+#define PMU_OFFSET          0x00341000UL
+
+/* First-byte timestamps, one first_byte_entry_t per result */
+#define FIRST_BYTE_OFFSET   0x003B0000UL
+
+/* Results: count, then one result_entry_t per packet */
+#define RESULTS_OFFSET      0x00400000UL
+#define MAX_RESULTS         10000
+
+/* FreeRTOS receiver per-stage timestamps, one stage_entry_t per result */
+#define STAGE_OFFSET        0x00480000UL
+
+/* Idle-wait counters, one wait_entry_t per result */
+#define WAIT_OFFSET         0x004C0000UL
+
+/* Record sizes (each side checks its structs against these) */
+#define CONTROL_SIZE            16
+#define EXTENT_ENTRY_SIZE       8
+#define CALIB_BLOCK_SIZE        60
+#define RUN_DESC_SIZE           (16 + 4 * CONFIG_MAX_SIZES)
+#define HP_ENTRY_SIZE           16
+#define TRACE_ENTRY_SIZE        16
+#define PMU_ENTRY_SIZE          40
+#define FIRST_BYTE_ENTRY_SIZE   8
+#define RESULT_ENTRY_SIZE       20
+#define STAGE_ENTRY_SIZE        24
+#define WAIT_ENTRY_SIZE         12
+
+/* Every area ends before the next one starts */
+CHAN_ASSERT_BEFORE(0, CONTROL_SIZE + PAYLOAD_MAX, EXTENT_OFFSET);
+CHAN_ASSERT_BEFORE(EXTENT_OFFSET, 4 + MAX_EXTENTS * EXTENT_ENTRY_SIZE, MARKER_OFFSET);
+CHAN_ASSERT_BEFORE(MARKER_OFFSET, MAX_CHUNKS * 4, CALIB_OFFSET);
+CHAN_ASSERT_BEFORE(CALIB_OFFSET, CALIB_BLOCK_SIZE, CONFIG_OFFSET);
+CHAN_ASSERT_BEFORE(CONFIG_OFFSET, RUN_DESC_SIZE, STALE_OFFSET);
+CHAN_ASSERT_BEFORE(STALE_OFFSET, STALE_SIZE, MPSC_OFFSET);
+CHAN_ASSERT_BEFORE(MPSC_OFFSET, CHAN_CACHE_LINE + MPSC_MAX_SLOTS * MPSC_SLOT_STRIDE, SLOT_OFFSET);
+CHAN_ASSERT_BEFORE(SLOT_OFFSET, MAX_SLOTS * SLOT_STRIDE, REV_OFFSET);
+CHAN_ASSERT_BEFORE(REV_OFFSET, CHAN_CACHE_LINE + PAYLOAD_MAX, HP_LANE_OFFSET);
+CHAN_ASSERT_BEFORE(HP_LANE_OFFSET, CHAN_CACHE_LINE, HP_RESULTS_OFFSET);
+CHAN_ASSERT_BEFORE(HP_RESULTS_OFFSET, 4 + MAX_HP_RESULTS * HP_ENTRY_SIZE, TRACE_OFFSET);
+CHAN_ASSERT_BEFORE(TRACE_OFFSET, 16 + TRACE_CAPACITY * TRACE_ENTRY_SIZE, PMU_OFFSET);
+CHAN_ASSERT_BEFORE(PMU_OFFSET, MAX_RESULTS * PMU_ENTRY_SIZE, FIRST_BYTE_OFFSET);
+CHAN_ASSERT_BEFORE(FIRST_BYTE_OFFSET, MAX_RESULTS * FIRST_BYTE_ENTRY_SIZE, RESULTS_OFFSET);
+CHAN_ASSERT_BEFORE(RESULTS_OFFSET, 4 + MAX_RESULTS * RESULT_ENTRY_SIZE, STAGE_OFFSET);
+CHAN_ASSERT_BEFORE(STAGE_OFFSET, MAX_RESULTS * STAGE_ENTRY_SIZE, WAIT_OFFSET);
+CHAN_ASSERT_BEFORE(WAIT_OFFSET, MAX_RESULTS * WAIT_ENTRY_SIZE, SHARED_MEM_SIZE);
+
+#endif /* DDR_LAYOUT_H */
@@ -0,0 +1,375 @@
+/*
+ * Compact result records
+ *
+ * Raw results are 20 bytes each (size, APU ts, RPU ts, delta, valid), so the
+ * 56 KB left in TCM after the protocol area holds at most ~2800 of them and
+ * most of those bytes are redundant. This packs the same samples into ~3-4
+ * bytes each, losslessly:
+ *
+ * - Packet size is run-length coded: it's only written when it changes.
+ * - APU timestamps are stored as the change in the gap to the previous sample
+ *   (packets go out at a steady rate, so that's usually small).
+ * - Delta ticks are stored as the change from the previous delta.
+ * - RPU timestamp and valid marker aren't stored, rpu_ts = apu_ts + delta.
+ *
+ * Everything is a LEB128 varint (zigzag for signed values). The stream is
+ * cut into blocks of at most RC_BLOCK_MAX bytes, each with its own sample
+ * count and Fletcher-16 checksum. Decoder state resets at every block, so a
+ * corrupted block costs only its own samples.
+ *
+ * Layout at the start of the results area:
+ *   u32 RC_STREAM_MAGIC, u32 samples, u32 bytes of blocks that follow
+ *   block: u16 RC_BLOCK_MAGIC, u16 count, u16 length, u16 checksum, data
+ *
+ * The first word doubles as format detection: raw results start with the
+ * sample count, which can never be RC_STREAM_MAGIC.
+ *
+ * Header only, used by the RPU firmware (encoder) and the APU readers
+ * (decoder). All multi-byte fields are little-endian, written byte by byte
+ * so nothing needs to be aligned.
+ */
+#ifndef RESULT_CODEC_H
+#define RESULT_CODEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define RC_STREAM_MAGIC     0x52434D50UL  /* "PMCR" */
+#define RC_BLOCK_MAGIC      0xB10C
+#define RC_STREAM_HEADER    12
+#define RC_BLOCK_HEADER     8
+#define RC_BLOCK_MAX        248           /* Data bytes per block */
+#define RC_SAMPLE_MAX       15            /* Worst case: size run + two 5-byte varints */
+
+/* Element tags, the low bit of the first varint */
+#define RC_TAG_SAMPLE       0
+#define RC_TAG_SIZE         1
+
+typedef struct {
+    uint8_t *base;          /* Start of the results area */
+    uint32_t capacity;      /* Bytes available there */
+    uint32_t used;          /* Bytes of committed blocks */
+    uint32_t samples;       /* Samples in committed blocks */
+
+    /* Block being built */
+    uint8_t block[RC_BLOCK_MAX];
+    uint32_t block_len;
+    uint32_t block_count;
+
+    /* Predictor state, reset at every block */
+    uint32_t prev_apu_ts;
+    uint32_t prev_gap;
+    uint32_t prev_delta;
+    uint32_t cur_size;
+    int have_size;
+    int have_ts;
+} rc_encoder_t;
+
+static inline void rc_put_u16(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void rc_put_u32(uint8_t *p, uint32_t v)
+{
+    rc_put_u16(p, v);
+    rc_put_u16(p + 2, v >> 16);
+}
+
+static inline uint32_t rc_get_u16(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static inline uint32_t rc_get_u32(const uint8_t *p)
+{
+    return rc_get_u16(p) | (rc_get_u16(p + 2) << 16);
+}
+
+static inline uint32_t rc_zigzag(uint32_t v)
+{
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static inline uint32_t rc_unzigzag(uint32_t v)
+{
+    return (v >> 1) ^ (0U - (v & 1));
+}
+
+/**
+ * Write v as a varint, returns the number of bytes
+ *
+ * Tagged values are 33 bits (32-bit value << 1 | tag), so at most 5 bytes.
+ */
+static inline uint32_t rc_put_varint(uint8_t *p, uint64_t v)
+{
+    uint32_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/**
+ * Read a varint, returns bytes consumed or 0 if it runs past end
+ */
+static inline uint32_t rc_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t result = 0;
+
+    for (uint32_t n = 0; n < 5 && p + n < end; n++) {
+        result |= (uint64_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint32_t rc_checksum(const uint8_t *data, uint32_t len)
+{
+    uint32_t a = 0, b = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+static inline void rc_reset_block(rc_encoder_t *enc)
+{
+    enc->block_len = 0;
+    enc->block_count = 0;
+    enc->prev_apu_ts = 0;
+    enc->prev_gap = 0;
+    enc->prev_delta = 0;
+    enc->have_size = 0;
+    enc->have_ts = 0;
+}
+
+/**
+ * Start an empty stream at base (capacity bytes, including the header)
+ */
+static inline void rc_encoder_init(rc_encoder_t *enc, void *base, uint32_t capacity)
+{
+    enc->base = (uint8_t *)base;
+    enc->capacity = capacity;
+    enc->used = 0;
+    enc->samples = 0;
+    rc_reset_block(enc);
+
+    rc_put_u32(enc->base, RC_STREAM_MAGIC);
+    rc_put_u32(enc->base + 4, 0);
+    rc_put_u32(enc->base + 8, 0);
+}
+
+/**
+ * Copy the open block into the results area and update the stream header
+ *
+ * The header is rewritten on every commit, so whatever was committed can
+ * be read back even if the run never finishes cleanly.
+ */
+static inline int rc_commit_block(rc_encoder_t *enc)
+{
+    uint8_t *dst;
+
+    if (enc->block_count == 0) return 0;
+
+    if (RC_STREAM_HEADER + enc->used + RC_BLOCK_HEADER + enc->block_len > enc->capacity) {
+        return -1;
+    }
+
+    dst = enc->base + RC_STREAM_HEADER + enc->used;
+    rc_put_u16(dst, RC_BLOCK_MAGIC);
+    rc_put_u16(dst + 2, enc->block_count);
+    rc_put_u16(dst + 4, enc->block_len);
+    rc_put_u16(dst + 6, rc_checksum(enc->block, enc->block_len));
+    memcpy(dst + RC_BLOCK_HEADER, enc->block, enc->block_len);
+
+    enc->used += RC_BLOCK_HEADER + enc->block_len;
+    enc->samples += enc->block_count;
+    rc_put_u32(enc->base + 4, enc->samples);
+    rc_put_u32(enc->base + 8, enc->used);
+
+    rc_reset_block(enc);
+    return 0;
+}
+
+/**
+ * Encode one sample against the current block state, returns its length
+ */
+static inline uint32_t rc_encode_sample(const rc_encoder_t *enc, uint8_t *out,
+                                        uint32_t size, uint32_t apu_ts, uint32_t delta)
+{
+    uint32_t n = 0;
+    uint32_t gap = apu_ts - enc->prev_apu_ts;
+
+    if (!enc->have_size || size != enc->cur_size) {
+        n += rc_put_varint(out + n, ((uint64_t)size << 1) | RC_TAG_SIZE);
+    }
+
+    // The first timestamp in a block is absolute and doesn't count as a gap
+    if (!enc->have_ts) {
+        n += rc_put_varint(out + n, ((uint64_t)apu_ts << 1) | RC_TAG_SAMPLE);
+    } else {
+        n += rc_put_varint(out + n, ((uint64_t)rc_zigzag(gap - enc->prev_gap) << 1) | RC_TAG_SAMPLE);
+    }
+    n += rc_put_varint(out + n, rc_zigzag(delta - enc->prev_delta));
+
+    return n;
+}
+
+/**
+ * Append one sample, returns 0 or -1 once the results area is full
+ */
+static inline int rc_encode(rc_encoder_t *enc, uint32_t size, uint32_t apu_ts, uint32_t delta)
+{
+    uint8_t tmp[RC_SAMPLE_MAX];
+    uint32_t n = rc_encode_sample(enc, tmp, size, apu_ts, delta);
+
+    if (enc->block_len + n > RC_BLOCK_MAX) {
+        if (rc_commit_block(enc) != 0) return -1;
+        n = rc_encode_sample(enc, tmp, size, apu_ts, delta);
+    }
+
+    // Block must still fit once committed, or we'd lose it at the end
+    if (RC_STREAM_HEADER + enc->used + RC_BLOCK_HEADER + enc->block_len + n > enc->capacity) {
+        return -1;
+    }
+
+    memcpy(enc->block + enc->block_len, tmp, n);
+    enc->block_len += n;
+    enc->block_count++;
+
+    if (enc->have_ts) {
+        enc->prev_gap = apu_ts - enc->prev_apu_ts;
+    }
+    enc->prev_apu_ts = apu_ts;
+    enc->prev_delta = delta;
+    enc->cur_size = size;
+    enc->have_size = 1;
+    enc->have_ts = 1;
+
+    return 0;
+}
+
+/**
+ * Commit the last partial block, returns total bytes used
+ */
+static inline uint32_t rc_encoder_finish(rc_encoder_t *enc)
+{
+    rc_commit_block(enc);
+    return RC_STREAM_HEADER + enc->used;
+}
+
+/* Called by the decoder for every sample, in order */
+typedef void (*rc_sample_fn)(void *ctx, uint32_t size, uint32_t apu_ts,
+                             uint32_t rpu_ts, uint32_t delta);
+
+/**
+ * Decode a single block, returns samples or -1 if it's malformed
+ */
+static inline int rc_decode_block(const uint8_t *data, uint32_t len, uint32_t count,
+                                  rc_sample_fn fn, void *ctx)
+{
+    const uint8_t *p = data, *end = data + len;
+    uint32_t prev_apu_ts = 0, prev_gap = 0, prev_delta = 0, size = 0;
+    int have_size = 0, have_ts = 0;
+    uint32_t decoded = 0;
+
+    while (p < end) {
+        uint64_t v, w;
+        uint32_t apu_ts, delta, n;
+
+        if ((n = rc_get_varint(p, end, &v)) == 0) return -1;
+        p += n;
+
+        if ((v & 1) == RC_TAG_SIZE) {
+            size = (uint32_t)(v >> 1);
+            have_size = 1;
+            continue;
+        }
+
+        if (!have_size || (n = rc_get_varint(p, end, &w)) == 0) return -1;
+        p += n;
+
+        if (!have_ts) {
+            apu_ts = (uint32_t)(v >> 1);
+        } else {
+            uint32_t gap = prev_gap + rc_unzigzag((uint32_t)(v >> 1));
+            apu_ts = prev_apu_ts + gap;
+            prev_gap = gap;
+        }
+        delta = prev_delta + rc_unzigzag((uint32_t)w);
+
+        fn(ctx, size, apu_ts, apu_ts + delta, delta);
+        decoded++;
+
+        prev_apu_ts = apu_ts;
+        prev_delta = delta;
+        have_ts = 1;
+    }
+
+    return decoded == count ? (int)decoded : -1;
+}
+
+/**
+ * Decode a whole stream
+ *
+ * Returns the number of samples passed to fn, or -1 if base doesn't hold a
+ * compact stream. Blocks with a bad checksum are skipped and counted in
+ * bad_blocks; a bad block header ends decoding, since we can't find the next one.
+ */
+static inline int rc_decode(const uint8_t *base, uint32_t capacity, rc_sample_fn fn,
+                            void *ctx, uint32_t *bad_blocks)
+{
+    uint32_t bytes, pos = 0;
+    int total = 0;
+
+    *bad_blocks = 0;
+
+    if (capacity < RC_STREAM_HEADER || rc_get_u32(base) != RC_STREAM_MAGIC) {
+        return -1;
+    }
+
+    bytes = rc_get_u32(base + 8);
+    if (bytes > capacity - RC_STREAM_HEADER) {
+        bytes = capacity - RC_STREAM_HEADER;
+    }
+    base += RC_STREAM_HEADER;
+
+    while (pos + RC_BLOCK_HEADER <= bytes) {
+        const uint8_t *hdr = base + pos;
+        uint32_t count = rc_get_u16(hdr + 2);
+        uint32_t len = rc_get_u16(hdr + 4);
+
+        if (rc_get_u16(hdr) != RC_BLOCK_MAGIC || len > RC_BLOCK_MAX ||
+            pos + RC_BLOCK_HEADER + len > bytes) {
+            (*bad_blocks)++;
+            break;
+        }
+
+        if (rc_checksum(hdr + RC_BLOCK_HEADER, len) != rc_get_u16(hdr + 6)) {
+            (*bad_blocks)++;
+        } else {
+            int n = rc_decode_block(hdr + RC_BLOCK_HEADER, len, count, fn, ctx);
+            if (n < 0) {
+                (*bad_blocks)++;
+            } else {
+                total += n;
+            }
+        }
+
+        pos += RC_BLOCK_HEADER + len;
+    }
+
+    return total;
+}
+
+#endif /* RESULT_CODEC_H */
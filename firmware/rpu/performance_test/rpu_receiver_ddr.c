@@ -3,18 +3,13 @@
 #include "xil_printf.h"
 #include "xil_cache.h"
 #include "xil_io.h"
+#include "xpseudo_asm.h"
+#include "xil_mpu.h"
+#include "ddr_layout.h"
 
-/* Shared Memory Setup */
-#define SHARED_MEM_BASE     0x3E000000UL
-#define SHARED_MEM_SIZE     0x00800000UL  /* 8 MB */
+/* Shared window layout and control word values are in ddr_layout.h */
 #define CACHE_LINE_SIZE     64  /* ARM cache line size */
 
-/* Protocol Magic Values */
-#define MAGIC_START         0x0F0F0F0FUL
-#define MAGIC_ACK           0xF0F0F0F0UL
-#define MAGIC_DONE          0xFFFFFFFFUL
-#define MAGIC_READY         0xAAAAAAAAUL
-
 /* TTC0 Timer 0 Registers */
 #define TTC0_BASE           0xFF110000UL
 #define TTC0_CLK_CTRL       (TTC0_BASE + 0x00)
@@ -25,13 +20,165 @@
 #define TIMER_FREQ_HZ       100000000UL
 #define TIMER_FREQ_MHZ      100.0
 
-/* Results storage */
-#define RESULTS_OFFSET      0x00400000UL
-#define MAX_RESULTS         10000
+/* Per-packet flags word (shared_mem[3]), sits in the control cache line */
+#define FLAG_TRACE          0x00000001UL  /* Record trace events for this packet */
+#define FLAG_PMU            0x00000002UL  /* Sample PMU counters for this packet */
+#define FLAG_EXTENTS        0x00000004UL  /* Only the extents in the dirty table changed */
+#define FLAG_STREAM         0x00000008UL  /* Payload arrives in chunks after MAGIC_START */
+#define FLAG_CHUNK_SHIFT    4             /* Bits 4-7: log2(chunk size / 64) */
+#define FLAG_CHUNK_MASK     0x000000F0UL
+#define FLAG_SEQ_SHIFT      8             /* Upper 24 bits carry the APU sequence number */
+
+/*
+ * Dirty-extent table: word 0 = count, then {offset, length} pairs relative
+ * to the payload start. EXTENT_OVERFLOW means "too many, invalidate it all".
+ */
+#define EXTENT_OVERFLOW     0xFFFFFFFFUL
+
+/*
+ * Streaming mode: one marker word per chunk, set to CHUNK_MARKER(seq) by
+ * the APU once the chunk is written. Chunks are 64 B to 32 KB, so a 64 KB
+ * packet needs at most 1024 markers.
+ */
+#define CHUNK_MARKER(seq)   (((seq) & 0x00FFFFFFUL) + 1)
+
+/*
+ * Startup calibration, written once before MAGIC_READY so the APU can put
+ * our timer-read cost in its run header
+ */
+#define CALIB_MAGIC         0xCA11B8A7UL
+#define CALIB_SAMPLES       1000
+
+/*
+ * Payload invalidate strategy. A range invalidate costs one operation per
+ * 32 B line, a whole-cache clean+invalidate costs one per set/way of the
+ * 32 KB D-cache whatever the packet size. Startup times both and picks the
+ * whole cache from the crossover up. INVAL_AUTO=0 always uses the range.
+ */
+#ifndef INVAL_AUTO
+#define INVAL_AUTO          1
+#endif
+#define INVAL_CALIB_SIZES   7             /* 1 KB, 2 KB, ... 64 KB */
+#define INVAL_CALIB_MIN     1024
+#define INVAL_CALIB_REPS    15            /* Median of this many */
+#define INVAL_STRAT_AUTO    0             /* Run descriptor values */
+#define INVAL_STRAT_RANGE   1
+#define INVAL_STRAT_FULL    2
+
+/*
+ * MPSC queue: several APU processes, one consumer (us). Producers take a
+ * ticket t from a counter in APU-only memory, wait for slot t % N to have
+ * sequence word t, write it and publish sequence t + 1. We consume tickets
+ * in order and hand the slot back with t + N. Every sequence word has one
+ * writer at a time, so no atomics are needed on either side of the window.
+ *
+ * The first line holds our counters for the APU, then one slot per
+ * MPSC_SLOT_STRIDE: header line (seq, size, timestamp, producer) + payload.
+ */
+#define MPSC_SIZE_FENCE     0xFFFFFFFEUL  /* No payload, just released (drain marker) */
+#define MPSC_SIZE_DONE      0xFFFFFFFFUL  /* Last entry of the run */
+#define MPSC_STAT_CONSUMED  0             /* Counter words in the first line */
+#define MPSC_STAT_CORRUPT   1
+
+/*
+ * Idle wait between packets. WAIT_SPIN re-reads the control line in a
+ * loop. WAIT_IPI sleeps in WFI and the APU rings IPI channel 1 after
+ * every doorbell. An A53 SEV never reaches the R5F cluster, so the wake
+ * event has to be an interrupt. It stays masked in CPSR: a pending IRQ
+ * still ends WFI, so no handler is needed, and a ring that lands before
+ * the WFI makes it return straight away.
+ */
+#define WAIT_SPIN           0
+#define WAIT_IPI            1
+
+/* IPI channel 1 (RPU0), the APU is channel 0 */
+#define IPI_RPU0_BASE       0xFF310000UL
+#define IPI_ISR             (IPI_RPU0_BASE + 0x10)
+#define IPI_IER             (IPI_RPU0_BASE + 0x18)
+#define IPI_APU_MASK        0x00000001UL
+#define IPI_RPU0_IRQ        65            /* GIC SPI for channel 1 */
+
+/* RPU GIC (PL390) */
+#define GICD_BASE           0xF9000000UL
+#define GICD_CTLR           (GICD_BASE + 0x000)
+#define GICD_ISENABLER      (GICD_BASE + 0x100)
+#define GICD_ICPENDR        (GICD_BASE + 0x280)
+#define GICD_IPRIORITYR     (GICD_BASE + 0x400)
+#define GICD_ITARGETSR      (GICD_BASE + 0x800)
+#define GICC_BASE           0xF9001000UL
+#define GICC_CTLR           (GICC_BASE + 0x000)
+#define GICC_PMR            (GICC_BASE + 0x004)
+
+#ifndef wfi
+#define wfi()               __asm__ __volatile__ ("wfi" ::: "memory")
+#endif
+
+/*
+ * Priority lane: one cache line for small control messages next to the
+ * bulk mailbox. Layout: magic (MAGIC_START = full, MAGIC_ACK = free),
+ * size, APU timestamp, seq, then up to HP_PAYLOAD_MAX bytes. We look at
+ * it before every bulk poll and between HP_SLICE pieces of a bulk payload
+ * invalidate, so a control message never waits behind a whole 64 KB
+ * packet. Records go to HP_RESULTS_OFFSET after a count word.
+ */
+#define HP_PAYLOAD_MAX      (CACHE_LINE_SIZE - 16)
+#define HP_SLICE            4096
+
+/*
+ * N-buffer mode: each slot has its own header line (magic, size, timestamp,
+ * flags) followed by the payload. The slot magic is the ownership flag,
+ * MAGIC_START = full (RPU owns it), MAGIC_ACK = free (APU owns it).
+ */
+#define SLOT_HEADER_SIZE    CACHE_LINE_SIZE
+
+/*
+ * Memory attribute matrix: the packet part of the window (control, payload,
+ * extents, markers, N-buffer slots) gets its own MPU region so we can change
+ * its attributes at runtime. Results, trace and PMU areas stay write-back.
+ */
+#define ATTR_REGION_SIZE    0x00200000UL  /* 2 MB, MPU regions are power-of-two sized */
+#define ATTR_WB             0   /* Normal, write-back write-allocate */
+#define ATTR_WT             1   /* Normal, write-through */
+#define ATTR_NC             2   /* Normal, non-cacheable */
+#define ATTR_DEVICE         3   /* Device */
+#define ATTR_SO             4   /* Strongly ordered */
+#define NUM_ATTRS           5
+
+/* Trace event IDs (must match APU side and analysis/trace_to_perfetto.py) */
+#define TRACE_RPU_DETECT        10  /* Poll saw MAGIC_START */
+#define TRACE_RPU_INV_META      11  /* Metadata invalidate */
+#define TRACE_RPU_INV_PAYLOAD   12  /* Payload invalidate */
+#define TRACE_RPU_STORE         13  /* Storing the result */
+#define TRACE_RPU_ACK           14  /* ACK write + flush */
+#define TRACE_RPU_CHUNK         15  /* Streaming chunk invalidated, arg = chunk index */
+
+/*
+ * Cortex-R5 PMU events (TRM, "Performance monitoring events").
+ * The R5 has 3 event counters plus the cycle counter.
+ */
+#define PMU_EVT_DCACHE_MISS     0x03  /* Data cache miss */
+#define PMU_EVT_EXT_MEM_REQ     0x43  /* External memory request (AXI) */
+#define PMU_EVT_LSU_STALL       0x44  /* Cycles stalled because the LSU is busy */
+#define PMU_NUM_EVENTS          3
+
+#define PHASE_BEGIN         0
+#define PHASE_END           1
+#define PHASE_INSTANT       2
 
 /* Shared memory pointers */
 volatile uint32_t *shared_mem = (volatile uint32_t *)SHARED_MEM_BASE;
 volatile uint32_t *results_mem = (volatile uint32_t *)(SHARED_MEM_BASE + RESULTS_OFFSET);
+volatile uint32_t *trace_mem = (volatile uint32_t *)(SHARED_MEM_BASE + TRACE_OFFSET);
+volatile uint32_t *pmu_mem = (volatile uint32_t *)(SHARED_MEM_BASE + PMU_OFFSET);
+volatile uint32_t *extent_mem = (volatile uint32_t *)(SHARED_MEM_BASE + EXTENT_OFFSET);
+volatile uint32_t *marker_mem = (volatile uint32_t *)(SHARED_MEM_BASE + MARKER_OFFSET);
+volatile uint32_t *first_byte_mem = (volatile uint32_t *)(SHARED_MEM_BASE + FIRST_BYTE_OFFSET);
+volatile uint32_t *wait_mem = (volatile uint32_t *)(SHARED_MEM_BASE + WAIT_OFFSET);
+volatile uint32_t *calib_mem = (volatile uint32_t *)(SHARED_MEM_BASE + CALIB_OFFSET);
+volatile uint32_t *mpsc_mem = (volatile uint32_t *)(SHARED_MEM_BASE + MPSC_OFFSET);
+volatile uint32_t *config_mem = (volatile uint32_t *)(SHARED_MEM_BASE + CONFIG_OFFSET);
+volatile uint32_t *hp_lane = (volatile uint32_t *)(SHARED_MEM_BASE + HP_LANE_OFFSET);
+volatile uint32_t *hp_results_mem = (volatile uint32_t *)(SHARED_MEM_BASE + HP_RESULTS_OFFSET);
 
 /* Result structure */
 typedef struct {
@@ -42,8 +189,131 @@ typedef struct {
     uint32_t valid;
 } __attribute__((packed)) result_entry_t;
 
+/* Trace event, same layout on APU and RPU */
+typedef struct {
+    uint32_t timestamp;
+    uint32_t seq;
+    uint32_t event;   /* event ID << 16 | phase */
+    uint32_t arg;     /* packet size */
+} __attribute__((packed)) trace_entry_t;
+
+/* PMU deltas for one sample, index matches the result entry */
+typedef struct {
+    uint32_t seq;
+    uint32_t valid;
+    uint32_t inv[1 + PMU_NUM_EVENTS];   /* cycles, then events, around the invalidates */
+    uint32_t read[1 + PMU_NUM_EVENTS];  /* same, around reading the payload */
+} __attribute__((packed)) pmu_entry_t;
+
+/*
+ * When the first payload byte became usable. Same as the result's RPU
+ * timestamp unless the packet was streamed.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+} __attribute__((packed)) first_byte_entry_t;
+
+/* How the wait before a packet went: control-line polls and WFI wakeups */
+typedef struct {
+    uint32_t seq;
+    uint32_t polls;
+    uint32_t wakeups;
+} __attribute__((packed)) wait_entry_t;
+
+/*
+ * One priority-lane message. bulk_size is the bulk packet we were in the
+ * middle of when it arrived, 0 if the bulk lane was idle.
+ */
+typedef struct {
+    uint32_t seq;
+    uint32_t apu_timestamp;
+    uint32_t rpu_timestamp;
+    uint32_t bulk_size;
+} __attribute__((packed)) hp_entry_t;
+
+/*
+ * Run descriptor, what the APU is about to send (must match APU side).
+ * The firmware stays resident: each run starts with MAGIC_CONFIG
+ * pointing at this block and ends with MAGIC_DONE, after which we flush
+ * the results and go back to MAGIC_READY. Packet mode, memory
+ * attributes, idle wait and the priority lane keep their own messages
+ * and go back to their defaults after every run.
+ */
+typedef struct {
+    uint32_t run_id;
+    uint32_t inval_strategy;    /* INVAL_STRAT_* */
+    uint32_t iterations;        /* Per size */
+    uint32_t num_sizes;
+    uint32_t sizes[CONFIG_MAX_SIZES];
+} __attribute__((packed)) run_desc_t;
+
+/* Back-to-back timer read cost, in ticks (mean and std in 1/1000 tick) */
+typedef struct {
+    uint32_t magic;
+    uint32_t samples;
+    uint32_t min_ticks;
+    uint32_t max_ticks;
+    uint32_t mean_milliticks;
+    uint32_t std_milliticks;
+    uint32_t inval_full_ticks;                      /* Whole-cache clean+invalidate */
+    uint32_t inval_crossover;                       /* First size using it, 0 = never */
+    uint32_t inval_range_ticks[INVAL_CALIB_SIZES];  /* Range invalidate per size */
+} __attribute__((packed)) calib_block_t;
+
+/* The window areas in ddr_layout.h are sized for these records */
+CHAN_ASSERT_SIZE(result_entry_t, RESULT_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(trace_entry_t, TRACE_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(pmu_entry_t, PMU_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(first_byte_entry_t, FIRST_BYTE_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(wait_entry_t, WAIT_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(hp_entry_t, HP_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(run_desc_t, RUN_DESC_SIZE);
+CHAN_ASSERT_SIZE(calib_block_t, CALIB_BLOCK_SIZE);
+
 /* Global variables */
 static uint32_t result_count = 0;
+static uint32_t trace_count = 0;
+
+/* MPU settings for each ATTR_* mode */
+static const struct {
+    uint32_t mpu_attr;
+    int cached;
+    const char *name;
+} mem_attrs[NUM_ATTRS] = {
+    { NORM_NSHARED_WB_WA,   1, "write-back" },
+    { NORM_NSHARED_WT_NWA,  1, "write-through" },
+    { NORM_NSHARED_NCACHE,  0, "non-cacheable" },
+    { DEVICE_NONSHARED,     0, "device" },
+    { STRONG_ORDERD_SHARED, 0, "strongly-ordered" },
+};
+
+/*
+ * Set by MAGIC_ATTR. Uncached packet memory has nothing to invalidate, and
+ * skipping the cache only pays off if reading the data isn't slower, so
+ * the attribute sweep also reads the payload inside the timed interval.
+ */
+static int packet_mem_cached = 1;
+static int consume_payload = 0;
+static int attr_region = -1;
+static volatile uint32_t consume_sink;
+
+/* Payloads this big or bigger get the whole-cache operation, 0 = never */
+static uint32_t inval_crossover = 0;
+static uint32_t inval_calibrated = 0;  /* What startup measured, for INVAL_STRAT_AUTO */
+
+/* Set by MAGIC_WAIT, counters cover the wait before the current packet */
+static uint32_t wait_mode = WAIT_SPIN;
+static uint32_t idle_polls = 0;
+static uint32_t idle_wakeups = 0;
+
+/* Set by MAGIC_LANES */
+static int hp_enabled = 0;
+static uint32_t hp_count = 0;
+static volatile uint32_t hp_sink;
+
+/* Set by MAGIC_CONFIG, a run without it gets cleared by its mode switch */
+static int run_configured = 0;
 
 /**
  * Initialize TTC0 Timer 0
@@ -73,6 +343,42 @@ static void init_timer(void)
     }
 }
 
+/**
+ * Program the PMU: cycle counter plus our three events, all running
+ */
+static void init_pmu(void)
+{
+    static const uint32_t events[PMU_NUM_EVENTS] = {
+        PMU_EVT_DCACHE_MISS, PMU_EVT_EXT_MEM_REQ, PMU_EVT_LSU_STALL
+    };
+    
+    // Enable, reset event counters and cycle counter
+    mtcp(XREG_CP15_PERF_MONITOR_CTRL, 0x07);
+    
+    for (uint32_t i = 0; i < PMU_NUM_EVENTS; i++) {
+        mtcp(XREG_CP15_EVENT_CNTR_SEL, i);
+        mtcp(XREG_CP15_EVENT_TYPE_SEL, events[i]);
+    }
+    
+    // Cycle counter is bit 31
+    mtcp(XREG_CP15_COUNT_ENABLE_SET, 0x80000000UL | ((1UL << PMU_NUM_EVENTS) - 1));
+    isb();
+    
+    xil_printf("RPU: PMU enabled (D-cache miss, ext mem request, LSU stall)\r\n");
+}
+
+/**
+ * Snapshot cycle counter and event counters
+ */
+static inline void read_pmu(uint32_t *snap)
+{
+    snap[0] = mfcp(XREG_CP15_PERF_CYCLE_COUNTER);
+    for (uint32_t i = 0; i < PMU_NUM_EVENTS; i++) {
+        mtcp(XREG_CP15_EVENT_CNTR_SEL, i);
+        snap[1 + i] = mfcp(XREG_CP15_PERF_MONITOR_COUNT);
+    }
+}
+
 /**
  * Read timer value
  */
@@ -81,6 +387,235 @@ static inline uint32_t read_timer(void)
     return Xil_In32(TTC0_CNT_VAL);
 }
 
+/**
+ * Reprogram the MPU region covering the packet memory
+ */
+static void set_mem_attr(uint32_t attr, int consume)
+{
+    if (attr_region < 0) {
+        attr_region = (int)Xil_GetNextMPURegion();
+    }
+    
+    // Write back and drop every line first, nothing cached may outlive the switch
+    Xil_DCacheFlush();
+    Xil_SetMPURegionByRegNum(attr_region, SHARED_MEM_BASE, ATTR_REGION_SIZE,
+                             mem_attrs[attr].mpu_attr | PRIV_RW_USER_RW);
+    dsb();
+    isb();
+    
+    packet_mem_cached = mem_attrs[attr].cached;
+    consume_payload = consume;
+    
+    xil_printf("RPU: Packet memory is now %s (MPU region %d)%s\r\n", mem_attrs[attr].name,
+               attr_region, consume ? ", reading payloads" : "");
+}
+
+/**
+ * Read every word of the payload, the cost of actually using the data
+ */
+static void read_payload(volatile uint8_t *payload, uint32_t packet_size)
+{
+    volatile uint32_t *words = (volatile uint32_t *)payload;
+    uint32_t sum = 0;
+    
+    for (uint32_t i = 0; i < packet_size / 4; i++) {
+        sum += words[i];
+    }
+    for (uint32_t i = packet_size & ~3UL; i < packet_size; i++) {
+        sum += payload[i];
+    }
+    consume_sink = sum;
+}
+
+/**
+ * Integer square root, we don't want to pull in libm for one number
+ */
+static uint64_t isqrt64(uint64_t v)
+{
+    uint64_t x = v, y = (v + 1) / 2;
+    
+    if (v < 2) return v;
+    while (y < x) {
+        x = y;
+        y = (x + v / x) / 2;
+    }
+    return x;
+}
+
+/**
+ * Measure what one timer read costs us
+ *
+ * Every timestamp we take lands somewhere inside its own MMIO load, so this
+ * is the resolution floor of every delta. Back-to-back reads, the difference
+ * is the cost of one read.
+ */
+static void calibrate_timer(void)
+{
+    volatile calib_block_t *calib = (volatile calib_block_t *)calib_mem;
+    uint32_t min = 0xFFFFFFFFUL, max = 0;
+    uint64_t sum = 0, sum_sq = 0, var_micro;
+    uint32_t n = CALIB_SAMPLES;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t t0 = read_timer();
+        uint32_t t1 = read_timer();
+        uint32_t d = t1 - t0;
+        
+        if (d < min) min = d;
+        if (d > max) max = d;
+        sum += d;
+        sum_sq += (uint64_t)d * d;
+    }
+    
+    // Variance in ticks^2 scaled by 10^6, so its sqrt comes out in milliticks
+    var_micro = (sum_sq * n - sum * sum) * 1000000ULL / ((uint64_t)n * n);
+    
+    calib->samples = n;
+    calib->min_ticks = min;
+    calib->max_ticks = max;
+    calib->mean_milliticks = (uint32_t)(sum * 1000 / n);
+    calib->std_milliticks = (uint32_t)isqrt64(var_micro);
+    calib->magic = CALIB_MAGIC;
+    Xil_DCacheFlushRange((INTPTR)calib_mem, sizeof(calib_block_t));
+    
+    xil_printf("RPU: Timer read cost %u.%03u ticks (min %u, max %u)\r\n",
+               calib->mean_milliticks / 1000, calib->mean_milliticks % 1000, min, max);
+}
+
+/**
+ * Median of a handful of samples, sorts them in place
+ */
+static uint32_t median_ticks(uint32_t *v, uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t x = v[i], j = i;
+        
+        while (j > 0 && v[j - 1] > x) {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+    return v[n / 2];
+}
+
+/**
+ * Time range vs whole-cache invalidation of the payload and find where
+ * the whole cache starts winning
+ *
+ * Runs before MAGIC_READY, so the payload area is ours to invalidate. The
+ * whole-cache operation also writes back whatever is dirty, which during
+ * a run is little more than the last result record.
+ */
+static void calibrate_invalidate(void)
+{
+    volatile calib_block_t *calib = (volatile calib_block_t *)calib_mem;
+    INTPTR payload = (INTPTR)&shared_mem[4];
+    uint32_t samples[INVAL_CALIB_REPS];
+    uint32_t full, size;
+    
+    for (uint32_t r = 0; r < INVAL_CALIB_REPS; r++) {
+        uint32_t t0 = read_timer();
+        Xil_DCacheFlush();
+        dsb();
+        samples[r] = read_timer() - t0;
+    }
+    full = median_ticks(samples, INVAL_CALIB_REPS);
+    
+    inval_crossover = 0;
+    for (uint32_t k = 0; k < INVAL_CALIB_SIZES; k++) {
+        size = INVAL_CALIB_MIN << k;
+        for (uint32_t r = 0; r < INVAL_CALIB_REPS; r++) {
+            uint32_t t0 = read_timer();
+            Xil_DCacheInvalidateRange(payload, size);
+            dsb();
+            samples[r] = read_timer() - t0;
+        }
+        calib->inval_range_ticks[k] = median_ticks(samples, INVAL_CALIB_REPS);
+        
+        if (INVAL_AUTO && inval_crossover == 0 && calib->inval_range_ticks[k] > full) {
+            inval_crossover = size;
+        }
+    }
+    
+    inval_calibrated = inval_crossover;
+    calib->inval_full_ticks = full;
+    calib->inval_crossover = inval_crossover;
+    Xil_DCacheFlushRange((INTPTR)calib_mem, sizeof(calib_block_t));
+    
+    if (inval_crossover) {
+        xil_printf("RPU: Whole-cache invalidate (%u ticks) from %u B up\r\n",
+                   full, inval_crossover);
+    } else {
+        xil_printf("RPU: Range invalidate for every size (whole cache %u ticks)\r\n", full);
+    }
+}
+
+/**
+ * Take a message off the priority lane if there is one
+ *
+ * One line invalidate when it's empty. The payload shares the line we
+ * just invalidated, so reading it costs no extra maintenance.
+ */
+static void service_hp(uint32_t bulk_size)
+{
+    volatile uint8_t *data = (volatile uint8_t *)&hp_lane[4];
+    uint32_t size, sum = 0;
+    
+    Xil_DCacheInvalidateRange((INTPTR)hp_lane, CACHE_LINE_SIZE);
+    if (hp_lane[0] != MAGIC_START) {
+        return;
+    }
+    
+    size = hp_lane[1] < HP_PAYLOAD_MAX ? hp_lane[1] : HP_PAYLOAD_MAX;
+    for (uint32_t i = 0; i < size; i++) {
+        sum += data[i];
+    }
+    hp_sink = sum;
+    dsb();
+    
+    if (hp_count < MAX_HP_RESULTS) {
+        volatile hp_entry_t *e = &((volatile hp_entry_t *)&hp_results_mem[1])[hp_count];
+        e->rpu_timestamp = read_timer();
+        e->seq = hp_lane[3];
+        e->apu_timestamp = hp_lane[2];
+        e->bulk_size = bulk_size;
+        hp_count++;
+    }
+    
+    hp_lane[0] = MAGIC_ACK;
+    Xil_DCacheFlushRange((INTPTR)hp_lane, CACHE_LINE_SIZE);
+}
+
+static inline void flush_hp(void)
+{
+    hp_results_mem[0] = hp_count;
+    Xil_DCacheFlushRange((INTPTR)hp_results_mem, 4 + hp_count * sizeof(hp_entry_t));
+}
+
+/**
+ * Invalidate a whole payload the cheaper way for its size
+ *
+ * With the priority lane on, a range invalidate goes in HP_SLICE pieces
+ * with a lane check after each. The whole-cache operation can't be split,
+ * it gets one check after it.
+ */
+static inline void invalidate_payload(volatile uint8_t *payload, uint32_t packet_size)
+{
+    if (inval_crossover && packet_size >= inval_crossover) {
+        Xil_DCacheFlush();
+        if (hp_enabled) service_hp(packet_size);
+    } else if (!hp_enabled) {
+        Xil_DCacheInvalidateRange((INTPTR)payload, packet_size);
+    } else {
+        for (uint32_t off = 0; off < packet_size; off += HP_SLICE) {
+            uint32_t len = packet_size - off < HP_SLICE ? packet_size - off : HP_SLICE;
+            Xil_DCacheInvalidateRange((INTPTR)payload + off, len);
+            service_hp(packet_size);
+        }
+    }
+}
+
 /**
  * Invalidate just the control word (first cache line)
  */
@@ -89,6 +624,43 @@ static inline void invalidate_control_word(void)
     Xil_DCacheInvalidateRange((INTPTR)shared_mem, CACHE_LINE_SIZE);
 }
 
+/**
+ * Invalidate only the payload extents the APU published
+ *
+ * The first table line holds the count and the first extents, so small
+ * updates cost two invalidates instead of one per payload line. Falls back
+ * to the full payload when the APU couldn't describe the update compactly.
+ */
+static void invalidate_extents(volatile uint8_t *payload, uint32_t packet_size)
+{
+    uint32_t count;
+    
+    Xil_DCacheInvalidateRange((INTPTR)extent_mem, CACHE_LINE_SIZE);
+    count = extent_mem[0];
+    
+    if (count == EXTENT_OVERFLOW || count > MAX_EXTENTS) {
+        invalidate_payload(payload, packet_size);
+        return;
+    }
+    
+    // Rest of the table, only if it spills past the first line
+    if (4 + count * 8 > CACHE_LINE_SIZE) {
+        Xil_DCacheInvalidateRange((INTPTR)extent_mem + CACHE_LINE_SIZE,
+                                  4 + count * 8 - CACHE_LINE_SIZE);
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = extent_mem[1 + i * 2];
+        uint32_t length = extent_mem[2 + i * 2];
+        
+        // Never trust the table to stay inside the packet
+        if (offset >= packet_size) continue;
+        if (length > packet_size - offset) length = packet_size - offset;
+        
+        Xil_DCacheInvalidateRange((INTPTR)payload + offset, length);
+    }
+}
+
 /**
  * Flush just the control word
  */
@@ -106,6 +678,145 @@ static inline void flush_results(void)
     Xil_DCacheFlushRange((INTPTR)results_mem, bytes_to_flush);
 }
 
+/**
+ * Append an event to the trace ring
+ *
+ * Just a timer read and four stores into cached DDR, the ring is only
+ * flushed once at the end. Oldest events get overwritten when it wraps.
+ */
+static void trace_event(uint32_t seq, uint32_t event, uint32_t phase, uint32_t arg)
+{
+    volatile trace_entry_t *ring = (volatile trace_entry_t *)&trace_mem[4];
+    volatile trace_entry_t *e = &ring[trace_count % TRACE_CAPACITY];
+    
+    e->timestamp = read_timer();
+    e->seq = seq;
+    e->event = (event << 16) | phase;
+    e->arg = arg;
+    
+    trace_count++;
+}
+
+/**
+ * Flush the trace ring so the APU can read it back
+ */
+static void flush_trace(void)
+{
+    uint32_t entries = trace_count < TRACE_CAPACITY ? trace_count : TRACE_CAPACITY;
+    
+    trace_mem[0] = trace_count;
+    trace_mem[1] = TRACE_CAPACITY;
+    Xil_DCacheFlushRange((INTPTR)trace_mem, 16 + entries * sizeof(trace_entry_t));
+}
+
+/* Only pay for tracing on packets the APU asked us to trace */
+#define TRACE(seq, ev, ph, arg) \
+    do { if (tracing) trace_event((seq), (ev), (ph), (arg)); } while (0)
+
+/**
+ * Store PMU deltas for the result we're about to store
+ */
+static void store_pmu(uint32_t seq, const uint32_t *inv0, const uint32_t *inv1,
+                      const uint32_t *read0, const uint32_t *read1)
+{
+    if (result_count >= MAX_RESULTS) return;
+    
+    volatile pmu_entry_t *e = &((volatile pmu_entry_t *)pmu_mem)[result_count];
+    
+    e->seq = seq;
+    for (uint32_t i = 0; i <= PMU_NUM_EVENTS; i++) {
+        // Unsigned subtraction handles counter wraparound
+        e->inv[i] = inv1[i] - inv0[i];
+        e->read[i] = read1[i] - read0[i];
+    }
+    e->valid = 0xA5A5A5A5UL;
+}
+
+/**
+ * Flush the PMU samples so the APU can read them back
+ */
+static inline void flush_pmu(void)
+{
+    Xil_DCacheFlushRange((INTPTR)pmu_mem, result_count * sizeof(pmu_entry_t));
+}
+
+/**
+ * Store the first-byte timestamp for the result we're about to store
+ */
+static void store_first_byte(uint32_t seq, uint32_t ts)
+{
+    if (result_count >= MAX_RESULTS) return;
+    
+    volatile first_byte_entry_t *e = &((volatile first_byte_entry_t *)first_byte_mem)[result_count];
+    e->seq = seq;
+    e->timestamp = ts;
+}
+
+static inline void flush_first_byte(void)
+{
+    Xil_DCacheFlushRange((INTPTR)first_byte_mem, result_count * sizeof(first_byte_entry_t));
+}
+
+/**
+ * Record the wait that led up to this packet, then start counting afresh
+ */
+static void store_wait(uint32_t seq)
+{
+    if (result_count < MAX_RESULTS) {
+        volatile wait_entry_t *e = &((volatile wait_entry_t *)wait_mem)[result_count];
+        e->seq = seq;
+        e->polls = idle_polls;
+        e->wakeups = idle_wakeups;
+    }
+    idle_polls = 0;
+    idle_wakeups = 0;
+}
+
+static inline void flush_wait(void)
+{
+    Xil_DCacheFlushRange((INTPTR)wait_mem, result_count * sizeof(wait_entry_t));
+}
+
+/**
+ * Set one byte of a banked GIC byte-per-interrupt register
+ */
+static void gic_set_byte(uint32_t reg_base, uint32_t id, uint32_t value)
+{
+    uint32_t addr = reg_base + (id & ~3UL);
+    uint32_t shift = (id & 3) * 8;
+    
+    Xil_Out32(addr, (Xil_In32(addr) & ~(0xFFUL << shift)) | (value << shift));
+}
+
+/**
+ * Route the APU's IPI to us so it can end a WFI
+ *
+ * CPSR.I stays set the whole time, we never take the interrupt.
+ */
+static void init_ipi_wake(void)
+{
+    gic_set_byte(GICD_IPRIORITYR, IPI_RPU0_IRQ, 0xA0);
+    gic_set_byte(GICD_ITARGETSR, IPI_RPU0_IRQ, 0x01);
+    Xil_Out32(GICD_ISENABLER + (IPI_RPU0_IRQ / 32) * 4, 1UL << (IPI_RPU0_IRQ % 32));
+    Xil_Out32(GICD_CTLR, 0x1);
+    Xil_Out32(GICC_PMR, 0xF0);
+    Xil_Out32(GICC_CTLR, 0x1);
+    
+    Xil_Out32(IPI_ISR, 0xFFFFFFFFUL);
+    Xil_Out32(IPI_IER, IPI_APU_MASK);
+}
+
+/**
+ * Drop a pending ring. Has to happen before we look at the control word,
+ * so a doorbell after the look is still pending when we reach WFI.
+ */
+static inline void ipi_ack(void)
+{
+    Xil_Out32(IPI_ISR, IPI_APU_MASK);
+    Xil_Out32(GICD_ICPENDR + (IPI_RPU0_IRQ / 32) * 4, 1UL << (IPI_RPU0_IRQ % 32));
+    dsb();
+}
+
 /**
  * Store a result entry
  */
@@ -133,25 +844,433 @@ static void store_result(uint32_t pkt_size, uint32_t apu_ts, uint32_t rpu_ts)
 }
 
 /**
- * Main receiver loop, measures ONLY cache invalidation overhead
+ * Invalidate a streamed payload chunk by chunk, as the APU publishes them
+ *
+ * We spin on each chunk's marker, so chunk k gets invalidated while the
+ * APU is still writing k+1. Returns when the first chunk became usable.
+ */
+static uint32_t receive_chunks(uint32_t seq, int tracing, volatile uint8_t *payload,
+                               uint32_t packet_size, uint32_t chunk_size)
+{
+    uint32_t num_chunks = (packet_size + chunk_size - 1) / chunk_size;
+    uint32_t first_ts = 0;
+    
+    // The APU never sends this, but don't spin on markers that don't exist
+    if (num_chunks == 0 || num_chunks > MAX_CHUNKS) {
+        Xil_DCacheInvalidateRange((INTPTR)payload, packet_size);
+        dsb();
+        return read_timer();
+    }
+    
+    for (uint32_t k = 0; k < num_chunks; k++) {
+        uint32_t offset = k * chunk_size;
+        uint32_t length = packet_size - offset < chunk_size ? packet_size - offset : chunk_size;
+        
+        do {
+            Xil_DCacheInvalidateRange((INTPTR)&marker_mem[k], sizeof(uint32_t));
+        } while (marker_mem[k] != CHUNK_MARKER(seq));
+        
+        if (packet_mem_cached) {
+            Xil_DCacheInvalidateRange((INTPTR)payload + offset, length);
+        }
+        dsb();
+        
+        if (k == 0) {
+            first_ts = read_timer();
+        }
+        TRACE(seq, TRACE_RPU_CHUNK, PHASE_INSTANT, k);
+    }
+    
+    return first_ts;
+}
+
+/**
+ * Handle one packet, measures the cache invalidation overhead
  * 
  * What we're measuring here:
  * 1. Time for APU to write to DRAM (it's using uncached writes with O_SYNC)
  * 2. Time for RPU to poll and see the signal
  * 3. Time to invalidate cache for metadata
  * 4. Time to invalidate cache for payload
+ * 5. Only in consume mode (MAGIC_ATTR with consume set): time to read
+ *    the whole payload
  * 
- * What we're NOT measuring: actually reading and processing the data.
- * That would happen even with hardware coherence, so it's not part of the overhead.
+ * By default the data isn't read, that would happen even with hardware
+ * coherence, so it's not part of the overhead. The memory attribute
+ * sweep turns consume mode on, because an uncached packet has nothing to
+ * invalidate and only pays off if reading it isn't slower.
  * 
  * The cache invalidation calls are exactly what CCI-400 would eliminate.
+ *
+ * hdr points at the packet's header words (magic, size, timestamp, flags),
+ * meta_len is how much of it to invalidate. Both modes ACK by writing
+ * MAGIC_ACK into hdr[0], which for a slot also hands it back to the APU.
+ */
+static void process_packet(volatile uint32_t *hdr, uint32_t meta_len,
+                           volatile uint8_t *payload)
+{
+    uint32_t rpu_ts, apu_ts, packet_size, first_ts = 0;
+    uint32_t flags, seq;
+    int tracing, sampling;
+    uint32_t pmu_inv0[1 + PMU_NUM_EVENTS], pmu_inv1[1 + PMU_NUM_EVENTS];
+    uint32_t pmu_read0[1 + PMU_NUM_EVENTS], pmu_read1[1 + PMU_NUM_EVENTS];
+    
+    /* 
+     * Here's what CCI-400 would save us:
+     * - Invalidating metadata cache lines
+     * - Reading metadata (size and timestamp)
+     * - Invalidating payload cache lines
+     * 
+     * Reading the actual bytes takes time even with hardware coherence,
+     * so the payload is only read inside the timed interval in consume
+     * mode, where the read is what gets compared.
+     */
+    
+    // Flags share the header line we just invalidated, so this read is free
+    flags = hdr[3];
+    seq = flags >> FLAG_SEQ_SHIFT;
+    tracing = (flags & FLAG_TRACE) != 0;
+    sampling = (flags & FLAG_PMU) != 0;
+    TRACE(seq, TRACE_RPU_DETECT, PHASE_INSTANT, 0);
+    
+    if (sampling) {
+        read_pmu(pmu_inv0);
+    }
+    
+    // Invalidate metadata area
+    TRACE(seq, TRACE_RPU_INV_META, PHASE_BEGIN, 0);
+    if (packet_mem_cached) {
+        Xil_DCacheInvalidateRange((INTPTR)hdr, meta_len);
+    }
+    
+    // Grab what we need from metadata
+    packet_size = hdr[1];
+    apu_ts = hdr[2];
+    TRACE(seq, TRACE_RPU_INV_META, PHASE_END, packet_size);
+    
+    /* 
+     * Key part: invalidate payload cache lines.
+     * This is the overhead CCI-400 would completely eliminate!
+     * Without consume mode we invalidate but don't read, so only the
+     * cache maintenance is measured.
+     */
+    TRACE(seq, TRACE_RPU_INV_PAYLOAD, PHASE_BEGIN, packet_size);
+    if (flags & FLAG_STREAM) {
+        uint32_t chunk_size = CACHE_LINE_SIZE << ((flags & FLAG_CHUNK_MASK) >> FLAG_CHUNK_SHIFT);
+        first_ts = receive_chunks(seq, tracing, payload, packet_size, chunk_size);
+    } else if (!packet_mem_cached) {
+        // Nothing cached, nothing to invalidate
+    } else if (flags & FLAG_EXTENTS) {
+        invalidate_extents(payload, packet_size);
+    } else {
+        invalidate_payload(payload, packet_size);
+    }
+    
+    // Consume mode: the read is part of the measurement
+    if (consume_payload) {
+        read_payload(payload, packet_size);
+    }
+    
+    /* 
+     * Memory barrier to make sure all invalidations finish before we timestamp.
+     * Important for accurate measurements.
+     */
+    dsb();
+    
+    if (sampling) {
+        read_pmu(pmu_inv1);
+    }
+    
+    // Take timestamp after all the cache work is done
+    rpu_ts = read_timer();
+    if (!(flags & FLAG_STREAM)) {
+        first_ts = rpu_ts;
+    }
+    TRACE(seq, TRACE_RPU_INV_PAYLOAD, PHASE_END, packet_size);
+    
+    /*
+     * When sampling we also read the payload (outside the timed
+     * interval) so the counters show what the refills cost.
+     */
+    if (sampling) {
+        uint32_t sum = 0;
+        
+        read_pmu(pmu_read0);
+        for (uint32_t i = 0; i < packet_size; i += 4) {
+            sum += payload[i];
+        }
+        dsb();
+        read_pmu(pmu_read1);
+        
+        (void)sum;
+        store_pmu(seq, pmu_inv0, pmu_inv1, pmu_read0, pmu_read1);
+    }
+    
+    // Store this measurement
+    TRACE(seq, TRACE_RPU_STORE, PHASE_BEGIN, packet_size);
+    store_first_byte(seq, first_ts);
+    store_wait(seq);
+    store_result(packet_size, apu_ts, rpu_ts);
+    TRACE(seq, TRACE_RPU_STORE, PHASE_END, packet_size);
+    
+    // Send ACK back to APU
+    TRACE(seq, TRACE_RPU_ACK, PHASE_BEGIN, packet_size);
+    hdr[0] = MAGIC_ACK;
+    Xil_DCacheFlushRange((INTPTR)hdr, CACHE_LINE_SIZE);
+    TRACE(seq, TRACE_RPU_ACK, PHASE_END, packet_size);
+}
+
+/**
+ * N-buffer receiver, consumes slots round-robin until DONE
+ *
+ * The APU fills the next free slot while we invalidate the current one,
+ * so copy and invalidate overlap instead of adding up. Only one header
+ * line is polled at a time: the slot we expect next, and the control
+ * word while that slot is still empty.
  */
-static void receiver_loop(void)
+static uint32_t nbuf_loop(uint32_t num_slots)
 {
-    uint32_t rpu_ts, apu_ts, packet_size;
+    uint32_t next = 0;
     uint32_t packets_received = 0;
     
-    xil_printf("RPU: Entering receiver loop (INVALIDATION OVERHEAD ONLY)...\r\n");
+    xil_printf("RPU: N-buffer mode, %u slots at 0x%08X\r\n",
+               num_slots, (uint32_t)(SHARED_MEM_BASE + SLOT_OFFSET));
+    
+    while (1) {
+        volatile uint32_t *hdr = (volatile uint32_t *)
+            (SHARED_MEM_BASE + SLOT_OFFSET + next * SLOT_STRIDE);
+        
+        if (hp_enabled) {
+            service_hp(0);
+        }
+        
+        Xil_DCacheInvalidateRange((INTPTR)hdr, CACHE_LINE_SIZE);
+        
+        if (hdr[0] == MAGIC_START) {
+            process_packet(hdr, SLOT_HEADER_SIZE, (volatile uint8_t *)hdr + SLOT_HEADER_SIZE);
+            next = (next + 1) % num_slots;
+            
+            packets_received++;
+            if (packets_received % 100 == 0) {
+                xil_printf("RPU: Received %u packets\r\n", packets_received);
+            }
+            continue;
+        }
+        
+        // APU only sends DONE once every slot is back to free
+        invalidate_control_word();
+        if (shared_mem[0] == MAGIC_DONE) {
+            xil_printf("RPU: Received DONE signal\r\n");
+            break;
+        }
+    }
+    
+    return packets_received;
+}
+
+static inline volatile uint32_t *mpsc_slot(uint32_t slot)
+{
+    return (volatile uint32_t *)(SHARED_MEM_BASE + MPSC_OFFSET + CACHE_LINE_SIZE +
+                                 slot * MPSC_SLOT_STRIDE);
+}
+
+/**
+ * Hand every slot to the producers for lap 0 (slot i expects ticket i)
+ */
+static void mpsc_init(uint32_t num_slots)
+{
+    for (uint32_t i = 0; i < num_slots; i++) {
+        volatile uint32_t *hdr = mpsc_slot(i);
+        hdr[0] = i;
+        Xil_DCacheFlushRange((INTPTR)hdr, CACHE_LINE_SIZE);
+    }
+    mpsc_mem[MPSC_STAT_CONSUMED] = 0;
+    mpsc_mem[MPSC_STAT_CORRUPT] = 0;
+    Xil_DCacheFlushRange((INTPTR)mpsc_mem, CACHE_LINE_SIZE);
+}
+
+/**
+ * MPSC consumer, takes tickets in order until the DONE entry
+ *
+ * Only the slot of the next ticket is polled. A producer that took a ticket
+ * always completes it, so waiting on it can't deadlock. The payload check
+ * (byte i == (ticket + i) & 0xFF) runs after the timestamp, so it catches
+ * torn or mixed-up slots without being part of the latency.
+ */
+static uint32_t mpsc_loop(uint32_t num_slots)
+{
+    uint32_t head = 0;
+    uint32_t packets_received = 0;
+    uint32_t corrupt = 0;
+    
+    xil_printf("RPU: MPSC mode, %u slots at 0x%08X\r\n",
+               num_slots, (uint32_t)(SHARED_MEM_BASE + MPSC_OFFSET));
+    
+    while (1) {
+        volatile uint32_t *hdr = mpsc_slot(head % num_slots);
+        volatile uint8_t *payload = (volatile uint8_t *)hdr + CACHE_LINE_SIZE;
+        
+        Xil_DCacheInvalidateRange((INTPTR)hdr, CACHE_LINE_SIZE);
+        if (hdr[0] != head + 1) {
+            continue;
+        }
+        
+        uint32_t packet_size = hdr[1];
+        uint32_t apu_ts = hdr[2];
+        
+        if (packet_size == MPSC_SIZE_DONE) {
+            xil_printf("RPU: Received DONE entry (ticket %u)\r\n", head);
+            hdr[0] = head + num_slots;
+            Xil_DCacheFlushRange((INTPTR)hdr, CACHE_LINE_SIZE);
+            break;
+        }
+        
+        if (packet_size != MPSC_SIZE_FENCE) {
+            if (packet_size > MPSC_SLOT_STRIDE - CACHE_LINE_SIZE) {
+                packet_size = MPSC_SLOT_STRIDE - CACHE_LINE_SIZE;
+                corrupt++;
+            }
+            if (packet_size > 0) {
+                Xil_DCacheInvalidateRange((INTPTR)payload, packet_size);
+            }
+            dsb();
+            
+            uint32_t rpu_ts = read_timer();
+            store_first_byte(head, rpu_ts);
+            store_result(packet_size, apu_ts, rpu_ts);
+            
+            for (uint32_t i = 0; i < packet_size; i++) {
+                if (payload[i] != (uint8_t)(head + i)) {
+                    corrupt++;
+                    break;
+                }
+            }
+            packets_received++;
+        }
+        
+        // Give the slot back for the producer holding ticket head + N
+        hdr[0] = head + num_slots;
+        Xil_DCacheFlushRange((INTPTR)hdr, CACHE_LINE_SIZE);
+        head++;
+        
+        if (packets_received % 1000 == 0 || packet_size == MPSC_SIZE_FENCE) {
+            mpsc_mem[MPSC_STAT_CONSUMED] = packets_received;
+            mpsc_mem[MPSC_STAT_CORRUPT] = corrupt;
+            Xil_DCacheFlushRange((INTPTR)mpsc_mem, CACHE_LINE_SIZE);
+        }
+    }
+    
+    mpsc_mem[MPSC_STAT_CONSUMED] = packets_received;
+    mpsc_mem[MPSC_STAT_CORRUPT] = corrupt;
+    Xil_DCacheFlushRange((INTPTR)mpsc_mem, CACHE_LINE_SIZE);
+    
+    xil_printf("RPU: MPSC consumed %u entries, %u corrupt\r\n", packets_received, corrupt);
+    return packets_received;
+}
+
+/**
+ * Zero every per-run area and counter, so a run never picks up records
+ * left over from the one before
+ */
+static void clear_run_areas(void)
+{
+    memset((void *)results_mem, 0, 4 + MAX_RESULTS * 20);
+    result_count = 0;
+    Xil_DCacheFlushRange((INTPTR)results_mem, 4 + MAX_RESULTS * 20);
+    
+    // Clear PMU samples too, only sampled packets get a valid marker
+    memset((void *)pmu_mem, 0, MAX_RESULTS * sizeof(pmu_entry_t));
+    Xil_DCacheFlushRange((INTPTR)pmu_mem, MAX_RESULTS * sizeof(pmu_entry_t));
+    
+    memset((void *)first_byte_mem, 0, MAX_RESULTS * sizeof(first_byte_entry_t));
+    Xil_DCacheFlushRange((INTPTR)first_byte_mem, MAX_RESULTS * sizeof(first_byte_entry_t));
+    
+    memset((void *)wait_mem, 0, MAX_RESULTS * sizeof(wait_entry_t));
+    Xil_DCacheFlushRange((INTPTR)wait_mem, MAX_RESULTS * sizeof(wait_entry_t));
+    idle_polls = 0;
+    idle_wakeups = 0;
+    
+    // Priority lane starts free, with no records
+    hp_lane[0] = MAGIC_ACK;
+    Xil_DCacheFlushRange((INTPTR)hp_lane, CACHE_LINE_SIZE);
+    hp_count = 0;
+    flush_hp();
+    
+    // Empty trace ring
+    trace_count = 0;
+    flush_trace();
+}
+
+/**
+ * Put back what a fresh boot would give the next run
+ *
+ * Calibration is kept, it describes the hardware, not the run.
+ */
+static void reset_run_state(void)
+{
+    if (attr_region >= 0) {
+        set_mem_attr(ATTR_WB, 0);
+    }
+    wait_mode = WAIT_SPIN;
+    hp_enabled = 0;
+    inval_crossover = inval_calibrated;
+    run_configured = 0;
+}
+
+/**
+ * Start a run from the APU's descriptor
+ *
+ * The results areas are cleared here rather than after DONE, the APU
+ * reads the last run's results after we've gone back to MAGIC_READY.
+ */
+static void start_run(void)
+{
+    volatile run_desc_t *desc = (volatile run_desc_t *)config_mem;
+    uint32_t num_sizes, packets;
+    const char *strategy;
+    
+    Xil_DCacheInvalidateRange((INTPTR)config_mem, sizeof(run_desc_t));
+    clear_run_areas();
+    run_configured = 1;
+    
+    switch (desc->inval_strategy) {
+    case INVAL_STRAT_RANGE:
+        inval_crossover = 0;
+        strategy = "range";
+        break;
+    case INVAL_STRAT_FULL:
+        inval_crossover = 1;
+        strategy = "whole-cache";
+        break;
+    default:
+        inval_crossover = inval_calibrated;
+        strategy = "calibrated";
+        break;
+    }
+    
+    num_sizes = desc->num_sizes < CONFIG_MAX_SIZES ? desc->num_sizes : CONFIG_MAX_SIZES;
+    packets = num_sizes * desc->iterations;
+    
+    xil_printf("RPU: Run %u: %u sizes (%u-%u B) x %u iterations, %s invalidate\r\n",
+               desc->run_id, num_sizes, num_sizes ? desc->sizes[0] : 0,
+               num_sizes ? desc->sizes[num_sizes - 1] : 0, desc->iterations, strategy);
+    if (packets > MAX_RESULTS) {
+        xil_printf("RPU: WARNING - %u packets, only the first %u results are kept\r\n",
+                   packets, MAX_RESULTS);
+    }
+}
+
+/**
+ * Main receiver loop, one run
+ *
+ * Returns 0 after DONE (results flushed, ready for the next run) and 1
+ * after MAGIC_SHUTDOWN.
+ */
+static int receiver_loop(void)
+{
+    uint32_t packets_received = 0;
+    
+    xil_printf("RPU: Entering receiver loop...\r\n");
     xil_printf("RPU: Waiting for packets at 0x%08X\r\n", (uint32_t)shared_mem);
     
     // Tell APU we're ready to go
@@ -159,8 +1278,18 @@ static void receiver_loop(void)
     flush_control_word();
     
     while (1) {
+        if (wait_mode == WAIT_IPI) {
+            ipi_ack();
+        }
+        
+        // Priority lane always goes first
+        if (hp_enabled) {
+            service_hp(0);
+        }
+        
         // Only invalidate control word for polling
         invalidate_control_word();
+        idle_polls++;
         
         // Check if experiment is done
         if (shared_mem[0] == MAGIC_DONE) {
@@ -168,51 +1297,109 @@ static void receiver_loop(void)
             break;
         }
         
-        // Check for new packet
-        if (shared_mem[0] == MAGIC_START) {
-            /* 
-             * Here's what CCI-400 would save us:
-             * - Invalidating metadata cache lines
-             * - Reading metadata (size and timestamp)
-             * - Invalidating payload cache lines
-             * 
-             * We intentionally don't read through the payload data.
-             * Reading the actual bytes takes time even with hardware coherence,
-             * so we only measure pure cache management overhead here.
-             */
-            
-            // Invalidate metadata area (first 256 bytes = 4 cache lines)
-            Xil_DCacheInvalidateRange((INTPTR)shared_mem, 256);
-            
-            // Grab what we need from metadata
-            packet_size = shared_mem[1];
-            apu_ts = shared_mem[2];
+        // Nothing more to run, leave the server loop
+        if (shared_mem[0] == MAGIC_SHUTDOWN) {
+            xil_printf("RPU: Received SHUTDOWN\r\n");
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            return 1;
+        }
+        
+        // A new run starts, clean slate plus its settings
+        if (shared_mem[0] == MAGIC_CONFIG) {
+            start_run();
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            continue;
+        }
+        
+        // APU wants the N-buffer protocol for the whole run
+        if (shared_mem[0] == MAGIC_NBUF) {
+            uint32_t num_slots = shared_mem[1];
             
-            /* 
-             * Key part: invalidate payload cache lines.
-             * This is the overhead CCI-400 would completely eliminate!
-             * We invalidate but don't actually read - that would add
-             * extra overhead that's not really what we're measuring.
-             */
-            Xil_DCacheInvalidateRange((INTPTR)&shared_mem[4], packet_size);
+            if (num_slots == 0 || num_slots > MAX_SLOTS) {
+                xil_printf("RPU: Invalid slot count %u, ignoring\r\n", num_slots);
+                shared_mem[0] = MAGIC_READY;
+                flush_control_word();
+                continue;
+            }
             
-            /* 
-             * Memory barrier to make sure all invalidations finish before we timestamp.
-             * Important for accurate measurements.
-             */
-            __asm__ __volatile__("dsb sy" ::: "memory");
+            // No descriptor came first, don't append to the last run's records
+            if (!run_configured) {
+                clear_run_areas();
+            }
             
-            // Take timestamp after all the cache work is done
-            rpu_ts = read_timer();
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            packets_received += nbuf_loop(num_slots);
+            break;
+        }
+        
+        // Several APU processes are going to share the MPSC queue
+        if (shared_mem[0] == MAGIC_MPSC) {
+            uint32_t num_slots = shared_mem[1];
             
-            // Store this measurement
-            store_result(packet_size, apu_ts, rpu_ts);
+            // One slot can't tell a freed entry from a new one, need two
+            if (num_slots < 2 || num_slots > MPSC_MAX_SLOTS) {
+                xil_printf("RPU: Invalid MPSC slot count %u, ignoring\r\n", num_slots);
+                shared_mem[0] = MAGIC_READY;
+                flush_control_word();
+                continue;
+            }
             
-            packets_received++;
+            // apu_mpsc_sender sends no descriptor, start from clean areas
+            if (!run_configured) {
+                clear_run_areas();
+            }
             
-            // Send ACK back to APU
+            mpsc_init(num_slots);
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            packets_received += mpsc_loop(num_slots);
+            break;
+        }
+        
+        // APU switches the idle wait, it rings the IPI from now on (or stops)
+        if (shared_mem[0] == MAGIC_WAIT) {
+            if (shared_mem[1] == WAIT_IPI) {
+                init_ipi_wake();
+            }
+            wait_mode = shared_mem[1] == WAIT_IPI ? WAIT_IPI : WAIT_SPIN;
+            xil_printf("RPU: Idle wait is now %s\r\n", wait_mode == WAIT_IPI ? "WFI + IPI" : "spin");
             shared_mem[0] = MAGIC_ACK;
             flush_control_word();
+            continue;
+        }
+        
+        // APU adds (or drops) the priority lane next to the bulk mailbox
+        if (shared_mem[0] == MAGIC_LANES) {
+            hp_enabled = shared_mem[1] != 0;
+            xil_printf("RPU: Priority lane %s at 0x%08X\r\n", hp_enabled ? "on" : "off",
+                       (uint32_t)hp_lane);
+            shared_mem[0] = MAGIC_ACK;
+            flush_control_word();
+            continue;
+        }
+        
+        // APU is about to run the sweep with different memory attributes
+        if (shared_mem[0] == MAGIC_ATTR) {
+            uint32_t attr = shared_mem[1];
+            
+            if (attr < NUM_ATTRS) {
+                set_mem_attr(attr, shared_mem[2] != 0);
+                shared_mem[0] = MAGIC_ACK;
+            } else {
+                xil_printf("RPU: Invalid memory attribute %u, ignoring\r\n", attr);
+                shared_mem[0] = MAGIC_READY;
+            }
+            flush_control_word();
+            continue;
+        }
+        
+        // Check for new packet (metadata area is the first 256 bytes = 4 cache lines)
+        if (shared_mem[0] == MAGIC_START) {
+            process_packet(shared_mem, 256, (volatile uint8_t *)&shared_mem[4]);
+            packets_received++;
             
             // Print progress every 100 packets
             if (packets_received % 100 == 0) {
@@ -220,8 +1407,13 @@ static void receiver_loop(void)
             }
         }
         
-        // Small delay between poll attempts
-        for (volatile int i = 0; i < 10; i++);
+        // Sleep until the next ring, or a small delay between poll attempts
+        if (wait_mode == WAIT_IPI) {
+            wfi();
+            idle_wakeups++;
+        } else {
+            for (volatile int i = 0; i < 10; i++);
+        }
     }
     
     xil_printf("RPU: Total packets: %u\r\n", packets_received);
@@ -229,6 +1421,14 @@ static void receiver_loop(void)
     // Write count and flush everything to memory
     results_mem[0] = result_count;
     flush_results();
+    flush_trace();
+    flush_pmu();
+    flush_first_byte();
+    flush_wait();
+    flush_hp();
+    
+    reset_run_state();
+    return 0;
 }
 
 /**
@@ -236,27 +1436,34 @@ static void receiver_loop(void)
  */
 int main(void)
 {
+    uint32_t runs = 0;
+    
     xil_printf("\r\n========================================\r\n");
     xil_printf("RPU Cache Invalidation Overhead Measurement\r\n");
     xil_printf("========================================\r\n");
-    xil_printf("Shared Memory: 0x%08X\r\n", SHARED_MEM_BASE);
-    xil_printf("Results Area:  0x%08X\r\n", SHARED_MEM_BASE + RESULTS_OFFSET);
-    xil_printf("TTC0 Base:     0x%08X\r\n", TTC0_BASE);
-    xil_printf("\r\nNOTE: This version measures ONLY cache invalidation\r\n");
-    xil_printf("overhead, NOT the time to read/process the actual data.\r\n");
-    xil_printf("This represents the cost that CCI-400 would eliminate.\r\n");
+    xil_printf("Shared Memory: 0x%08X\r\n", (uint32_t)SHARED_MEM_BASE);
+    xil_printf("Results Area:  0x%08X\r\n", (uint32_t)(SHARED_MEM_BASE + RESULTS_OFFSET));
+    xil_printf("TTC0 Base:     0x%08X\r\n", (uint32_t)TTC0_BASE);
+    xil_printf("\r\nNOTE: By default this measures cache invalidation\r\n");
+    xil_printf("overhead only, the cost that CCI-400 would eliminate.\r\n");
+    xil_printf("The memory attribute sweep (consume mode) also times\r\n");
+    xil_printf("reading the whole payload.\r\n");
     xil_printf("========================================\r\n\r\n");
     
     init_timer();
+    init_pmu();
+    calibrate_timer();
+    calibrate_invalidate();
     
-    // Clear results area
-    memset((void *)results_mem, 0, 4 + MAX_RESULTS * 20);
-    result_count = 0;
-    Xil_DCacheFlushRange((INTPTR)results_mem, 4 + MAX_RESULTS * 20);
+    clear_run_areas();
     
-    receiver_loop();
+    // Stay resident: one run per CONFIG ... DONE until the APU says SHUTDOWN
+    while (receiver_loop() == 0) {
+        runs++;
+        xil_printf("RPU: Run %u complete, back to READY\r\n", runs);
+    }
     
-    xil_printf("\r\nRPU: Experiment complete.\r\n");
+    xil_printf("\r\nRPU: Experiment complete after %u runs.\r\n", runs);
     
     // Just hang here when we're done
     while (1) {
@@ -7,10 +7,8 @@
 #include <sys/mman.h>
 #include <time.h>
 #include <errno.h>
-
-/* TCM Setup */
-#define TCM_BASE            0xFFE00000UL
-#define TCM_SIZE            0x10000UL     /* 64KB */
+#include "result_codec.h"
+#include "tcm_protocol.h"
 
 /* TTC0 Timer 0 Registers */
 #define TTC0_BASE           0xFF110000UL
@@ -22,10 +20,6 @@
 /* Timer frequency */
 #define TIMER_FREQ_MHZ      100.0
 
-/* Results storage offset in TCM */
-#define RESULTS_OFFSET      0x2000UL      /* Results at offset 8KB */
-#define MAX_RESULTS         1000
-
 /* Packet sizes to test (in bytes), limited by TCM size */
 static const uint32_t packet_sizes[] = {
     1,      /* Minimum */
@@ -40,37 +34,6 @@ static const uint32_t packet_sizes[] = {
 };
 #define NUM_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
 
-/* Shared Data Structure (matches RPU) */
-typedef struct {
-    volatile uint32_t command;
-    volatile uint32_t packet_size;    /* Size of data to process */
-    volatile uint32_t apu_timestamp;  /* When APU sent */
-    volatile uint32_t rpu_timestamp;  /* When RPU received (filled by RPU) */
-    volatile uint32_t status;
-    volatile uint32_t _pad[3];
-    /* Data payload starts here at offset 32 bytes */
-    volatile uint8_t data[4096];
-} __attribute__((packed, aligned(16))) TCM_Protocol;
-
-/* Result structure, matches RPU output */
-typedef struct {
-    uint32_t packet_size;
-    uint32_t apu_timestamp;
-    uint32_t rpu_timestamp;
-    uint32_t delta_ticks;
-    uint32_t valid;
-} __attribute__((packed)) result_entry_t;
-
-/* Command codes */
-#define CMD_IDLE        0x00000000
-#define CMD_PROCESS     0x12345678
-#define CMD_SHUTDOWN    0x87654321
-
-/* Status codes */
-#define STATUS_READY    0xAAAAAAAA
-#define STATUS_BUSY     0xBBBBBBBB
-#define STATUS_DONE     0xCCCCCCCC
-
 /* Global pointers */
 static volatile TCM_Protocol *tcm_proto = NULL;
 static volatile uint32_t *results_mem = NULL;
@@ -102,7 +65,7 @@ static int map_memory(void)
     }
     
     /* Results area is inside TCM */
-    results_mem = (volatile uint32_t *)((uint8_t *)tcm_proto + RESULTS_OFFSET);
+    results_mem = (volatile uint32_t *)((uint8_t *)tcm_proto + TCM_RESULTS_OFFSET);
     
     /* Map TTC0 timer */
     timer_regs = (volatile uint32_t *)mmap(
@@ -119,7 +82,7 @@ static int map_memory(void)
     }
     
     printf("APU: TCM mapped at %p (phys 0x%08lX)\n", (void *)tcm_proto, TCM_BASE);
-    printf("APU: Results area at %p (offset 0x%04lX)\n", (void *)results_mem, RESULTS_OFFSET);
+    printf("APU: Results area at %p (offset 0x%04lX)\n", (void *)results_mem, TCM_RESULTS_OFFSET);
     printf("APU: TTC0 mapped at %p (phys 0x%08lX)\n", (void *)timer_regs, TTC0_BASE);
     
     return 0;
@@ -232,7 +195,7 @@ static int send_packet(uint32_t size, uint8_t *payload)
     uint32_t ts_start;
     
     /* Make sure size fits in TCM */
-    if (size > 4096) {
+    if (size > TCM_PAYLOAD_MAX) {
         fprintf(stderr, "APU: Packet size %u too large for TCM\n", size);
         return -1;
     }
@@ -267,38 +230,85 @@ static int send_packet(uint32_t size, uint8_t *payload)
     return 0;
 }
 
+/**
+ * Write one decoded compact sample as a CSV row
+ */
+static void write_sample(void *ctx, uint32_t size, uint32_t apu_ts,
+                         uint32_t rpu_ts, uint32_t delta)
+{
+    fprintf((FILE *)ctx, "%u,%u,%u,%u,%.3f\n",
+            size, apu_ts, rpu_ts, delta, (double)delta / TIMER_FREQ_MHZ);
+}
+
+/**
+ * Expand compact results (see result_codec.h)
+ */
+static int read_compact_results(FILE *fp)
+{
+    uint8_t *copy;
+    uint32_t bad_blocks;
+    int count;
+    
+    /* Decode from a normal buffer, not byte by byte through /dev/mem */
+    copy = malloc(TCM_RESULTS_CAPACITY);
+    if (!copy) {
+        perror("Failed to allocate results buffer");
+        return -1;
+    }
+    memcpy(copy, (const void *)results_mem, TCM_RESULTS_CAPACITY);
+    
+    printf("APU: Compact results, %u samples in %u bytes\n",
+           rc_get_u32(copy + 4), RC_STREAM_HEADER + rc_get_u32(copy + 8));
+    
+    count = rc_decode(copy, TCM_RESULTS_CAPACITY, write_sample, fp, &bad_blocks);
+    free(copy);
+    
+    if (bad_blocks > 0) {
+        fprintf(stderr, "APU: WARNING - %u corrupted result blocks skipped\n", bad_blocks);
+    }
+    if (count <= 0) {
+        fprintf(stderr, "APU: No valid compact results\n");
+        return -1;
+    }
+    
+    printf("APU: Successfully decoded %d results\n", count);
+    return 0;
+}
+
 /**
  * Read results from RPU
+ *
+ * The RPU writes either raw records (count, then 20 bytes each) or a
+ * compact stream; the first word tells them apart.
  */
 static int read_results(FILE *fp)
 {
-    uint32_t count = results_mem[0];
+    volatile result_area_t *area = CHAN_VIEW(result_area_t, results_mem, 0);
+    uint32_t count = area->count;
+    
+    if (count == RC_STREAM_MAGIC) {
+        return read_compact_results(fp);
+    }
     
     printf("APU: Reading %u results from RPU...\n", count);
     
-    if (count == 0 || count > MAX_RESULTS) {
+    if (count == 0 || count > TCM_MAX_RESULTS) {
         fprintf(stderr, "APU: Invalid result count: %u\n", count);
         return -1;
     }
     
     for (uint32_t i = 0; i < count; i++) {
-        uint32_t offset = 1 + (i * 5);
-        
-        uint32_t pkt_size = results_mem[offset + 0];
-        uint32_t apu_ts = results_mem[offset + 1];
-        uint32_t rpu_ts = results_mem[offset + 2];
-        uint32_t delta_ticks = results_mem[offset + 3];
-        uint32_t valid = results_mem[offset + 4];
+        volatile result_entry_t *r = &area->entries[i];
         
-        if (valid != 0xA5A5A5A5) {
+        if (r->valid != 0xA5A5A5A5) {
             fprintf(stderr, "APU: Invalid result marker at index %u\n", i);
             continue;
         }
         
-        double delta_us = (double)delta_ticks / TIMER_FREQ_MHZ;
+        double delta_us = (double)r->delta_ticks / TIMER_FREQ_MHZ;
         
         fprintf(fp, "%u,%u,%u,%u,%.3f\n",
-                pkt_size, apu_ts, rpu_ts, delta_ticks, delta_us);
+                r->packet_size, r->apu_timestamp, r->rpu_timestamp, r->delta_ticks, delta_us);
     }
     
     printf("APU: Successfully read %u results\n", count);
@@ -340,7 +350,7 @@ static int run_experiment(int iterations_per_size, const char *output_file)
     
     /* Clear results area */
     printf("APU: Clearing results area...\n");
-    memset((void *)results_mem, 0, 4 + MAX_RESULTS * 20);
+    memset((void *)results_mem, 0, sizeof(result_area_t));
     
     /* Wait for RPU to be ready */
     if (wait_for_rpu_ready(30) != 0) {
@@ -0,0 +1,267 @@
+#include <stdint.h>
+#include <string.h>
+#include "xil_printf.h"
+#include "xil_cache.h"
+#include "xil_io.h"
+#include "xpseudo_asm.h"
+#include "ddr_layout.h"
+
+/*
+ * RPU -> APU sender (reverse direction), optionally full duplex
+ *
+ * Counterpart of rpu_receiver_ddr.c for data flowing up to Linux, like our
+ * sensor streams. Here the RPU pays for a flush instead of an invalidate,
+ * and the APU for an invalidate or an uncached read.
+ *
+ * Reverse channel at REV_OFFSET: one header line (magic, size, timestamp,
+ * seq, fill start) plus payload. The payload is (seq + i) & 0xFF, so the
+ * APU can tell stale data from fresh.
+ *
+ * In duplex mode we also serve the normal APU -> RPU channel (control word
+ * + payload at the start of the window) at the same time, interleaved in
+ * one polling loop, and store its results in the usual results area.
+ */
+
+/* Shared window layout and control word values are in ddr_layout.h */
+#define CACHE_LINE_SIZE     64  /* ARM cache line size */
+
+/* Reverse channel (must match APU side) */
+#define REV_HEADER_SIZE     CACHE_LINE_SIZE
+#define REV_START           0x0F0F0F0FUL  /* Packet ready, APU owns the buffer */
+#define REV_ACK             0xF0F0F0F0UL  /* APU is done with it, RPU owns the buffer */
+#define REV_DONE            0xFFFFFFFFUL  /* Sweep finished */
+#define REV_GAP_TICKS       10000         /* 100 us between packets, like the APU sender */
+
+/* TTC0 Timer 0 Registers */
+#define TTC0_BASE           0xFF110000UL
+#define TTC0_CLK_CTRL       (TTC0_BASE + 0x00)
+#define TTC0_CNT_CTRL       (TTC0_BASE + 0x0C)
+#define TTC0_CNT_VAL        (TTC0_BASE + 0x18)
+
+/* Same sweep as apu_sender_ddr.c */
+static const uint32_t packet_sizes[] = {
+    1, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+#define NUM_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
+
+volatile uint32_t *shared_mem = (volatile uint32_t *)SHARED_MEM_BASE;
+volatile uint32_t *rev_mem = (volatile uint32_t *)(SHARED_MEM_BASE + REV_OFFSET);
+volatile uint32_t *results_mem = (volatile uint32_t *)(SHARED_MEM_BASE + RESULTS_OFFSET);
+
+static uint32_t result_count = 0;
+
+/**
+ * Initialize TTC0 Timer 0
+ */
+static void init_timer(void)
+{
+    xil_printf("RPU: Initializing TTC0 Timer 0...\r\n");
+    
+    Xil_Out32(TTC0_CNT_CTRL, 0x01);
+    Xil_Out32(TTC0_CLK_CTRL, 0x00);
+    Xil_Out32(TTC0_CNT_CTRL, 0x00);
+}
+
+static inline uint32_t read_timer(void)
+{
+    return Xil_In32(TTC0_CNT_VAL);
+}
+
+static inline void invalidate_control_word(void)
+{
+    Xil_DCacheInvalidateRange((INTPTR)shared_mem, CACHE_LINE_SIZE);
+}
+
+static inline void flush_control_word(void)
+{
+    Xil_DCacheFlushRange((INTPTR)shared_mem, CACHE_LINE_SIZE);
+}
+
+/**
+ * Store a result entry (same format as rpu_receiver_ddr.c)
+ */
+static void store_result(uint32_t pkt_size, uint32_t apu_ts, uint32_t rpu_ts)
+{
+    if (result_count >= MAX_RESULTS) return;
+    
+    uint32_t offset = 1 + (result_count * 5);
+    results_mem[offset + 0] = pkt_size;
+    results_mem[offset + 1] = apu_ts;
+    results_mem[offset + 2] = rpu_ts;
+    results_mem[offset + 3] = rpu_ts - apu_ts;  /* unsigned, wraps correctly */
+    results_mem[offset + 4] = 0xA5A5A5A5UL;
+    
+    result_count++;
+}
+
+/**
+ * Serve one packet on the APU -> RPU channel, if there is one
+ *
+ * Plain invalidate-only receive, as rpu_receiver_ddr.c does by default.
+ */
+static int poll_forward(void)
+{
+    invalidate_control_word();
+    if (shared_mem[0] != MAGIC_START) {
+        return 0;
+    }
+    
+    Xil_DCacheInvalidateRange((INTPTR)shared_mem, 256);
+    uint32_t packet_size = shared_mem[1];
+    uint32_t apu_ts = shared_mem[2];
+    
+    Xil_DCacheInvalidateRange((INTPTR)&shared_mem[4], packet_size);
+    dsb();
+    store_result(packet_size, apu_ts, read_timer());
+    
+    shared_mem[0] = MAGIC_ACK;
+    flush_control_word();
+    return 1;
+}
+
+/**
+ * Write one packet into the reverse buffer and hand it to the APU
+ *
+ * The timestamp goes after producing the data and before the flush, so
+ * like the forward direction the sender's cache maintenance is inside
+ * the measured interval.
+ */
+static void send_reverse(uint32_t seq, uint32_t size)
+{
+    volatile uint8_t *payload = (volatile uint8_t *)rev_mem + REV_HEADER_SIZE;
+    uint32_t fill_ts = read_timer();
+    uint32_t rpu_ts;
+    
+    for (uint32_t i = 0; i < size; i++) {
+        payload[i] = (uint8_t)(seq + i);
+    }
+    
+    rpu_ts = read_timer();
+    Xil_DCacheFlushRange((INTPTR)payload, size);
+    
+    rev_mem[1] = size;
+    rev_mem[2] = rpu_ts;
+    rev_mem[3] = seq;
+    rev_mem[4] = fill_ts;
+    
+    // Payload must be in DDR before the APU can see REV_START
+    dsb();
+    Xil_DCacheFlushRange((INTPTR)rev_mem, REV_HEADER_SIZE);
+    rev_mem[0] = REV_START;
+    Xil_DCacheFlushRange((INTPTR)rev_mem, REV_HEADER_SIZE);
+}
+
+static inline int reverse_acked(void)
+{
+    Xil_DCacheInvalidateRange((INTPTR)rev_mem, REV_HEADER_SIZE);
+    return rev_mem[0] == REV_ACK;
+}
+
+/**
+ * Reverse sweep, serving the forward channel in between when duplex
+ *
+ * One loop, no blocking waits, so neither direction stalls the other
+ * beyond the time of a single packet.
+ */
+static void sender_loop(uint32_t iterations, int duplex)
+{
+    uint32_t size_idx = 0, iter = 0, seq = 0;
+    uint32_t next_send = read_timer();
+    uint32_t forward = 0;
+    int waiting_ack = 0;
+    int reverse_done = 0;
+    
+    xil_printf("RPU: Reverse sweep, %u iterations per size%s\r\n",
+               iterations, duplex ? ", full duplex" : "");
+    
+    while (!reverse_done || duplex) {
+        if (duplex) {
+            forward += poll_forward();
+            
+            // The APU sends DONE on the forward channel when its sweep is over
+            if (shared_mem[0] == MAGIC_DONE && reverse_done) {
+                break;
+            }
+        }
+        
+        if (reverse_done) {
+            continue;
+        }
+        
+        if (waiting_ack) {
+            if (!reverse_acked()) {
+                continue;
+            }
+            waiting_ack = 0;
+            next_send = read_timer() + REV_GAP_TICKS;
+            
+            if (++iter == iterations) {
+                xil_printf("RPU: Completed %u iterations for size %u\r\n",
+                           iterations, packet_sizes[size_idx]);
+                iter = 0;
+                if (++size_idx == NUM_SIZES) {
+                    rev_mem[0] = REV_DONE;
+                    Xil_DCacheFlushRange((INTPTR)rev_mem, REV_HEADER_SIZE);
+                    reverse_done = 1;
+                }
+            }
+            continue;
+        }
+        
+        if ((int32_t)(read_timer() - next_send) >= 0) {
+            send_reverse(seq++, packet_sizes[size_idx]);
+            waiting_ack = 1;
+        }
+    }
+    
+    xil_printf("RPU: Sent %u packets, received %u\r\n", seq, forward);
+}
+
+/**
+ * Main
+ */
+int main(void)
+{
+    xil_printf("\r\n========================================\r\n");
+    xil_printf("RPU -> APU Transfer Measurement (sender)\r\n");
+    xil_printf("========================================\r\n");
+    xil_printf("Reverse buffer: 0x%08X\r\n", (uint32_t)(SHARED_MEM_BASE + REV_OFFSET));
+    xil_printf("Results Area:   0x%08X\r\n", (uint32_t)(SHARED_MEM_BASE + RESULTS_OFFSET));
+    xil_printf("========================================\r\n\r\n");
+    
+    init_timer();
+    
+    memset((void *)results_mem, 0, 4 + MAX_RESULTS * 20);
+    Xil_DCacheFlushRange((INTPTR)results_mem, 4 + MAX_RESULTS * 20);
+    
+    // The reverse buffer starts out ours
+    rev_mem[0] = REV_ACK;
+    Xil_DCacheFlushRange((INTPTR)rev_mem, REV_HEADER_SIZE);
+    
+    shared_mem[0] = MAGIC_READY;
+    flush_control_word();
+    
+    xil_printf("RPU: Waiting for the APU receiver...\r\n");
+    do {
+        invalidate_control_word();
+    } while (shared_mem[0] != MAGIC_REVERSE);
+    
+    uint32_t iterations = shared_mem[1];
+    int duplex = shared_mem[2] != 0;
+    
+    shared_mem[0] = MAGIC_ACK;
+    flush_control_word();
+    
+    sender_loop(iterations, duplex);
+    
+    results_mem[0] = result_count;
+    Xil_DCacheFlushRange((INTPTR)results_mem, 4 + result_count * 20);
+    
+    xil_printf("\r\nRPU: Experiment complete.\r\n");
+    
+    while (1) {
+        for (volatile int i = 0; i < 1000000; i++);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Typed views onto APU <-> RPU shared memory
+ *
+ * Every protocol here is a struct both cores overlay on the same physical
+ * bytes, built by two different compilers. Define the struct once, in a
+ * header both sides include, and pin its layout with the checks below: a
+ * field that moves, a struct that grows or an area that stops fitting
+ * then breaks the build of whichever side changed, instead of the other
+ * side silently reading the wrong word.
+ *
+ * Views are casts, nothing is copied. Offsets and sizes are checked at
+ * compile time. Only the base address (an mmap() result, a firmware
+ * constant) is checked at run time.
+ *
+ * Header only, C11 or C++11, and kernel modules.
+ */
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#ifdef __KERNEL__
+#include <linux/stddef.h>
+#include <linux/types.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#define CHAN_CACHE_LINE     64  /* A53 line, an R5F line (32 B) never straddles one */
+
+#ifdef __cplusplus
+#define CHAN_STATIC_ASSERT(cond, msg)   static_assert(cond, msg)
+#define CHAN_ALIGNOF(type)              alignof(type)
+#else
+#define CHAN_STATIC_ASSERT(cond, msg)   _Static_assert(cond, msg)
+#define CHAN_ALIGNOF(type)              _Alignof(type)
+#endif
+
+/* type is exactly size bytes */
+#define CHAN_ASSERT_SIZE(type, size) \
+    CHAN_STATIC_ASSERT(sizeof(type) == (size), #type " must be " #size " bytes")
+
+/* field is at byte offset off inside type */
+#define CHAN_ASSERT_OFFSET(type, field, off) \
+    CHAN_STATIC_ASSERT(offsetof(type, field) == (off), #type "." #field " must be at " #off)
+
+/* type is aligned to at least align bytes */
+#define CHAN_ASSERT_ALIGN(type, align) \
+    CHAN_STATIC_ASSERT(CHAN_ALIGNOF(type) >= (align), #type " must be " #align "-byte aligned")
+
+/* field starts a cache line, so maintenance on it never touches its neighbours */
+#define CHAN_ASSERT_LINE_START(type, field) \
+    CHAN_STATIC_ASSERT(offsetof(type, field) % CHAN_CACHE_LINE == 0, \
+                       #type "." #field " must start a cache line")
+
+/* type placed at off stays inside a region of region_size bytes */
+#define CHAN_ASSERT_FITS(type, off, region_size) \
+    CHAN_STATIC_ASSERT((off) % CHAN_ALIGNOF(type) == 0 && (off) + sizeof(type) <= (region_size), \
+                       #type " doesn't fit at " #off)
+
+/* The area [a_off, a_off + a_size) ends before b_off */
+#define CHAN_ASSERT_BEFORE(a_off, a_size, b_off) \
+    CHAN_STATIC_ASSERT((a_off) + (a_size) <= (b_off), "area at " #a_off " runs into " #b_off)
+
+/**
+ * Address of off bytes into base, NULL if it's not align-byte aligned
+ */
+static inline volatile void *chan_view_ptr(volatile void *base, size_t off, size_t align)
+{
+    uintptr_t p = (uintptr_t)base + off;
+
+    return (p % align) ? NULL : (volatile void *)p;
+}
+
+/* In-place volatile view of a type at off bytes into base, NULL if misaligned */
+#define CHAN_VIEW(type, base, off) \
+    ((volatile type *)chan_view_ptr((volatile void *)(base), (off), CHAN_ALIGNOF(type)))
+
+#endif /* SHM_CHANNEL_H */
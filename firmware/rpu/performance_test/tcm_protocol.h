@@ -0,0 +1,76 @@
+/*
+ * TCM protocol, the one copy every side includes
+ *
+ * Protocol block at the start of the R5F TCM, results area at
+ * TCM_RESULTS_OFFSET: a u32 count followed by result_entry_t records, or a
+ * compact stream (see result_codec.h). The layout checks at the bottom
+ * break the build if the definitions change in a way that moves data.
+ */
+#ifndef TCM_PROTOCOL_H
+#define TCM_PROTOCOL_H
+
+#include <stdint.h>
+#include "shm_channel.h"
+
+/* TCM Setup */
+#define TCM_BASE            0xFFE00000UL
+#define TCM_SIZE            0x10000UL     /* 64KB */
+#define TCM_PAYLOAD_MAX     4096
+
+/* Results storage offset in TCM */
+#define TCM_RESULTS_OFFSET  0x2000UL      /* Results at offset 8KB */
+#define TCM_MAX_RESULTS     1000          /* Raw 20-byte records */
+#define TCM_RESULTS_CAPACITY (TCM_SIZE - TCM_RESULTS_OFFSET)  /* Compact records use all of it */
+
+/* Shared Data Structure */
+typedef struct {
+    volatile uint32_t command;
+    volatile uint32_t packet_size;    /* Size of data to process */
+    volatile uint32_t apu_timestamp;  /* When APU sent */
+    volatile uint32_t rpu_timestamp;  /* When RPU received (filled by RPU) */
+    volatile uint32_t status;
+    volatile uint32_t _pad[3];        /* Padding to get a 32-byte header */
+    /* Data payload starts here at offset 32 bytes */
+    volatile uint8_t data[TCM_PAYLOAD_MAX];
+} __attribute__((packed, aligned(16))) TCM_Protocol;
+
+/* One raw result record */
+typedef struct {
+    uint32_t packet_size;
+    uint32_t apu_timestamp;
+    uint32_t rpu_timestamp;
+    uint32_t delta_ticks;
+    uint32_t valid;
+} __attribute__((packed)) result_entry_t;
+
+/* Raw results area: count, then the records */
+typedef struct {
+    uint32_t count;
+    result_entry_t entries[TCM_MAX_RESULTS];
+} __attribute__((packed)) result_area_t;
+
+/* Command codes */
+#define CMD_IDLE        0x00000000
+#define CMD_PROCESS     0x12345678
+#define CMD_SHUTDOWN    0x87654321
+
+/* Status codes */
+#define STATUS_READY    0xAAAAAAAA
+#define STATUS_BUSY     0xBBBBBBBB
+#define STATUS_DONE     0xCCCCCCCC
+
+/* Layout both cores rely on */
+CHAN_ASSERT_OFFSET(TCM_Protocol, command, 0);
+CHAN_ASSERT_OFFSET(TCM_Protocol, packet_size, 4);
+CHAN_ASSERT_OFFSET(TCM_Protocol, apu_timestamp, 8);
+CHAN_ASSERT_OFFSET(TCM_Protocol, rpu_timestamp, 12);
+CHAN_ASSERT_OFFSET(TCM_Protocol, status, 16);
+CHAN_ASSERT_OFFSET(TCM_Protocol, data, 32);
+CHAN_ASSERT_SIZE(TCM_Protocol, 32 + TCM_PAYLOAD_MAX);
+CHAN_ASSERT_ALIGN(TCM_Protocol, 16);
+CHAN_ASSERT_SIZE(result_entry_t, 20);
+CHAN_ASSERT_OFFSET(result_area_t, entries, 4);
+CHAN_ASSERT_BEFORE(0, sizeof(TCM_Protocol), TCM_RESULTS_OFFSET);
+CHAN_ASSERT_FITS(result_area_t, TCM_RESULTS_OFFSET, TCM_SIZE);
+
+#endif /* TCM_PROTOCOL_H */
@@ -0,0 +1,648 @@
+/*
+ * APU MPSC sender
+ *
+ * Several producer processes feeding one RPU through the MPSC queue.
+ *
+ * Producers claim a ticket t with an atomic add on a counter that lives in
+ * normal (cacheable, coherent) Linux shared memory. Only the A53 cores ever
+ * touch it, so the exclusives work as usual. Slot t % N in the shared
+ * window is ours once its sequence word reads t; we write the payload and
+ * header and publish t + 1. The RPU consumes tickets in order and hands
+ * the slot back with t + N. Each sequence word has exactly one writer at
+ * any time, so the window itself never needs atomics, and the RPU only
+ * needs its usual invalidate/flush of one header line.
+ *
+ * The run is a scaling sweep: 1, 2, 4 ... up to -p producers, each sending
+ * -n packets per round. It doubles as a stress test, the RPU checks every
+ * payload and we check every ticket arrived exactly once, in order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include "ddr_layout.h"
+
+/* Physical memory device, the host backend maps the emulator's file instead */
+#ifdef HOST_BACKEND
+#define MEM_DEVICE          "/dev/shm/rpu_emulator"
+#else
+#define MEM_DEVICE          "/dev/mem"
+#endif
+
+/* Ticket counter, APU-only memory (POSIX shm, so any process can attach) */
+#define TICKET_SHM_NAME     "/rpu_mpsc_tickets"
+
+/* Shared window layout and control word values are in ddr_layout.h */
+#define CACHE_LINE_SIZE     64
+
+/* TTC0 Timer Registers */
+#define TTC0_BASE           0xFF110000UL
+#define TTC0_SIZE           0x1000UL
+#define TTC0_CNT_CTRL       0x0C  /* Counter Control */
+#define TTC0_CNT_VAL        0x18  /* Counter Value */
+#define TIMER_FREQ_MHZ      100.0
+
+/* MPSC slot contents (must match RPU side) */
+#define MPSC_MAX_PAYLOAD    (MPSC_SLOT_STRIDE - CACHE_LINE_SIZE)
+#define MPSC_SIZE_FENCE     0xFFFFFFFEUL  /* No payload, just released (drain marker) */
+#define MPSC_SIZE_DONE      0xFFFFFFFFUL  /* Last entry of the run */
+#define MPSC_STAT_CONSUMED  0
+#define MPSC_STAT_CORRUPT   1
+
+#define MAX_PRODUCERS       64
+#define MAX_ROUNDS          8             /* 1, 2, 4 ... 64 and the odd max */
+#define COORDINATOR_ID      0xFF          /* Producer id of our fence/DONE entries */
+#define SLOT_WARN_TICKS     100000000UL   /* 1 s, warn once if a slot stays busy */
+
+/*
+ * Ticket state shared by all producers. A claimed ticket must always be
+ * completed (the consumer waits on it), so producers never give up on a
+ * slot, they only warn.
+ */
+typedef struct {
+    uint32_t tail;                      /* next ticket, __atomic only */
+    uint32_t attached;                  /* producers at the start barrier */
+    uint32_t go;                        /* start of the round */
+    uint32_t slow_waits;                /* slot waits past SLOT_WARN_TICKS */
+    uint8_t owner[MAX_RESULTS];         /* producer id per ticket, for the CSV */
+} mpsc_tickets_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+} __attribute__((packed)) first_byte_entry_t;
+
+CHAN_ASSERT_SIZE(first_byte_entry_t, FIRST_BYTE_ENTRY_SIZE);
+
+typedef struct {
+    uint32_t producers;
+    uint32_t first_ticket;
+    uint32_t last_ticket;               /* the fence */
+    double elapsed_us;
+} round_t;
+
+/* Global pointers */
+static volatile uint32_t *shared_mem = NULL;
+static volatile uint32_t *timer_regs = NULL;
+static volatile uint32_t *results_mem = NULL;
+static volatile uint32_t *first_byte_mem = NULL;
+static volatile uint32_t *mpsc_mem = NULL;
+static mpsc_tickets_t *tickets = NULL;
+static int mem_fd = -1;
+
+static uint32_t num_slots = 16;
+static round_t rounds[MAX_ROUNDS];
+static uint32_t num_rounds = 0;
+
+/**
+ * Map the shared window and TTC0, same as apu_sender_ddr
+ */
+static int map_memory(void)
+{
+    mem_fd = open(MEM_DEVICE, O_RDWR | O_SYNC);
+    if (mem_fd < 0) {
+        perror("Failed to open " MEM_DEVICE);
+        return -1;
+    }
+    
+    shared_mem = (volatile uint32_t *)mmap(NULL, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED, mem_fd, SHARED_MEM_BASE);
+    if (shared_mem == MAP_FAILED) {
+        perror("Failed to map shared memory");
+        close(mem_fd);
+        return -1;
+    }
+    
+    timer_regs = (volatile uint32_t *)mmap(NULL, TTC0_SIZE, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED, mem_fd, TTC0_BASE);
+    if (timer_regs == MAP_FAILED) {
+        perror("Failed to map TTC0 registers");
+        munmap((void *)shared_mem, SHARED_MEM_SIZE);
+        close(mem_fd);
+        return -1;
+    }
+    
+    results_mem = (volatile uint32_t *)((uint8_t *)shared_mem + RESULTS_OFFSET);
+    first_byte_mem = (volatile uint32_t *)((uint8_t *)shared_mem + FIRST_BYTE_OFFSET);
+    mpsc_mem = (volatile uint32_t *)((uint8_t *)shared_mem + MPSC_OFFSET);
+    
+    printf("APU: Memory mapped successfully\n");
+    return 0;
+}
+
+static void unmap_memory(void)
+{
+    if (timer_regs != MAP_FAILED && timer_regs != NULL) {
+        munmap((void *)timer_regs, TTC0_SIZE);
+    }
+    if (shared_mem != MAP_FAILED && shared_mem != NULL) {
+        munmap((void *)shared_mem, SHARED_MEM_SIZE);
+    }
+    if (mem_fd >= 0) {
+        close(mem_fd);
+    }
+}
+
+/**
+ * Create the ticket counter, fresh for this run
+ */
+static int map_tickets(void)
+{
+    int fd = shm_open(TICKET_SHM_NAME, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("Failed to create " TICKET_SHM_NAME);
+        return -1;
+    }
+    
+    if (ftruncate(fd, sizeof(mpsc_tickets_t)) < 0) {
+        perror("Failed to size " TICKET_SHM_NAME);
+        close(fd);
+        return -1;
+    }
+    
+    tickets = mmap(NULL, sizeof(mpsc_tickets_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (tickets == MAP_FAILED) {
+        perror("Failed to map " TICKET_SHM_NAME);
+        return -1;
+    }
+    
+    memset(tickets, 0, sizeof(*tickets));
+    return 0;
+}
+
+static void init_timer(void)
+{
+    if (timer_regs[TTC0_CNT_CTRL / 4] & 0x01) {
+        printf("APU: Timer is disabled, enabling...\n");
+        timer_regs[TTC0_CNT_CTRL / 4] = 0x00;
+    }
+}
+
+static inline uint32_t read_timer(void)
+{
+    return timer_regs[TTC0_CNT_VAL / 4];
+}
+
+/**
+ * Spin-wait hint, on the host backend give the emulator's threads a chance
+ */
+static inline void cpu_relax(void)
+{
+#ifdef HOST_BACKEND
+    sched_yield();
+#endif
+}
+
+static inline volatile uint32_t *mpsc_slot(uint32_t slot)
+{
+    return (volatile uint32_t *)((uint8_t *)shared_mem + MPSC_OFFSET + CACHE_LINE_SIZE +
+                                 slot * MPSC_SLOT_STRIDE);
+}
+
+/**
+ * Enqueue one entry, safe from any number of processes
+ *
+ * size is a payload length, or MPSC_SIZE_FENCE / MPSC_SIZE_DONE for the
+ * entries without payload. The payload is (ticket + i) & 0xFF so the RPU
+ * can tell a torn or misplaced slot. Returns the ticket.
+ */
+static uint32_t mpsc_enqueue(uint32_t producer, uint32_t size, uint8_t *scratch)
+{
+    uint32_t t = __atomic_fetch_add(&tickets->tail, 1, __ATOMIC_RELAXED);
+    volatile uint32_t *hdr = mpsc_slot(t % num_slots);
+    int has_payload = size <= MPSC_MAX_PAYLOAD;
+    int warned = 0;
+    uint32_t start;
+    
+    // Build the payload while the slot may still be busy
+    if (has_payload) {
+        for (uint32_t i = 0; i < size; i++) {
+            scratch[i] = (uint8_t)(t + i);
+        }
+    }
+    if (t < MAX_RESULTS) {
+        tickets->owner[t] = (uint8_t)producer;
+    }
+    
+    // Ours once the RPU has released ticket t - N from this slot
+    start = read_timer();
+    while (hdr[0] != t) {
+        if (!warned && read_timer() - start > SLOT_WARN_TICKS) {
+            fprintf(stderr, "APU: WARNING - producer %u waiting >1 s for slot %u (ticket %u)\n",
+                    producer, t % num_slots, t);
+            __atomic_fetch_add(&tickets->slow_waits, 1, __ATOMIC_RELAXED);
+            warned = 1;
+        }
+        cpu_relax();
+    }
+    
+    if (has_payload && size > 0) {
+        memcpy((void *)((uint8_t *)hdr + CACHE_LINE_SIZE), scratch, size);
+    }
+    hdr[1] = size;
+    hdr[3] = producer;
+    hdr[2] = read_timer();
+    
+    // Payload and header before the sequence word that publishes them
+    __sync_synchronize();
+    hdr[0] = t + 1;
+    
+    return t;
+}
+
+/**
+ * Wait until the RPU has consumed ticket t (and so everything before it)
+ */
+static void mpsc_wait_released(uint32_t t)
+{
+    volatile uint32_t *hdr = mpsc_slot(t % num_slots);
+    
+    while (hdr[0] != t + num_slots) {
+        cpu_relax();
+    }
+}
+
+static int wait_for_rpu_ready(int timeout_sec)
+{
+    time_t start = time(NULL);
+    
+    printf("APU: Waiting for RPU to be ready...\n");
+    
+    while (time(NULL) - start < timeout_sec) {
+        if (shared_mem[0] == MAGIC_READY) {
+            printf("APU: RPU is ready!\n");
+            return 0;
+        }
+        usleep(10000);
+    }
+    
+    printf("APU: ERROR - RPU not ready after %d seconds\n", timeout_sec);
+    return -1;
+}
+
+/**
+ * Wait for the RPU to flush the results and go back to READY
+ */
+static void wait_for_rpu_results(void)
+{
+    for (int i = 0; i < 1000 && shared_mem[0] != MAGIC_READY; i++) {
+        usleep(1000);
+    }
+    if (shared_mem[0] != MAGIC_READY) {
+        fprintf(stderr, "APU: WARNING - RPU not back to READY after DONE, reading results anyway\n");
+    }
+}
+
+/**
+ * Put the RPU into MPSC mode, it initialises every slot's sequence word
+ */
+static int start_mpsc(void)
+{
+    shared_mem[1] = num_slots;
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_MPSC;
+    
+    for (int i = 0; i < 10000; i++) {
+        if (shared_mem[0] == MAGIC_ACK) {
+            printf("APU: MPSC mode, %u slots at 0x%08lX\n", num_slots, SHARED_MEM_BASE + MPSC_OFFSET);
+            return 0;
+        }
+        usleep(10);
+    }
+    
+    fprintf(stderr, "APU: ERROR - RPU did not accept MPSC mode\n");
+    return -1;
+}
+
+/**
+ * One producer process: attach, wait for the start, send, exit
+ */
+static void producer_main(uint32_t id, uint32_t packets, uint32_t size)
+{
+    uint8_t *scratch = malloc(MPSC_MAX_PAYLOAD);
+    
+    if (!scratch) {
+        _exit(EXIT_FAILURE);
+    }
+    
+    __atomic_add_fetch(&tickets->attached, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&tickets->go, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+    
+    for (uint32_t i = 0; i < packets; i++) {
+        mpsc_enqueue(id, size, scratch);
+    }
+    
+    _exit(EXIT_SUCCESS);
+}
+
+/**
+ * Run one round with P producer processes
+ *
+ * Timed from releasing the start barrier until the fence entry (queued
+ * after every producer exited) has been consumed, so the last packets'
+ * RPU side is included.
+ */
+static int run_round(uint32_t producers, uint32_t packets, uint32_t size)
+{
+    round_t *r = &rounds[num_rounds++];
+    pid_t pids[MAX_PRODUCERS];
+    int failed = 0;
+    uint32_t t0;
+    
+    r->producers = producers;
+    r->first_ticket = __atomic_load_n(&tickets->tail, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&tickets->attached, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&tickets->go, 0, __ATOMIC_RELEASE);
+    
+    for (uint32_t p = 0; p < producers; p++) {
+        pids[p] = fork();
+        if (pids[p] < 0) {
+            perror("fork");
+            producers = p;
+            failed = 1;
+            break;
+        }
+        if (pids[p] == 0) {
+            producer_main(p, packets, size);
+        }
+    }
+    
+    // Everyone mapped and waiting, then start the clock
+    while (__atomic_load_n(&tickets->attached, __ATOMIC_ACQUIRE) < producers) {
+        cpu_relax();
+    }
+    t0 = read_timer();
+    __atomic_store_n(&tickets->go, 1, __ATOMIC_RELEASE);
+    
+    for (uint32_t p = 0; p < producers; p++) {
+        int status;
+        if (waitpid(pids[p], &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != EXIT_SUCCESS) {
+            failed = 1;
+        }
+    }
+    
+    r->last_ticket = mpsc_enqueue(COORDINATOR_ID, MPSC_SIZE_FENCE, NULL);
+    mpsc_wait_released(r->last_ticket);
+    r->elapsed_us = (uint32_t)(read_timer() - t0) / TIMER_FREQ_MHZ;
+    
+    printf("APU: %2u producers: %u packets in %.1f us (%.0f packets/s)\n",
+           producers, producers * packets, r->elapsed_us,
+           producers * packets / (r->elapsed_us / 1e6));
+    
+    return failed ? -1 : 0;
+}
+
+static void sibling_name(char *name, size_t len, const char *output_file, const char *suffix)
+{
+    const char *dot = strrchr(output_file, '.');
+    int base_len = dot ? (int)(dot - output_file) : (int)strlen(output_file);
+    
+    snprintf(name, len, "%.*s%s", base_len, output_file, suffix);
+}
+
+/**
+ * Throughput against number of producers, <output>_scaling.csv
+ */
+static void save_scaling(const char *output_file, uint32_t packets, uint32_t size)
+{
+    char name[512];
+    FILE *fp;
+    
+    sibling_name(name, sizeof(name), output_file, "_scaling.csv");
+    fp = fopen(name, "w");
+    if (!fp) {
+        perror("Cannot open scaling file");
+        return;
+    }
+    
+    printf("\n%-10s %10s %14s %14s %10s\n", "Producers", "Packets", "Elapsed (us)",
+           "Packets/s", "MB/s");
+    fprintf(fp, "producers,packets,packet_size,elapsed_us,packets_per_sec,mb_per_s\n");
+    for (uint32_t i = 0; i < num_rounds; i++) {
+        round_t *r = &rounds[i];
+        uint32_t total = r->producers * packets;
+        double pps = total / (r->elapsed_us / 1e6);
+        double mbs = (double)total * size / r->elapsed_us;
+        
+        printf("%-10u %10u %14.1f %14.0f %10.2f\n", r->producers, total, r->elapsed_us, pps, mbs);
+        fprintf(fp, "%u,%u,%u,%.1f,%.0f,%.3f\n", r->producers, total, size, r->elapsed_us, pps, mbs);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote scaling summary to %s\n", name);
+}
+
+/**
+ * Producers of the round a ticket belongs to
+ */
+static uint32_t round_producers(uint32_t ticket)
+{
+    for (uint32_t i = 0; i < num_rounds; i++) {
+        if (ticket >= rounds[i].first_ticket && ticket <= rounds[i].last_ticket) {
+            return rounds[i].producers;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Write per-packet latencies and check nothing was lost, duplicated or torn
+ *
+ * The RPU consumes in ticket order, so the stored tickets must be strictly
+ * increasing with only the fence tickets missing. Returns the number of
+ * problems found.
+ */
+static int read_results(const char *output_file, uint32_t expected)
+{
+    uint32_t count = results_mem[0];
+    uint32_t consumed = mpsc_mem[MPSC_STAT_CONSUMED];
+    uint32_t corrupt = mpsc_mem[MPSC_STAT_CORRUPT];
+    uint32_t last = 0;
+    int problems = 0;
+    FILE *fp;
+    
+    printf("APU: RPU consumed %u entries (expected %u), %u corrupt\n", consumed, expected, corrupt);
+    if (consumed != expected) {
+        fprintf(stderr, "APU: ERROR - %d entries lost or duplicated\n", (int)(consumed - expected));
+        problems++;
+    }
+    if (corrupt != 0) {
+        fprintf(stderr, "APU: ERROR - %u entries had a bad payload\n", corrupt);
+        problems++;
+    }
+    if (tickets->slow_waits != 0) {
+        fprintf(stderr, "APU: WARNING - %u slot waits took more than 1 s\n", tickets->slow_waits);
+    }
+    
+    if (count > MAX_RESULTS) {
+        fprintf(stderr, "APU: Invalid result count: %u\n", count);
+        return problems + 1;
+    }
+    
+    fp = fopen(output_file, "w");
+    if (!fp) {
+        perror("Cannot open output file");
+        return problems + 1;
+    }
+    
+    fprintf(fp, "# mode=mpsc\n");
+    fprintf(fp, "# slots=%u\n", num_slots);
+    fprintf(fp, "# timer_freq_mhz=%.1f\n", TIMER_FREQ_MHZ);
+    fprintf(fp, "ticket,producer,producers,packet_size,apu_timestamp,rpu_timestamp,"
+                "delta_ticks,delta_us\n");
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = 1 + (i * 5);
+        volatile first_byte_entry_t *fb = &((volatile first_byte_entry_t *)first_byte_mem)[i];
+        uint32_t ticket = fb->seq;
+        
+        if (results_mem[offset + 4] != 0xA5A5A5A5) {
+            fprintf(stderr, "APU: Invalid result marker at index %u\n", i);
+            problems++;
+            continue;
+        }
+        if (i > 0 && ticket <= last) {
+            fprintf(stderr, "APU: ERROR - ticket %u after %u, out of order\n", ticket, last);
+            problems++;
+        }
+        last = ticket;
+        
+        fprintf(fp, "%u,%u,%u,%u,%u,%u,%u,%.3f\n", ticket,
+                ticket < MAX_RESULTS ? tickets->owner[ticket] : 0, round_producers(ticket),
+                results_mem[offset + 0], results_mem[offset + 1], results_mem[offset + 2],
+                results_mem[offset + 3], results_mem[offset + 3] / TIMER_FREQ_MHZ);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote %u results to %s\n", count, output_file);
+    return problems;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] [output.csv]\n", prog);
+    printf("  -p N  Up to N producer processes (1-%d), rounds with 1, 2, 4 ... N\n", MAX_PRODUCERS);
+    printf("  -n N  Packets per producer per round (default 1000)\n");
+    printf("  -s N  Payload size in bytes (0-%d, default 64)\n", (int)MPSC_MAX_PAYLOAD);
+    printf("  -q N  Queue slots (2-%d, default 16)\n", MPSC_MAX_SLOTS);
+    printf("  -h    Show this help\n");
+    printf("\nWrites per-packet latency to the CSV and throughput per producer count to\n");
+    printf("<output>_scaling.csv. Exits non-zero if any entry was lost, duplicated,\n");
+    printf("reordered or corrupted.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_file = "mpsc_results.csv";
+    uint32_t max_producers = 4;
+    uint32_t packets = 1000;
+    uint32_t size = 64;
+    uint32_t expected = 0;
+    int problems = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "p:n:s:q:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            max_producers = strtoul(optarg, NULL, 0);
+            if (max_producers < 1 || max_producers > MAX_PRODUCERS) {
+                fprintf(stderr, "APU: -p needs 1 to %d producers\n", MAX_PRODUCERS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            packets = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            if (size > MPSC_MAX_PAYLOAD) {
+                fprintf(stderr, "APU: -s can be at most %d bytes\n", (int)MPSC_MAX_PAYLOAD);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'q':
+            num_slots = strtoul(optarg, NULL, 0);
+            // With one slot a producer can publish over an entry the RPU
+            // hasn't consumed yet, so the ticket scheme needs at least two
+            if (num_slots < 2 || num_slots > MPSC_MAX_SLOTS) {
+                fprintf(stderr, "APU: -q needs 2 to %d slots\n", MPSC_MAX_SLOTS);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    
+    if (optind < argc) {
+        output_file = argv[optind];
+    }
+    
+    printf("\n========================================\n");
+    printf("APU MPSC Sender\n");
+    printf("========================================\n");
+    printf("Producers: up to %u\n", max_producers);
+    printf("Packets per producer: %u\n", packets);
+    printf("Payload: %u bytes, %u slots\n", size, num_slots);
+    printf("Output file: %s\n", output_file);
+    printf("========================================\n\n");
+    
+    if (map_memory() < 0 || map_tickets() < 0) {
+        return EXIT_FAILURE;
+    }
+    init_timer();
+    
+    if (wait_for_rpu_ready(30) != 0 || start_mpsc() != 0) {
+        unmap_memory();
+        shm_unlink(TICKET_SHM_NAME);
+        return EXIT_FAILURE;
+    }
+    
+    // 1, 2, 4 ... and max_producers itself if it isn't a power of two
+    for (uint32_t p = 1; num_rounds < MAX_ROUNDS; p *= 2) {
+        if (p > max_producers) {
+            p = max_producers;
+        }
+        if (run_round(p, packets, size) != 0) {
+            fprintf(stderr, "APU: ERROR - a producer failed in the %u-producer round\n", p);
+            problems++;
+        }
+        expected += p * packets;
+        if (p == max_producers) {
+            break;
+        }
+    }
+    
+    // DONE goes through the queue too, so it lands after everything else
+    mpsc_wait_released(mpsc_enqueue(COORDINATOR_ID, MPSC_SIZE_DONE, NULL));
+    
+    // The RPU goes back to READY once its results are flushed
+    wait_for_rpu_results();
+    
+    problems += read_results(output_file, expected);
+    save_scaling(output_file, packets, size);
+    
+    unmap_memory();
+    munmap(tickets, sizeof(*tickets));
+    shm_unlink(TICKET_SHM_NAME);
+    
+    if (problems) {
+        printf("\nMPSC check FAILED (%d problems)\n", problems);
+        return EXIT_FAILURE;
+    }
+    
+    printf("\nMPSC check passed, results saved to: %s\n\n", output_file);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,536 @@
+/*
+ * APU receiver for RPU -> APU transfers (rpu_sender_ddr.c)
+ *
+ * The RPU walks the usual packet-size sweep into the reverse buffer and we
+ * time each packet until its payload is usable here. By default that means
+ * copying it out of the uncached /dev/mem mapping. With -i the window is
+ * mapped cacheable and we invalidate the payload lines first (DC CIVAC from
+ * EL0, which Linux allows), the mirror image of what the RPU does.
+ *
+ * With -x a second thread runs the normal APU -> RPU sweep on the forward
+ * channel at the same time, so both directions compete for the same DDR
+ * and interconnect.
+ *
+ * Results use the apu_sender_ddr.c CSV format. delta_us runs from the RPU
+ * timestamp (payload written, before its flush) to ours (payload read),
+ * ttfb_us and total_us from the moment the RPU started producing the data.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ddr_layout.h"
+
+/* Physical memory device, the host backend maps the emulator's file instead */
+#ifdef HOST_BACKEND
+#define MEM_DEVICE          "/dev/shm/rpu_emulator"
+#else
+#define MEM_DEVICE          "/dev/mem"
+#endif
+
+/* Shared window layout and control word values are in ddr_layout.h */
+#define CACHE_LINE_SIZE     64
+
+/* Reverse channel (must match RPU side) */
+#define REV_HEADER_SIZE     CACHE_LINE_SIZE
+#define REV_START           0x0F0F0F0FUL
+#define REV_ACK             0xF0F0F0F0UL
+#define REV_DONE            0xFFFFFFFFUL
+
+/* TTC0 Timer Registers */
+#define TTC0_BASE           0xFF110000UL
+#define TTC0_SIZE           0x1000UL
+#define TTC0_CNT_CTRL       0x0C  /* Counter Control */
+#define TTC0_CNT_VAL        0x18  /* Counter Value */
+#define TIMER_FREQ_MHZ      100.0
+
+/* Same sweep as apu_sender_ddr.c and rpu_sender_ddr.c */
+static const uint32_t packet_sizes[] = {
+    1, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+#define NUM_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
+
+typedef struct {
+    uint32_t size;
+    uint32_t rpu_ts;
+    uint32_t apu_ts;
+    uint32_t detect_ts;
+    uint32_t fill_ts;
+} rev_result_t;
+
+/* Global pointers */
+static volatile uint32_t *shared_mem = NULL;
+static volatile uint32_t *rev_mem = NULL;
+static volatile uint32_t *timer_regs = NULL;
+static volatile uint32_t *results_mem = NULL;
+static int mem_fd = -1;
+
+static int invalidate_mode = 0;   /* -i: cacheable mapping + DC CIVAC */
+static int duplex = 0;            /* -x: forward sweep at the same time */
+static int iterations_per_size = 100;
+
+static rev_result_t *rev_results = NULL;
+static uint32_t rev_count = 0;
+static uint32_t payload_errors = 0;
+static uint32_t *fwd_start_ts = NULL;   /* forward copy start, by seq */
+static int fwd_failed = 0;
+
+/**
+ * Map the shared window and TTC0
+ *
+ * Without O_SYNC the kernel maps memory it knows about as normal cacheable,
+ * which is what -i needs. For a region it doesn't manage the mapping stays
+ * uncached and the invalidates are just wasted time, check dmesg/iomem.
+ */
+static int map_memory(void)
+{
+    mem_fd = open(MEM_DEVICE, invalidate_mode ? O_RDWR : (O_RDWR | O_SYNC));
+    if (mem_fd < 0) {
+        perror("Failed to open " MEM_DEVICE);
+        return -1;
+    }
+    
+    shared_mem = (volatile uint32_t *)mmap(NULL, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED, mem_fd, SHARED_MEM_BASE);
+    if (shared_mem == MAP_FAILED) {
+        perror("Failed to map shared memory");
+        close(mem_fd);
+        return -1;
+    }
+    
+    timer_regs = (volatile uint32_t *)mmap(NULL, TTC0_SIZE, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED, mem_fd, TTC0_BASE);
+    if (timer_regs == MAP_FAILED) {
+        perror("Failed to map TTC0 registers");
+        munmap((void *)shared_mem, SHARED_MEM_SIZE);
+        close(mem_fd);
+        return -1;
+    }
+    
+    rev_mem = (volatile uint32_t *)((uint8_t *)shared_mem + REV_OFFSET);
+    results_mem = (volatile uint32_t *)((uint8_t *)shared_mem + RESULTS_OFFSET);
+    
+    printf("APU: Memory mapped successfully (%s)\n",
+           invalidate_mode ? "cacheable, invalidate before read" : "uncached");
+    return 0;
+}
+
+static void unmap_memory(void)
+{
+    if (timer_regs != MAP_FAILED && timer_regs != NULL) {
+        munmap((void *)timer_regs, TTC0_SIZE);
+    }
+    if (shared_mem != MAP_FAILED && shared_mem != NULL) {
+        munmap((void *)shared_mem, SHARED_MEM_SIZE);
+    }
+    if (mem_fd >= 0) {
+        close(mem_fd);
+    }
+}
+
+static void init_timer(void)
+{
+    if (timer_regs[TTC0_CNT_CTRL / 4] & 0x01) {
+        printf("APU: Timer is disabled, enabling...\n");
+        timer_regs[TTC0_CNT_CTRL / 4] = 0x00;
+    }
+}
+
+static inline uint32_t read_timer(void)
+{
+    return timer_regs[TTC0_CNT_VAL / 4];
+}
+
+static inline void cpu_relax(void)
+{
+#ifdef HOST_BACKEND
+    sched_yield();
+#endif
+}
+
+/**
+ * Invalidate (clean+invalidate, all EL0 can do) a range of our mapping
+ */
+static inline void invalidate_range(volatile void *addr, size_t len)
+{
+#if defined(__aarch64__) && !defined(HOST_BACKEND)
+    uintptr_t p = (uintptr_t)addr & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    
+    for (; p < (uintptr_t)addr + len; p += CACHE_LINE_SIZE) {
+        __asm__ volatile("dc civac, %0" :: "r"(p) : "memory");
+    }
+    __asm__ volatile("dsb sy" ::: "memory");
+#else
+    (void)addr;
+    (void)len;
+#endif
+}
+
+/**
+ * Push a range of our mapping out to DDR
+ */
+static inline void clean_range(volatile void *addr, size_t len)
+{
+#if defined(__aarch64__) && !defined(HOST_BACKEND)
+    uintptr_t p = (uintptr_t)addr & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+    
+    for (; p < (uintptr_t)addr + len; p += CACHE_LINE_SIZE) {
+        __asm__ volatile("dc cvac, %0" :: "r"(p) : "memory");
+    }
+    __asm__ volatile("dsb sy" ::: "memory");
+#else
+    (void)addr;
+    (void)len;
+    __sync_synchronize();
+#endif
+}
+
+static int wait_for_rpu_ready(int timeout_sec)
+{
+    time_t start = time(NULL);
+    
+    printf("APU: Waiting for RPU sender to be ready...\n");
+    
+    while (time(NULL) - start < timeout_sec) {
+        invalidate_range(shared_mem, CACHE_LINE_SIZE);
+        if (shared_mem[0] == MAGIC_READY) {
+            printf("APU: RPU is ready!\n");
+            return 0;
+        }
+        usleep(10000);
+    }
+    
+    printf("APU: ERROR - RPU not ready after %d seconds\n", timeout_sec);
+    return -1;
+}
+
+/**
+ * Forward (APU -> RPU) sweep for duplex mode, plain protocol
+ */
+static void *forward_thread(void *arg)
+{
+    uint8_t *payload = malloc(packet_sizes[NUM_SIZES - 1]);
+    uint32_t seq = 0;
+    
+    (void)arg;
+    if (!payload) {
+        fwd_failed = -1;
+        return NULL;
+    }
+    for (uint32_t i = 0; i < packet_sizes[NUM_SIZES - 1]; i++) {
+        payload[i] = (uint8_t)(i & 0xFF);
+    }
+    
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        for (int iter = 0; iter < iterations_per_size; iter++) {
+            uint32_t size = packet_sizes[s];
+            int elapsed = 0;
+            
+            fwd_start_ts[seq++] = read_timer();
+            memcpy((void *)&shared_mem[4], payload, size);
+            clean_range(&shared_mem[4], size);
+            shared_mem[1] = size;
+            shared_mem[2] = read_timer();
+            clean_range(shared_mem, CACHE_LINE_SIZE);
+            shared_mem[0] = MAGIC_START;
+            clean_range(shared_mem, CACHE_LINE_SIZE);
+            
+            while (elapsed++ < 10000) {
+                invalidate_range(shared_mem, CACHE_LINE_SIZE);
+                if (shared_mem[0] == MAGIC_ACK) {
+                    break;
+                }
+                usleep(1);
+            }
+            if (shared_mem[0] != MAGIC_ACK) {
+                fprintf(stderr, "APU: WARNING - No ACK for forward packet size %u\n", size);
+                fwd_failed++;
+            }
+            
+            usleep(100);
+        }
+    }
+    
+    shared_mem[0] = MAGIC_DONE;
+    clean_range(shared_mem, CACHE_LINE_SIZE);
+    free(payload);
+    return NULL;
+}
+
+/**
+ * Receive the whole reverse sweep
+ *
+ * The timestamp is taken once the payload has been copied into our own
+ * buffer, i.e. it's actually usable. The pattern check comes after it, a
+ * mismatch means we read stale data (a missing flush or invalidate).
+ */
+static int receive_reverse(void)
+{
+    volatile uint8_t *payload = (volatile uint8_t *)rev_mem + REV_HEADER_SIZE;
+    uint8_t *buf = malloc(packet_sizes[NUM_SIZES - 1]);
+    uint32_t max = NUM_SIZES * iterations_per_size;
+    
+    if (!buf) {
+        perror("Failed to allocate receive buffer");
+        return -1;
+    }
+    
+    while (1) {
+        uint32_t magic, detect_ts, apu_ts, size, seq;
+        rev_result_t *r;
+        
+        invalidate_range(rev_mem, REV_HEADER_SIZE);
+        magic = rev_mem[0];
+        if (magic == REV_DONE) {
+            break;
+        }
+        if (magic != REV_START) {
+            cpu_relax();
+            continue;
+        }
+        
+        detect_ts = read_timer();
+        size = rev_mem[1];
+        seq = rev_mem[3];
+        if (size > packet_sizes[NUM_SIZES - 1]) {
+            size = packet_sizes[NUM_SIZES - 1];
+            payload_errors++;
+        }
+        
+        invalidate_range(payload, size);
+        memcpy(buf, (const void *)payload, size);
+        apu_ts = read_timer();
+        
+        if (rev_count < max) {
+            r = &rev_results[rev_count++];
+            r->size = size;
+            r->rpu_ts = rev_mem[2];
+            r->apu_ts = apu_ts;
+            r->detect_ts = detect_ts;
+            r->fill_ts = rev_mem[4];
+        }
+        
+        for (uint32_t i = 0; i < size; i++) {
+            if (buf[i] != (uint8_t)(seq + i)) {
+                payload_errors++;
+                break;
+            }
+        }
+        
+        // Buffer back to the RPU
+        rev_mem[0] = REV_ACK;
+        clean_range(rev_mem, REV_HEADER_SIZE);
+        
+        if (rev_count % 100 == 0) {
+            printf("APU: Received %u packets\n", rev_count);
+        }
+    }
+    
+    free(buf);
+    return 0;
+}
+
+static void write_header(FILE *fp, const char *direction)
+{
+    fprintf(fp, "# direction=%s\n", direction);
+    fprintf(fp, "# apu_receive=%s\n", invalidate_mode ? "invalidate" : "uncached");
+    fprintf(fp, "# duplex=%d\n", duplex);
+    fprintf(fp, "# iterations=%d\n", iterations_per_size);
+    fprintf(fp, "# timer_freq_mhz=%.1f\n", TIMER_FREQ_MHZ);
+    fprintf(fp, "packet_size,apu_timestamp,rpu_timestamp,delta_ticks,delta_us,ttfb_us,total_us\n");
+}
+
+static int save_reverse(const char *output_file)
+{
+    FILE *fp = fopen(output_file, "w");
+    
+    if (!fp) {
+        perror("Cannot open output file");
+        return -1;
+    }
+    
+    write_header(fp, "rpu_to_apu");
+    if (payload_errors) {
+        fprintf(fp, "# payload_errors=%u\n", payload_errors);
+    }
+    for (uint32_t i = 0; i < rev_count; i++) {
+        rev_result_t *r = &rev_results[i];
+        uint32_t delta = r->apu_ts - r->rpu_ts;
+        
+        fprintf(fp, "%u,%u,%u,%u,%.3f,%.3f,%.3f\n", r->size, r->apu_ts, r->rpu_ts, delta,
+                delta / TIMER_FREQ_MHZ, (uint32_t)(r->detect_ts - r->fill_ts) / TIMER_FREQ_MHZ,
+                (uint32_t)(r->apu_ts - r->fill_ts) / TIMER_FREQ_MHZ);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote %u RPU -> APU results to %s\n", rev_count, output_file);
+    return 0;
+}
+
+/**
+ * Forward half of a duplex run, from the RPU results area
+ *
+ * The RPU only invalidates, so the first byte is usable when the whole
+ * packet is: ttfb_us == total_us.
+ */
+static int save_forward(const char *output_file)
+{
+    char name[512];
+    const char *dot = strrchr(output_file, '.');
+    int base_len = dot ? (int)(dot - output_file) : (int)strlen(output_file);
+    uint32_t count;
+    FILE *fp;
+    
+    invalidate_range(results_mem, 4 + MAX_RESULTS * 20);
+    count = results_mem[0];
+    if (count > MAX_RESULTS) {
+        fprintf(stderr, "APU: Invalid forward result count: %u\n", count);
+        return -1;
+    }
+    
+    snprintf(name, sizeof(name), "%.*s_apu_to_rpu.csv", base_len, output_file);
+    fp = fopen(name, "w");
+    if (!fp) {
+        perror("Cannot open forward output file");
+        return -1;
+    }
+    
+    write_header(fp, "apu_to_rpu");
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = 1 + (i * 5);
+        uint32_t rpu_ts = results_mem[offset + 2];
+        double total_us = (uint32_t)(rpu_ts - fwd_start_ts[i]) / TIMER_FREQ_MHZ;
+        
+        if (results_mem[offset + 4] != 0xA5A5A5A5) {
+            continue;
+        }
+        fprintf(fp, "%u,%u,%u,%u,%.3f,%.3f,%.3f\n", results_mem[offset + 0],
+                results_mem[offset + 1], rpu_ts, results_mem[offset + 3],
+                results_mem[offset + 3] / TIMER_FREQ_MHZ, total_us, total_us);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote %u APU -> RPU results to %s\n", count, name);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] [iterations] [output.csv]\n", prog);
+    printf("  -i    Map the window cacheable and invalidate before reading\n");
+    printf("        (default: read through the uncached O_SYNC mapping)\n");
+    printf("  -x    Full duplex: run the APU -> RPU sweep at the same time\n");
+    printf("        (writes <output>_apu_to_rpu.csv as well)\n");
+    printf("  -h    Show this help\n");
+    printf("\nNeeds rpu_sender_ddr running on the RPU.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_file = "reverse_results.csv";
+    pthread_t fwd;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "ixh")) != -1) {
+        switch (opt) {
+        case 'i':
+            invalidate_mode = 1;
+            break;
+        case 'x':
+            duplex = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    
+    if (optind < argc) {
+        iterations_per_size = atoi(argv[optind++]);
+    }
+    if (optind < argc) {
+        output_file = argv[optind++];
+    }
+    if (iterations_per_size <= 0) {
+        fprintf(stderr, "APU: iterations must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (duplex && NUM_SIZES * iterations_per_size > MAX_RESULTS) {
+        fprintf(stderr, "APU: WARNING - the RPU keeps only %d forward results\n", MAX_RESULTS);
+    }
+    
+    printf("\n========================================\n");
+    printf("APU Receiver (RPU -> APU)%s\n", duplex ? ", full duplex" : "");
+    printf("========================================\n");
+    printf("Iterations per size: %d\n", iterations_per_size);
+    printf("Output file: %s\n", output_file);
+    printf("========================================\n\n");
+    
+    rev_results = calloc(NUM_SIZES * iterations_per_size, sizeof(*rev_results));
+    fwd_start_ts = calloc(NUM_SIZES * iterations_per_size, sizeof(*fwd_start_ts));
+    if (!rev_results || !fwd_start_ts) {
+        perror("Failed to allocate result buffers");
+        return EXIT_FAILURE;
+    }
+    
+    if (map_memory() < 0) {
+        return EXIT_FAILURE;
+    }
+    init_timer();
+    
+    if (wait_for_rpu_ready(30) != 0) {
+        unmap_memory();
+        return EXIT_FAILURE;
+    }
+    
+    shared_mem[1] = iterations_per_size;
+    shared_mem[2] = duplex;
+    clean_range(shared_mem, CACHE_LINE_SIZE);
+    shared_mem[0] = MAGIC_REVERSE;
+    clean_range(shared_mem, CACHE_LINE_SIZE);
+    for (int i = 0; i < 10000 && shared_mem[0] != MAGIC_ACK; i++) {
+        usleep(10);
+        invalidate_range(shared_mem, CACHE_LINE_SIZE);
+    }
+    if (shared_mem[0] != MAGIC_ACK) {
+        fprintf(stderr, "APU: ERROR - RPU sender did not start\n");
+        unmap_memory();
+        return EXIT_FAILURE;
+    }
+    
+    if (duplex && pthread_create(&fwd, NULL, forward_thread, NULL) != 0) {
+        perror("Failed to start the forward thread");
+        unmap_memory();
+        return EXIT_FAILURE;
+    }
+    
+    receive_reverse();
+    
+    if (duplex) {
+        pthread_join(fwd, NULL);
+        
+        // Give the RPU time to write out and flush its results
+        usleep(100000);
+        save_forward(output_file);
+    }
+    save_reverse(output_file);
+    
+    printf("\n========================================\n");
+    printf("Experiment Complete\n");
+    printf("========================================\n");
+    printf("RPU -> APU packets: %u\n", rev_count);
+    printf("Stale/corrupt payloads: %u\n", payload_errors);
+    if (duplex) {
+        printf("APU -> RPU failed packets: %d\n", fwd_failed);
+    }
+    printf("========================================\n");
+    
+    unmap_memory();
+    return payload_errors == 0 && fwd_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
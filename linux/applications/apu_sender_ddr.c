@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -7,16 +8,36 @@
 #include <sys/mman.h>
 #include <time.h>
 #include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <pthread.h>
+#include "ddr_layout.h"
 
-/* Shared Memory Setup */
-#define SHARED_MEM_BASE     0x3E000000UL
-#define SHARED_MEM_SIZE     0x00800000UL  /* 8 MB */
+/* Physical memory device, the host backend maps the emulator's file instead */
+#ifdef HOST_BACKEND
+#define MEM_DEVICE          "/dev/shm/rpu_emulator"
+#else
+#define MEM_DEVICE          "/dev/mem"
+#endif
 
-/* Protocol Magic Values */
-#define MAGIC_START         0x0F0F0F0FUL
-#define MAGIC_ACK           0xF0F0F0F0UL
-#define MAGIC_DONE          0xFFFFFFFFUL
-#define MAGIC_READY         0xAAAAAAAAUL
+/*
+ * Shared window with 2 MB blocks (-H): shmem_hugemap.ko on the board,
+ * shmem THP on the emulator's file on the host
+ */
+#ifdef HOST_BACKEND
+#define HUGEMAP_DEVICE      MEM_DEVICE
+#define HUGEMAP_OFFSET      SHARED_MEM_BASE
+#else
+#define HUGEMAP_DEVICE      "/dev/rpu_shmem"
+#define HUGEMAP_OFFSET      0
+#define HUGEMAP_PROC        "/proc/rpu_shmem"
+#endif
+#define HUGE_PAGE_SIZE      0x00200000UL
+
+/* Shared window layout and control word values are in ddr_layout.h */
+#define CACHE_LINE_SIZE     64  /* Dirty tracking granularity */
 
 /* TTC0 Timer 0 Registers */
 #define TTC0_BASE           0xFF110000UL
@@ -29,8 +50,110 @@
 #define TIMER_FREQ_HZ       100000000UL  /* ~100 MHz */
 #define TIMER_FREQ_MHZ      100.0
 
-/* Results storage offset */
-#define RESULTS_OFFSET      0x00400000UL  /* 4 MB offset */
+/* Per-packet flags word (shared_mem[3]) */
+#define FLAG_TRACE          0x00000001UL  /* Ask the RPU to trace this packet */
+#define FLAG_PMU            0x00000002UL  /* Ask the RPU to sample its PMU */
+#define FLAG_EXTENTS        0x00000004UL  /* Only the extents in the dirty table changed */
+#define FLAG_STREAM         0x00000008UL  /* Payload follows MAGIC_START in chunks */
+#define FLAG_CHUNK_SHIFT    4             /* Bits 4-7: log2(chunk size / 64) */
+
+/* Dirty-extent table: count, then {offset, length} pairs relative to the payload */
+#define EXTENT_OVERFLOW     0xFFFFFFFFUL
+#define FLAG_SEQ_SHIFT      8             /* Upper 24 bits carry our sequence number */
+
+/* Streaming mode (-s CHUNK): one marker word per chunk, CHUNK_MARKER(seq) = chunk written */
+#define MIN_CHUNK_SIZE      64
+#define MAX_CHUNK_SIZE      32768
+#define CHUNK_MARKER(seq)   (((seq) & 0x00FFFFFFUL) + 1)
+
+/* RPU timer-read calibration block (must match RPU side) */
+#define CALIB_MAGIC         0xCA11B8A7UL
+#define CALIB_SAMPLES       1000
+#define INVAL_CALIB_SIZES   7             /* RPU range-invalidate timings, 1 KB .. 64 KB */
+#define INVAL_CALIB_MIN     1024
+
+/*
+ * Run descriptor (must match RPU side). The RPU firmware stays resident:
+ * each run starts with MAGIC_CONFIG, ends with MAGIC_DONE, and the RPU
+ * goes back to MAGIC_READY once the results are flushed.
+ */
+#define INVAL_STRAT_AUTO    0   /* RPU picks from its startup calibration */
+#define INVAL_STRAT_RANGE   1   /* Always a range invalidate */
+#define INVAL_STRAT_FULL    2   /* Always the whole-cache operation */
+
+/*
+ * Empty-loop calibration: zero-size packets sent before the sweep. They take
+ * the first CALIB_PACKETS sequence numbers and are left out of the CSV rows.
+ */
+#define CALIB_PACKETS       200
+
+/*
+ * OS event capture (-k): /proc/interrupts before and after the sweep, and
+ * scheduler/IRQ events for the sender's CPU from tracefs. The trace clock
+ * is "mono", the same clock as the start_mono_ns/end_mono_ns columns, so
+ * analysis/attribute_outliers.py can line the two up.
+ */
+#define TRACEFS_DIR         "/sys/kernel/tracing"
+#define TRACEFS_DIR_OLD     "/sys/kernel/debug/tracing"
+#define OS_TRACE_BUFFER_KB  "16384"
+#define IRQ_SNAPSHOT_MAX    (256 * 1024)
+
+/*
+ * RPU idle wait (-w). With WAIT_IPI the RPU sleeps in WFI between packets
+ * and we ring IPI channel 1 (RPU0) from our channel 0 after every control
+ * word write. The RPU logs polls and wakeups per packet (must match RPU side).
+ */
+#define WAIT_SPIN           0
+#define WAIT_IPI            1
+#define IPI_BASE            0xFF300000UL  /* Channel 0, the APU's */
+#define IPI_SIZE            0x1000UL
+#define IPI_TRIG            0x00
+#define IPI_RPU0_MASK       0x00000100UL
+
+/*
+ * Priority lane (-q HZ): one cache line next to the bulk mailbox, magic
+ * (MAGIC_START = full, MAGIC_ACK = free), size, timestamp, seq, then up
+ * to HP_PAYLOAD_MAX bytes. The RPU checks it before every bulk poll and
+ * between slices of a bulk invalidate, and logs {seq, apu_ts, rpu_ts,
+ * bulk_size} records after a count word (must match RPU side).
+ */
+#define HP_PAYLOAD_MAX      (CACHE_LINE_SIZE - 16)
+#define HP_MSG_SIZE         16            /* A setpoint or two */
+#define HP_TIMEOUT_TICKS    1000000       /* 10 ms */
+
+/*
+ * N-buffer mode (-b N): each slot is a header line (magic, size, timestamp,
+ * flags) plus payload. The slot magic is the ownership flag, MAGIC_START =
+ * full (RPU owns it), MAGIC_ACK = free (we own it).
+ */
+#define SLOT_HEADER_SIZE    CACHE_LINE_SIZE
+#define SLOT_TIMEOUT_TICKS  1000000       /* 10 ms */
+
+/* RPU memory attributes for the packet memory (must match RPU side) */
+#define ATTR_WB             0   /* Normal, write-back write-allocate */
+#define ATTR_WT             1   /* Normal, write-through */
+#define ATTR_NC             2   /* Normal, non-cacheable */
+#define ATTR_DEVICE         3   /* Device */
+#define ATTR_SO             4   /* Strongly ordered */
+#define NUM_ATTRS           5
+
+/* Our own trace buffer (-t), the RPU ring is TRACE_CAPACITY */
+#define APU_TRACE_CAPACITY  65536
+
+/* Trace event IDs (must match RPU side and analysis/trace_to_perfetto.py) */
+#define TRACE_APU_COPY          1   /* Payload memcpy */
+#define TRACE_APU_META          2   /* Metadata + timestamp write */
+#define TRACE_APU_DOORBELL      3   /* Barrier + MAGIC_START write */
+#define TRACE_APU_ACK_WAIT      4   /* Polling for MAGIC_ACK */
+#define TRACE_APU_SLOT_WAIT     5   /* Waiting for an N-buffer slot to be free */
+
+/* Per-sample PMU counters */
+#define RPU_PMU_EVENTS      3   /* D-cache miss, ext mem request, LSU stall */
+#define APU_PMU_EVENTS      5   /* L1D refill, L2D refill, bus access, stall cycles, dTLB refill */
+
+#define PHASE_BEGIN         0
+#define PHASE_END           1
+#define PHASE_INSTANT       2
 
 /* Packet sizes to test (in bytes) */
 static const uint32_t packet_sizes[] = {
@@ -55,7 +178,17 @@ static const uint32_t packet_sizes[] = {
 static volatile uint32_t *shared_mem = NULL;
 static volatile uint32_t *timer_regs = NULL;
 static volatile uint32_t *results_mem = NULL;
+static volatile uint32_t *trace_mem = NULL;
+static volatile uint32_t *pmu_mem = NULL;
+static volatile uint32_t *extent_mem = NULL;
+static volatile uint32_t *marker_mem = NULL;
+static volatile uint32_t *first_byte_mem = NULL;
+static volatile uint32_t *calib_mem = NULL;
+static volatile uint32_t *wait_mem = NULL;
+static volatile uint32_t *ipi_regs = NULL;  /* -w ipi only */
 static int mem_fd = -1;
+static int shm_fd = -1;     /* -H only, the window comes from HUGEMAP_DEVICE */
+static int hugepages = 0;
 
 /* Result structure (must match RPU side) */
 typedef struct {
@@ -66,31 +199,313 @@ typedef struct {
     uint32_t valid;
 } __attribute__((packed)) result_entry_t;
 
+/* Trace event (must match RPU side) */
+typedef struct {
+    uint32_t timestamp;
+    uint32_t seq;
+    uint32_t event;   /* event ID << 16 | phase */
+    uint32_t arg;     /* packet size */
+} __attribute__((packed)) trace_entry_t;
+
+/* Tracing (-t), preallocated so recording is just a few stores */
+static int trace_enabled = 0;
+static trace_entry_t *apu_trace = NULL;
+static uint32_t apu_trace_count = 0;
+static uint32_t packet_seq = 0;
+
+/* RPU PMU deltas for one sample (must match RPU side) */
+typedef struct {
+    uint32_t seq;
+    uint32_t valid;
+    uint32_t inv[1 + RPU_PMU_EVENTS];
+    uint32_t read[1 + RPU_PMU_EVENTS];
+} __attribute__((packed)) pmu_entry_t;
+
+/* APU counters (-p), one group read around each send_packet() */
+static int pmu_enabled = 0;
+static int pmu_fds[APU_PMU_EVENTS] = { -1, -1, -1, -1, -1 };
+static int pmu_slot[APU_PMU_EVENTS];       /* position in the group read, -1 = unavailable */
+static int pmu_group_size = 0;
+static int64_t (*apu_counters)[APU_PMU_EVENTS] = NULL;  /* indexed by packet seq */
+
+/*
+ * Partial updates (-d N): after the first packet of each size, only N
+ * cache lines of the payload are rewritten, like a big parameter table
+ * where a few entries change. With -e we also publish which lines changed.
+ */
+static uint32_t dirty_lines = 0;
+static int extents_enabled = 0;
+static uint32_t last_size = 0;
+static uint32_t update_count = 0;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} extent_t;
+
+/* When the RPU could first use the payload (must match RPU side) */
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp;
+} __attribute__((packed)) first_byte_entry_t;
+
+/* RPU control-line polls and WFI wakeups before each packet */
+typedef struct {
+    uint32_t seq;
+    uint32_t polls;
+    uint32_t wakeups;
+} __attribute__((packed)) wait_entry_t;
+
+/* One priority-lane message as the RPU saw it, bulk_size 0 = bulk lane idle */
+typedef struct {
+    uint32_t seq;
+    uint32_t apu_timestamp;
+    uint32_t rpu_timestamp;
+    uint32_t bulk_size;
+} __attribute__((packed)) hp_entry_t;
+
+/* -q, 0 = no priority lane */
+static uint32_t hp_rate_hz = 0;
+static volatile uint32_t *hp_lane = NULL;
+static volatile uint32_t *hp_results_mem = NULL;
+static volatile int hp_stop = 0;
+static uint32_t hp_sent = 0;
+static uint32_t hp_late = 0;   /* periods skipped because the last message was still queued */
+
+/* -w, -1 = leave the RPU spinning and skip the wait columns */
+static int wait_mode = -1;
+static const char *wait_names[] = { "spin", "ipi" };
+
+/*
+ * Timer value when we started copying each packet, indexed by seq. Lets us
+ * report time-to-first-byte and total latency the same way for every mode.
+ */
+static uint32_t *start_ts = NULL;
+
+/* -k only: CLOCK_MONOTONIC next to each start_ts, to convert TTC ticks */
+static int os_events = 0;
+static uint64_t *start_mono = NULL;
+static int sender_cpu = -1;
+static const char *tracefs = NULL;   /* NULL = no tracefs, /proc/interrupts only */
+static char *irq_before = NULL;
+
+/* tracefs settings from before -k changed them, empty = couldn't read */
+static char saved_trace_clock[32];
+static char saved_cpumask[128];
+static char saved_buffer_kb[32];
+
+/* Events traced for the sender CPU, whichever of them this kernel has */
+static const char *os_trace_events[] = {
+    "sched/sched_switch",
+    "sched/sched_wakeup",
+    "irq/irq_handler_entry",
+    "irq/irq_handler_exit",
+    "irq/softirq_entry",
+    "irq/softirq_exit",
+    "ipi/ipi_entry",
+    "ipi/ipi_exit",
+};
+#define NUM_OS_TRACE_EVENTS (sizeof(os_trace_events) / sizeof(os_trace_events[0]))
+
+/* What we're about to send, for the RPU to reset and configure itself */
+typedef struct {
+    uint32_t run_id;
+    uint32_t inval_strategy;
+    uint32_t iterations;
+    uint32_t num_sizes;
+    uint32_t sizes[CONFIG_MAX_SIZES];
+} __attribute__((packed)) run_desc_t;
+
+/* -I */
+static uint32_t inval_strategy = INVAL_STRAT_AUTO;
+static const char *inval_names[] = { "auto", "range", "full" };
+
+/*
+ * Where the wall time went: waiting for READY (RPU boot or the previous
+ * run), setup (descriptor, mode switches, calibration packets), the sweep
+ */
+static double ready_wait_s = 0.0;
+static double setup_s = 0.0;
+static double sweep_s = 0.0;
+
+/* Back-to-back timer read cost, in ticks (mean and std in 1/1000 tick) */
+typedef struct {
+    uint32_t magic;
+    uint32_t samples;
+    uint32_t min_ticks;
+    uint32_t max_ticks;
+    uint32_t mean_milliticks;
+    uint32_t std_milliticks;
+    uint32_t inval_full_ticks;                      /* RPU whole-cache clean+invalidate */
+    uint32_t inval_crossover;                       /* First payload size using it, 0 = never */
+    uint32_t inval_range_ticks[INVAL_CALIB_SIZES];  /* RPU range invalidate per size */
+} __attribute__((packed)) calib_block_t;
+
+/* The window areas in ddr_layout.h are sized for these records */
+CHAN_ASSERT_SIZE(result_entry_t, RESULT_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(trace_entry_t, TRACE_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(pmu_entry_t, PMU_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(first_byte_entry_t, FIRST_BYTE_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(wait_entry_t, WAIT_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(hp_entry_t, HP_ENTRY_SIZE);
+CHAN_ASSERT_SIZE(run_desc_t, RUN_DESC_SIZE);
+CHAN_ASSERT_SIZE(calib_block_t, CALIB_BLOCK_SIZE);
+
+static calib_block_t apu_calib;
+
+/* Streaming mode (-s CHUNK), 0 = copy the whole payload before MAGIC_START */
+static uint32_t chunk_size = 0;
+static uint32_t chunk_shift = 0;
+
+/*
+ * Memory attribute matrix (-m LIST): the whole sweep is repeated once per
+ * attribute, with the RPU reading the payload inside the timed interval.
+ */
+static const char *attr_names[NUM_ATTRS] = { "wb", "wt", "nc", "device", "so" };
+static uint32_t attr_list[NUM_ATTRS];
+static uint32_t num_attrs = 0;
+static uint32_t num_sweeps = 1;
+static uint8_t *packet_attr = NULL;  /* attribute each packet was sent with, by seq */
+
+/*
+ * Background load (-i FILE): mem_interference's status file, read before
+ * and after the sweep. It is updated once a second, so runs much shorter
+ * than that can't be tagged.
+ */
+typedef struct {
+    int valid;
+    int running;
+    char kernel[16];
+    char cores[64];
+    double target_mbps;
+    uint64_t elapsed_ns;
+    uint64_t bytes;
+} load_status_t;
+
+static const char *load_status_file = NULL;
+static load_status_t load_before;
+
+/* N-buffer mode (-b N), 0 = classic single-buffer ping-pong */
+static uint32_t num_slots = 0;
+static uint64_t copy_ticks = 0;  /* payload memcpy time, reset for every size */
+
+/**
+ * Map the shared window at a 2 MB aligned address
+ *
+ * A block mapping needs virtual and physical address to agree modulo
+ * 2 MB, so reserve 2 MB more than needed and map over the aligned part.
+ */
+static void *map_window_aligned(int fd, off_t offset)
+{
+    uint8_t *resv, *aligned;
+    
+    resv = mmap(NULL, SHARED_MEM_SIZE + HUGE_PAGE_SIZE, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (resv == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+    
+    aligned = (uint8_t *)(((uintptr_t)resv + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (aligned > resv) {
+        munmap(resv, aligned - resv);
+    }
+    munmap(aligned + SHARED_MEM_SIZE, resv + HUGE_PAGE_SIZE - aligned);
+    
+    return mmap(aligned, SHARED_MEM_SIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED, fd, offset);
+}
+
+/**
+ * How much of the window ended up in 2 MB blocks, in KB (-1 = unknown)
+ *
+ * The board driver counts its PMD faults. On the host the emulator's
+ * file is shmem, so smaps shows the PMD-mapped part of our VMA.
+ */
+static long huge_mapped_kb(void)
+{
+    char line[256];
+    long kb = -1;
+    FILE *f;
+    
+#ifdef HOST_BACKEND
+    char start[32];
+    int in_vma = 0;
+    
+    snprintf(start, sizeof(start), "%lx-", (unsigned long)shared_mem);
+    f = fopen("/proc/self/smaps", "r");
+    if (!f) return -1;
+    
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, start, strlen(start)) == 0) {
+            in_vma = 1;
+        } else if (in_vma && (sscanf(line, "ShmemPmdMapped: %ld kB", &kb) == 1 ||
+                              sscanf(line, "FilePmdMapped: %ld kB", &kb) == 1)) {
+            break;
+        }
+    }
+#else
+    long faults;
+    
+    f = fopen(HUGEMAP_PROC, "r");
+    if (!f) return -1;
+    
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "pmd_faults: %ld", &faults) == 1) {
+            kb = faults * (HUGE_PAGE_SIZE / 1024);
+        }
+    }
+#endif
+    fclose(f);
+    return kb;
+}
+
 /**
  * Map physical memory using /dev/mem
  */
 static int map_memory(void)
 {
     // Open /dev/mem to get direct physical memory access
-    mem_fd = open("/dev/mem", O_RDWR | O_SYNC);
+    mem_fd = open(MEM_DEVICE, O_RDWR | O_SYNC);
     if (mem_fd < 0) {
-        perror("Failed to open /dev/mem");
+        perror("Failed to open " MEM_DEVICE);
         return -1;
     }
     
-    // Map the shared memory region
-    shared_mem = (volatile uint32_t *)mmap(
-        NULL, SHARED_MEM_SIZE,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        mem_fd, SHARED_MEM_BASE
-    );
+    // Map the shared memory region, with -H through the block-mapping driver
+    if (hugepages) {
+        shm_fd = open(HUGEMAP_DEVICE, O_RDWR | O_SYNC);
+        if (shm_fd < 0) {
+            perror("Failed to open " HUGEMAP_DEVICE " (is shmem_hugemap.ko loaded?)");
+            close(mem_fd);
+            return -1;
+        }
+        shared_mem = (volatile uint32_t *)map_window_aligned(shm_fd, HUGEMAP_OFFSET);
+#ifdef HOST_BACKEND
+        if (shared_mem != MAP_FAILED &&
+            madvise((void *)shared_mem, SHARED_MEM_SIZE, MADV_HUGEPAGE) != 0) {
+            perror("APU: WARNING - madvise(MADV_HUGEPAGE)");
+        }
+#endif
+    } else {
+        shared_mem = (volatile uint32_t *)mmap(
+            NULL, SHARED_MEM_SIZE,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            mem_fd, SHARED_MEM_BASE
+        );
+    }
     if (shared_mem == MAP_FAILED) {
         perror("Failed to map shared memory");
+        if (shm_fd >= 0) close(shm_fd);
         close(mem_fd);
         return -1;
     }
     
+    // Fault the whole window in now, so page faults don't land in the first packets
+    for (uint32_t off = 0; off < SHARED_MEM_SIZE; off += 4096) {
+        (void)shared_mem[off / 4];
+    }
+    
     // Map TTC0 timer registers
     timer_regs = (volatile uint32_t *)mmap(
         NULL, TTC0_SIZE,
@@ -107,6 +522,29 @@ static int map_memory(void)
     
     // Results area is just offset into shared memory
     results_mem = (volatile uint32_t *)((uint8_t *)shared_mem + RESULTS_OFFSET);
+    trace_mem = (volatile uint32_t *)((uint8_t *)shared_mem + TRACE_OFFSET);
+    pmu_mem = (volatile uint32_t *)((uint8_t *)shared_mem + PMU_OFFSET);
+    extent_mem = (volatile uint32_t *)((uint8_t *)shared_mem + EXTENT_OFFSET);
+    marker_mem = (volatile uint32_t *)((uint8_t *)shared_mem + MARKER_OFFSET);
+    first_byte_mem = (volatile uint32_t *)((uint8_t *)shared_mem + FIRST_BYTE_OFFSET);
+    calib_mem = (volatile uint32_t *)((uint8_t *)shared_mem + CALIB_OFFSET);
+    wait_mem = (volatile uint32_t *)((uint8_t *)shared_mem + WAIT_OFFSET);
+    hp_lane = (volatile uint32_t *)((uint8_t *)shared_mem + HP_LANE_OFFSET);
+    hp_results_mem = (volatile uint32_t *)((uint8_t *)shared_mem + HP_RESULTS_OFFSET);
+    
+    // IPI trigger register, only needed to wake the RPU out of WFI
+    if (wait_mode == WAIT_IPI) {
+        ipi_regs = (volatile uint32_t *)mmap(NULL, IPI_SIZE, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED, mem_fd, IPI_BASE);
+        if (ipi_regs == MAP_FAILED) {
+            perror("Failed to map IPI registers");
+            ipi_regs = NULL;
+            munmap((void *)timer_regs, TTC0_SIZE);
+            munmap((void *)shared_mem, SHARED_MEM_SIZE);
+            close(mem_fd);
+            return -1;
+        }
+    }
     
     printf("APU: Memory mapped successfully\n");
     printf("APU: Shared memory at %p (phys 0x%08lX)\n", 
@@ -114,6 +552,9 @@ static int map_memory(void)
     printf("APU: TTC0 registers at %p (phys 0x%08lX)\n", 
            (void *)timer_regs, TTC0_BASE);
     printf("APU: Results area at %p\n", (void *)results_mem);
+    if (hugepages) {
+        printf("APU: %ld KB of the window in 2 MB blocks\n", huge_mapped_kb());
+    }
     
     return 0;
 }
@@ -123,12 +564,18 @@ static int map_memory(void)
  */
 static void unmap_memory(void)
 {
+    if (ipi_regs) {
+        munmap((void *)ipi_regs, IPI_SIZE);
+    }
     if (timer_regs != MAP_FAILED && timer_regs != NULL) {
         munmap((void *)timer_regs, TTC0_SIZE);
     }
     if (shared_mem != MAP_FAILED && shared_mem != NULL) {
         munmap((void *)shared_mem, SHARED_MEM_SIZE);
     }
+    if (shm_fd >= 0) {
+        close(shm_fd);
+    }
     if (mem_fd >= 0) {
         close(mem_fd);
     }
@@ -172,6 +619,236 @@ static inline uint32_t read_timer(void)
     return timer_regs[TTC0_CNT_VAL / 4];
 }
 
+/**
+ * Integer square root, keeps us off libm
+ */
+static uint64_t isqrt64(uint64_t v)
+{
+    uint64_t x = v, y = (v + 1) / 2;
+    
+    if (v < 2) return v;
+    while (y < x) {
+        x = y;
+        y = (x + v / x) / 2;
+    }
+    return x;
+}
+
+/**
+ * Measure what one timer read costs us
+ *
+ * Same loop as calibrate_timer() on the RPU. Going through /dev/mem O_SYNC
+ * every read is an uncached load across the interconnect, and each of our
+ * timestamps pays part of it.
+ */
+static void calibrate_timer(void)
+{
+    uint32_t min = 0xFFFFFFFFUL, max = 0;
+    uint64_t sum = 0, sum_sq = 0, var_micro;
+    uint32_t n = CALIB_SAMPLES;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t t0 = read_timer();
+        uint32_t t1 = read_timer();
+        uint32_t d = t1 - t0;
+        
+        if (d < min) min = d;
+        if (d > max) max = d;
+        sum += d;
+        sum_sq += (uint64_t)d * d;
+    }
+    
+    // Variance in ticks^2 scaled by 10^6, so its sqrt comes out in milliticks
+    var_micro = (sum_sq * n - sum * sum) * 1000000ULL / ((uint64_t)n * n);
+    
+    apu_calib.magic = CALIB_MAGIC;
+    apu_calib.samples = n;
+    apu_calib.min_ticks = min;
+    apu_calib.max_ticks = max;
+    apu_calib.mean_milliticks = (uint32_t)(sum * 1000 / n);
+    apu_calib.std_milliticks = (uint32_t)isqrt64(var_micro);
+    
+    printf("APU: Timer read cost %u.%03u ticks (min %u, max %u)\n",
+           apu_calib.mean_milliticks / 1000, apu_calib.mean_milliticks % 1000, min, max);
+}
+
+/**
+ * Record a trace event in the APU ring
+ */
+static inline void trace_event(uint32_t seq, uint32_t event, uint32_t phase, uint32_t arg)
+{
+    if (!trace_enabled) return;
+    
+    trace_entry_t *e = &apu_trace[apu_trace_count % APU_TRACE_CAPACITY];
+    e->timestamp = read_timer();
+    e->seq = seq;
+    e->event = (event << 16) | phase;
+    e->arg = arg;
+    apu_trace_count++;
+}
+
+/**
+ * Dump one trace ring to CSV, oldest event first
+ */
+static void write_trace_csv(const char *filename, const trace_entry_t *ring,
+                            uint32_t count, uint32_t capacity)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        perror("Cannot open trace file");
+        return;
+    }
+    
+    uint32_t entries = count < capacity ? count : capacity;
+    uint32_t first = count < capacity ? 0 : count % capacity;
+    
+    fprintf(fp, "timestamp,seq,event,phase,arg\n");
+    for (uint32_t i = 0; i < entries; i++) {
+        const trace_entry_t *e = &ring[(first + i) % capacity];
+        fprintf(fp, "%u,%u,%u,%u,%u\n", e->timestamp, e->seq,
+                e->event >> 16, e->event & 0xFFFF, e->arg);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote %u trace events to %s\n", entries, filename);
+}
+
+/**
+ * Build "<output without extension><suffix>" for the extra output files
+ */
+static void sibling_name(char *name, size_t len, const char *output_file, const char *suffix)
+{
+    const char *dot = strrchr(output_file, '.');
+    int base_len = dot ? (int)(dot - output_file) : (int)strlen(output_file);
+    
+    snprintf(name, len, "%.*s%s", base_len, output_file, suffix);
+}
+
+/**
+ * Save both trace rings next to the results file
+ */
+static void save_traces(const char *output_file)
+{
+    char name[512];
+    
+    sibling_name(name, sizeof(name), output_file, "_apu_trace.csv");
+    write_trace_csv(name, apu_trace, apu_trace_count, APU_TRACE_CAPACITY);
+    
+    // RPU ring lives in shared memory, copy it out of the uncached mapping first
+    uint32_t rpu_count = trace_mem[0];
+    uint32_t rpu_capacity = trace_mem[1];
+    if (rpu_capacity == 0 || rpu_capacity > APU_TRACE_CAPACITY) {
+        fprintf(stderr, "APU: Invalid RPU trace header (capacity %u)\n", rpu_capacity);
+        return;
+    }
+    
+    trace_entry_t *rpu_trace = malloc(rpu_capacity * sizeof(trace_entry_t));
+    if (!rpu_trace) {
+        perror("Failed to allocate RPU trace buffer");
+        return;
+    }
+    memcpy(rpu_trace, (const void *)&trace_mem[4], rpu_capacity * sizeof(trace_entry_t));
+    
+    sibling_name(name, sizeof(name), output_file, "_rpu_trace.csv");
+    write_trace_csv(name, rpu_trace, rpu_count, rpu_capacity);
+    
+    free(rpu_trace);
+}
+
+/**
+ * Open the APU counter group with perf_event_open
+ *
+ * On the A53 we use the raw PMUv3 event numbers (see the A53 TRM), on
+ * anything else (host backend) the closest generic events. Counters that
+ * can't be opened are reported as -1 instead of failing the run.
+ */
+static int open_pmu(void)
+{
+#ifdef __aarch64__
+    static const struct { uint32_t type; uint64_t config; const char *name; } events[APU_PMU_EVENTS] = {
+        { PERF_TYPE_RAW, 0x03, "L1D refill" },
+        { PERF_TYPE_RAW, 0x17, "L2D refill" },
+        { PERF_TYPE_RAW, 0x19, "bus access" },
+        { PERF_TYPE_RAW, 0xE7, "load-miss stall cycles" },
+        { PERF_TYPE_RAW, 0x05, "L1D TLB refill" },
+    };
+#else
+    static const struct { uint32_t type; uint64_t config; const char *name; } events[APU_PMU_EVENTS] = {
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "L1D refill" },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "LLC miss" },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BUS_CYCLES, "bus cycles" },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND, "backend stall cycles" },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "dTLB miss" },
+    };
+#endif
+    int leader = -1;
+    
+    for (int i = 0; i < APU_PMU_EVENTS; i++) {
+        struct perf_event_attr attr;
+        
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = (leader < 0);
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        
+        pmu_fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+        if (pmu_fds[i] < 0) {
+            printf("APU: PMU counter '%s' not available (%s)\n", events[i].name, strerror(errno));
+            pmu_slot[i] = -1;
+            continue;
+        }
+        
+        if (leader < 0) {
+            leader = pmu_fds[i];
+        }
+        pmu_slot[i] = pmu_group_size++;
+        printf("APU: PMU counter '%s' enabled\n", events[i].name);
+    }
+    
+    if (leader < 0) {
+        fprintf(stderr, "APU: WARNING - No APU PMU counters available (check perf_event_paranoid),\n");
+        fprintf(stderr, "APU: only RPU counters will be recorded\n");
+        return -1;
+    }
+    
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return leader;
+}
+
+static int pmu_leader = -1;
+
+/**
+ * Read all APU counters in one syscall
+ */
+static void read_pmu(uint64_t *values)
+{
+    uint64_t buf[1 + APU_PMU_EVENTS];
+    
+    if (pmu_leader < 0 || read(pmu_leader, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t)) {
+        memset(values, 0, APU_PMU_EVENTS * sizeof(uint64_t));
+        return;
+    }
+    
+    for (int i = 0; i < APU_PMU_EVENTS; i++) {
+        values[i] = pmu_slot[i] >= 0 ? buf[1 + pmu_slot[i]] : 0;
+    }
+}
+
+static void close_pmu(void)
+{
+    for (int i = 0; i < APU_PMU_EVENTS; i++) {
+        if (pmu_fds[i] >= 0) {
+            close(pmu_fds[i]);
+        }
+    }
+}
+
 /**
  * Wait for RPU to signal ready
  */
@@ -211,61 +888,1281 @@ static int wait_for_ack(int timeout_us)
     return -1;
 }
 
+/**
+ * Rewrite N evenly spread cache lines of the payload
+ *
+ * Each call changes the data (so it really is a new version of the table)
+ * and returns the touched lines as coalesced extents.
+ */
+static uint32_t write_dirty_lines(uint32_t size, const uint8_t *payload, extent_t *extents)
+{
+    volatile uint8_t *dst = (volatile uint8_t *)&shared_mem[4];
+    uint32_t total_lines = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+    uint32_t n = dirty_lines < total_lines ? dirty_lines : total_lines;
+    uint32_t num_extents = 0;
+    int overflow = 0;
+    
+    update_count++;
+    
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t offset = (uint32_t)((uint64_t)k * total_lines / n) * CACHE_LINE_SIZE;
+        uint32_t length = size - offset < CACHE_LINE_SIZE ? size - offset : CACHE_LINE_SIZE;
+        
+        for (uint32_t b = 0; b < length; b++) {
+            dst[offset + b] = payload[offset + b] ^ (uint8_t)update_count;
+        }
+        
+        if (overflow) continue;
+        
+        // Merge with the previous extent when the lines are adjacent
+        if (num_extents > 0 &&
+            extents[num_extents - 1].offset + extents[num_extents - 1].length == offset) {
+            extents[num_extents - 1].length += length;
+        } else if (num_extents < MAX_EXTENTS) {
+            extents[num_extents].offset = offset;
+            extents[num_extents].length = length;
+            num_extents++;
+        } else {
+            overflow = 1;
+        }
+    }
+    
+    return overflow ? EXTENT_OVERFLOW : num_extents;
+}
+
+/**
+ * Publish the extent table for the RPU
+ */
+static void publish_extents(const extent_t *extents, uint32_t count)
+{
+    if (count != EXTENT_OVERFLOW) {
+        for (uint32_t i = 0; i < count; i++) {
+            extent_mem[1 + i * 2] = extents[i].offset;
+            extent_mem[2 + i * 2] = extents[i].length;
+        }
+    }
+    extent_mem[0] = count;
+}
+
+/**
+ * Flags word for a packet: our sequence number plus what the RPU should record
+ */
+static uint32_t packet_flags(uint32_t seq)
+{
+    uint32_t flags = seq << FLAG_SEQ_SHIFT;
+    
+    if (trace_enabled) {
+        flags |= FLAG_TRACE;
+    }
+    if (pmu_enabled) {
+        flags |= FLAG_PMU;
+    }
+    return flags;
+}
+
+/**
+ * Wake the RPU if it sleeps between packets (-w ipi), after a control word write
+ */
+static inline void ring_rpu(void)
+{
+    if (ipi_regs) {
+        __sync_synchronize();
+        ipi_regs[IPI_TRIG / 4] = IPI_RPU0_MASK;
+    }
+}
+
+/**
+ * CLOCK_MONOTONIC in ns, the clock tracefs uses with trace_clock=mono
+ */
+static inline uint64_t mono_ns(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Remember when a packet's copy started, on TTC0 and (-k) on the OS clock
+ */
+static inline void stamp_start(uint32_t seq, uint32_t ts)
+{
+    start_ts[seq] = ts;
+    if (start_mono) {
+        start_mono[seq] = mono_ns();
+    }
+}
+
 /**
  * Send one packet to RPU
  */
 static int send_packet(uint32_t size, uint8_t *payload)
 {
     uint32_t ts;
+    uint32_t seq = packet_seq++;
+    uint32_t flags = packet_flags(seq);
     
     // Copy payload to shared memory if we have one
-    if (payload && size > 0) {
+    trace_event(seq, TRACE_APU_COPY, PHASE_BEGIN, size);
+    stamp_start(seq, read_timer());
+    if (dirty_lines > 0 && size == last_size && payload) {
+        // Partial update of the payload the RPU already has
+        extent_t extents[MAX_EXTENTS];
+        uint32_t count = write_dirty_lines(size, payload, extents);
+        
+        if (extents_enabled) {
+            publish_extents(extents, count);
+            flags |= FLAG_EXTENTS;
+        }
+    } else if (payload && size > 0) {
         memcpy((void *)&shared_mem[4], payload, size);
     }
+    last_size = size;
+    trace_event(seq, TRACE_APU_COPY, PHASE_END, size);
     
     // Write metadata (size goes in word 1)
+    trace_event(seq, TRACE_APU_META, PHASE_BEGIN, size);
     shared_mem[1] = size;
     
     // Timestamp right before we signal the RPU
     ts = read_timer();
     shared_mem[2] = ts;
-    shared_mem[3] = 0;  /* Reserved */
+    shared_mem[3] = flags;
+    trace_event(seq, TRACE_APU_META, PHASE_END, size);
     
     // Memory barrier to make sure everything's written
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_BEGIN, size);
     __sync_synchronize();
     
     // Signal that packet is ready
     shared_mem[0] = MAGIC_START;
+    ring_rpu();
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_END, size);
     
     // Wait for RPU to ACK (10ms timeout should be plenty)
+    trace_event(seq, TRACE_APU_ACK_WAIT, PHASE_BEGIN, size);
     if (wait_for_ack(10000) != 0) {
         fprintf(stderr, "APU: WARNING - No ACK for packet size %u\n", size);
         return -1;
     }
+    trace_event(seq, TRACE_APU_ACK_WAIT, PHASE_END, size);
     
     return 0;
 }
 
 /**
- * Run the experiment
+ * Send one packet as a stream of chunks
+ *
+ * MAGIC_START goes out before any data, then each chunk is copied and
+ * published through its marker. The RPU invalidates chunk k while we copy
+ * chunk k+1. The APU timestamp is taken before the first chunk, so here
+ * delta_us includes the copy (total_us is comparable across modes).
  */
-static int run_experiment(int iterations_per_size, const char *output_file)
+static int send_packet_stream(uint32_t size, uint8_t *payload)
 {
-    FILE *fp;
-    uint8_t *payload;
-    int size_idx, iter;
-    int total_packets = 0;
-    int failed_packets = 0;
+    uint32_t seq = packet_seq++;
+    uint32_t flags = packet_flags(seq) | FLAG_STREAM | (chunk_shift << FLAG_CHUNK_SHIFT);
+    uint32_t num_chunks = (size + chunk_size - 1) / chunk_size;
+    uint32_t ts;
     
-    printf("\n========================================\n");
-    printf("APU Performance Measurement Sender\n");
-    printf("(TTC0 Timer Version)\n");
-    printf("========================================\n");
-    printf("Iterations per size: %d\n", iterations_per_size);
-    printf("Number of packet sizes: %zu\n", NUM_SIZES);
-    printf("Total packets to send: %zu\n", NUM_SIZES * iterations_per_size);
-    printf("Output file: %s\n", output_file);
-    printf("========================================\n\n");
+    trace_event(seq, TRACE_APU_META, PHASE_BEGIN, size);
+    shared_mem[1] = size;
+    ts = read_timer();
+    stamp_start(seq, ts);
+    shared_mem[2] = ts;
+    shared_mem[3] = flags;
+    trace_event(seq, TRACE_APU_META, PHASE_END, size);
+    
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_BEGIN, size);
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_START;
+    ring_rpu();
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_END, size);
+    
+    trace_event(seq, TRACE_APU_COPY, PHASE_BEGIN, size);
+    for (uint32_t k = 0; k < num_chunks; k++) {
+        uint32_t offset = k * chunk_size;
+        uint32_t length = size - offset < chunk_size ? size - offset : chunk_size;
+        
+        if (payload) {
+            memcpy((void *)((uint8_t *)&shared_mem[4] + offset), payload + offset, length);
+        }
+        
+        // Chunk data must land before its marker
+        __sync_synchronize();
+        marker_mem[k] = CHUNK_MARKER(seq);
+    }
+    trace_event(seq, TRACE_APU_COPY, PHASE_END, size);
+    
+    trace_event(seq, TRACE_APU_ACK_WAIT, PHASE_BEGIN, size);
+    if (wait_for_ack(10000) != 0) {
+        fprintf(stderr, "APU: WARNING - No ACK for packet size %u\n", size);
+        return -1;
+    }
+    trace_event(seq, TRACE_APU_ACK_WAIT, PHASE_END, size);
+    
+    return 0;
+}
+
+static inline volatile uint32_t *slot_header(uint32_t slot)
+{
+    return (volatile uint32_t *)((uint8_t *)shared_mem + SLOT_OFFSET + slot * SLOT_STRIDE);
+}
+
+/**
+ * Busy-wait hint. On the board the RPU has its own core; on the host the
+ * emulated RPU may share ours, so give it a chance to run.
+ */
+static inline void cpu_relax(void)
+{
+#ifdef HOST_BACKEND
+    sched_yield();
+#endif
+}
+
+/**
+ * Spin until the RPU hands a slot back
+ *
+ * No usleep() here, it would take longer than the invalidate we're trying
+ * to overlap with. The timeout runs off TTC0 instead.
+ */
+static int wait_for_slot(volatile uint32_t *hdr)
+{
+    uint32_t start = read_timer();
+    
+    while (hdr[0] != MAGIC_ACK) {
+        if (read_timer() - start > SLOT_TIMEOUT_TICKS) {
+            return -1;
+        }
+        cpu_relax();
+    }
+    return 0;
+}
+
+/**
+ * Switch the RPU to N-buffer mode, all slots start out free
+ */
+static int start_nbuf(void)
+{
+    for (uint32_t i = 0; i < num_slots; i++) {
+        slot_header(i)[0] = MAGIC_ACK;
+    }
+    
+    shared_mem[1] = num_slots;
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_NBUF;
+    ring_rpu();
+    
+    if (wait_for_ack(10000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not accept N-buffer mode\n");
+        return -1;
+    }
+    
+    printf("APU: N-buffer mode, %u slots at 0x%08lX\n", num_slots, SHARED_MEM_BASE + SLOT_OFFSET);
+    return 0;
+}
+
+/**
+ * Ask the RPU to reprogram the MPU for the packet memory
+ */
+static int set_rpu_mem_attr(uint32_t attr)
+{
+    shared_mem[1] = attr;
+    shared_mem[2] = 1;  /* read the payload, or uncached would win for free */
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_ATTR;
+    ring_rpu();
+    
+    // Whole-cache flush on the RPU, give it more than a packet ACK
+    if (wait_for_ack(100000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not switch to '%s'\n", attr_names[attr]);
+        return -1;
+    }
+    
+    printf("\nAPU: RPU packet memory is now '%s'\n", attr_names[attr]);
+    return 0;
+}
+
+/**
+ * Tell the RPU how to wait between packets
+ *
+ * It's still spinning when this goes out, so no ring needed.
+ */
+static int set_rpu_wait(void)
+{
+    shared_mem[1] = wait_mode;
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_WAIT;
+    
+    if (wait_for_ack(100000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not switch its idle wait to '%s'\n",
+                wait_names[wait_mode]);
+        return -1;
+    }
+    
+    printf("APU: RPU idle wait is '%s'\n", wait_names[wait_mode]);
+    return 0;
+}
+
+/**
+ * Monotonic wall time in seconds
+ */
+static double now_s(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Start a run on the resident RPU: clean results areas, our invalidate
+ * strategy, and what we're about to send
+ */
+static int start_rpu_run(int iterations_per_size)
+{
+    volatile run_desc_t *desc = (volatile run_desc_t *)((uint8_t *)shared_mem + CONFIG_OFFSET);
+    
+    desc->run_id = (uint32_t)getpid();
+    desc->inval_strategy = inval_strategy;
+    desc->iterations = iterations_per_size * num_sweeps;
+    desc->num_sizes = NUM_SIZES;
+    for (size_t i = 0; i < NUM_SIZES; i++) {
+        desc->sizes[i] = packet_sizes[i];
+    }
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_CONFIG;
+    
+    // Clearing ~0.5 MB of results areas, give it more than a packet ACK
+    if (wait_for_ack(1000000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not accept the run descriptor "
+                        "(firmware older than the resident server?)\n");
+        return -1;
+    }
+    
+    printf("APU: Run %u configured, '%s' invalidate\n", desc->run_id, inval_names[inval_strategy]);
+    return 0;
+}
+
+/**
+ * Wait for the RPU to flush the results and go back to READY
+ */
+static void wait_for_rpu_results(void)
+{
+    for (int i = 0; i < 1000 && shared_mem[0] != MAGIC_READY; i++) {
+        usleep(1000);
+    }
+    if (shared_mem[0] != MAGIC_READY) {
+        fprintf(stderr, "APU: WARNING - RPU not back to READY after DONE, reading results anyway\n");
+    }
+}
+
+/**
+ * Give up on a run the RPU has accepted
+ *
+ * DONE ends the run whatever control message went unanswered, so the
+ * resident RPU is back at READY for the next one instead of stuck in
+ * the middle of this one.
+ */
+static void abort_rpu_run(void)
+{
+    fprintf(stderr, "APU: Aborting the run, sending DONE\n");
+    shared_mem[0] = MAGIC_DONE;
+    ring_rpu();
+    wait_for_rpu_results();
+}
+
+/**
+ * Stop the resident RPU server (-S)
+ */
+static int shutdown_rpu(void)
+{
+    if (wait_for_rpu_ready(30) != 0) {
+        return -1;
+    }
+    
+    shared_mem[0] = MAGIC_SHUTDOWN;
+    if (wait_for_ack(100000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not acknowledge SHUTDOWN\n");
+        return -1;
+    }
+    
+    printf("APU: RPU server stopped\n");
+    return 0;
+}
+
+/**
+ * Write a value into a tracefs control file
+ */
+static int tracefs_write(const char *file, const char *value)
+{
+    char path[256];
+    int fd, ret;
+    
+    snprintf(path, sizeof(path), "%s/%s", tracefs, file);
+    fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        return -1;
+    }
+    ret = write(fd, value, strlen(value)) < 0 ? -1 : 0;
+    close(fd);
+    return ret;
+}
+
+/**
+ * First line of a tracefs control file, without the newline
+ */
+static int tracefs_read(const char *file, char *value, size_t size)
+{
+    char path[256];
+    ssize_t n;
+    int fd;
+    
+    value[0] = '\0';
+    snprintf(path, sizeof(path), "%s/%s", tracefs, file);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    n = read(fd, value, size - 1);
+    close(fd);
+    if (n <= 0) {
+        value[0] = '\0';
+        return -1;
+    }
+    value[n] = '\0';
+    value[strcspn(value, "\n")] = '\0';
+    return 0;
+}
+
+/**
+ * Remember the tracefs settings start_os_events() changes, so
+ * stop_os_events() can put them back
+ *
+ * trace_clock lists every clock with the current one in brackets,
+ * buffer_size_kb may add "(expanded: N)" after the size.
+ */
+static void save_tracefs_settings(void)
+{
+    char clocks[256];
+    char *sel, *end;
+    
+    saved_trace_clock[0] = '\0';
+    if (tracefs_read("trace_clock", clocks, sizeof(clocks)) == 0 &&
+        (sel = strchr(clocks, '[')) != NULL && (end = strchr(sel, ']')) != NULL) {
+        *end = '\0';
+        snprintf(saved_trace_clock, sizeof(saved_trace_clock), "%s", sel + 1);
+    }
+    tracefs_read("tracing_cpumask", saved_cpumask, sizeof(saved_cpumask));
+    if (tracefs_read("buffer_size_kb", saved_buffer_kb, sizeof(saved_buffer_kb)) == 0) {
+        saved_buffer_kb[strcspn(saved_buffer_kb, " ")] = '\0';
+    }
+}
+
+/**
+ * Put back what save_tracefs_settings() found, skipping what it couldn't read
+ */
+static void restore_tracefs_settings(void)
+{
+    if (saved_trace_clock[0]) {
+        tracefs_write("trace_clock", saved_trace_clock);
+    }
+    if (saved_cpumask[0]) {
+        tracefs_write("tracing_cpumask", saved_cpumask);
+    }
+    if (saved_buffer_kb[0]) {
+        tracefs_write("buffer_size_kb", saved_buffer_kb);
+    }
+}
+
+/**
+ * Whole /proc/interrupts as text, parsed once the sweep is over
+ */
+static char *snapshot_interrupts(void)
+{
+    char *buf = malloc(IRQ_SNAPSHOT_MAX);
+    size_t len = 0;
+    ssize_t n;
+    int fd;
+    
+    fd = open("/proc/interrupts", O_RDONLY);
+    if (!buf || fd < 0) {
+        free(buf);
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    while (len < IRQ_SNAPSHOT_MAX - 1 && (n = read(fd, buf + len, IRQ_SNAPSHOT_MAX - 1 - len)) > 0) {
+        len += n;
+    }
+    buf[len] = '\0';
+    close(fd);
+    return buf;
+}
+
+/**
+ * Count for one IRQ line of a snapshot: on cpu, or summed over all CPUs
+ * when cpu < 0. Returns -1 if the snapshot has no such line.
+ */
+static int64_t irq_count(const char *snap, const char *irq, int cpu)
+{
+    size_t irq_len = strlen(irq);
+    const char *line = strchr(snap, '\n');
+    
+    while (line) {
+        const char *p = line + 1;
+        
+        while (*p == ' ') p++;
+        if (strncmp(p, irq, irq_len) == 0 && p[irq_len] == ':') {
+            int64_t total = 0;
+            char *end;
+            
+            p += irq_len + 1;
+            for (int c = 0; ; c++) {
+                unsigned long long v = strtoull(p, &end, 10);
+                if (end == p) break;
+                if (cpu < 0 || c == cpu) total += v;
+                p = end;
+            }
+            return total;
+        }
+        line = strchr(p, '\n');
+    }
+    return -1;
+}
+
+/**
+ * Start watching the OS on the sender's CPU (-k)
+ *
+ * Pins us to the CPU we're on, so "the sender CPU" stays one CPU, and
+ * turns on the scheduler/IRQ tracepoints for it alone. Without tracefs
+ * (not mounted, not root) only the interrupt counts are kept.
+ */
+static void start_os_events(void)
+{
+    char mask[32];
+    cpu_set_t set;
+    
+    sender_cpu = sched_getcpu();
+    CPU_ZERO(&set);
+    CPU_SET(sender_cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        perror("APU: WARNING - sched_setaffinity");
+    }
+    
+    irq_before = snapshot_interrupts();
+    
+    tracefs = TRACEFS_DIR;
+    if (access(TRACEFS_DIR "/tracing_on", W_OK) != 0) {
+        tracefs = access(TRACEFS_DIR_OLD "/tracing_on", W_OK) == 0 ? TRACEFS_DIR_OLD : NULL;
+    }
+    if (!tracefs) {
+        fprintf(stderr, "APU: WARNING - no writable tracefs, only /proc/interrupts deltas\n");
+        return;
+    }
+    
+    // Mask is a hex bitmap in 32-bit groups, fine up to 32 CPUs
+    snprintf(mask, sizeof(mask), "%x", 1U << sender_cpu);
+    tracefs_write("tracing_on", "0");
+    save_tracefs_settings();
+    tracefs_write("trace_clock", "mono");
+    tracefs_write("tracing_cpumask", mask);
+    tracefs_write("buffer_size_kb", OS_TRACE_BUFFER_KB);
+    tracefs_write("trace", "");
+    for (size_t i = 0; i < NUM_OS_TRACE_EVENTS; i++) {
+        char file[128];
+        
+        snprintf(file, sizeof(file), "events/%s/enable", os_trace_events[i]);
+        if (tracefs_write(file, "1") != 0) {
+            printf("APU: Tracepoint %s not available\n", os_trace_events[i]);
+        }
+    }
+    tracefs_write("tracing_on", "1");
+    
+    printf("APU: Tracing scheduler and IRQ events on CPU %d (%s)\n", sender_cpu, tracefs);
+}
+
+/**
+ * Copy the sender CPU's trace buffer to <output>_ftrace.txt
+ */
+static void save_os_trace(const char *output_file)
+{
+    char name[512], path[256], buf[65536];
+    FILE *in, *out;
+    size_t n;
+    
+    snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/trace", tracefs, sender_cpu);
+    sibling_name(name, sizeof(name), output_file, "_ftrace.txt");
+    in = fopen(path, "r");
+    out = fopen(name, "w");
+    if (!in || !out) {
+        perror("APU: WARNING - cannot save the ftrace buffer");
+    } else {
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+            fwrite(buf, 1, n, out);
+        }
+        printf("APU: Wrote CPU %d trace to %s\n", sender_cpu, name);
+    }
+    if (in) fclose(in);
+    if (out) fclose(out);
+}
+
+/**
+ * Write the interrupt lines that fired during the sweep to <output>_irq.csv
+ */
+static void save_irq_deltas(const char *output_file, const char *irq_after)
+{
+    char name[512];
+    FILE *fp;
+    
+    sibling_name(name, sizeof(name), output_file, "_irq.csv");
+    fp = fopen(name, "w");
+    if (!fp) {
+        perror("Cannot open IRQ file");
+        return;
+    }
+    
+    fprintf(fp, "# sender_cpu=%d\n", sender_cpu);
+    fprintf(fp, "irq,cpu_delta,total_delta,description\n");
+    for (const char *line = strchr(irq_after, '\n'); line; line = strchr(line + 1, '\n')) {
+        const char *p = line + 1, *colon, *eol, *d;
+        char irq[32], desc[128];
+        int64_t before, cpu_delta, total_delta;
+        
+        while (*p == ' ') p++;
+        eol = strchr(p, '\n');
+        if (!eol) eol = p + strlen(p);
+        colon = memchr(p, ':', eol - p);
+        if (!colon || colon - p >= (int)sizeof(irq)) continue;
+        snprintf(irq, sizeof(irq), "%.*s", (int)(colon - p), p);
+        
+        before = irq_count(irq_before, irq, -1);
+        total_delta = irq_count(irq_after, irq, -1) - before;
+        if (before < 0 || total_delta <= 0) continue;
+        cpu_delta = irq_count(irq_after, irq, sender_cpu) - irq_count(irq_before, irq, sender_cpu);
+        
+        // Description is whatever follows the counts, no commas in a CSV field
+        for (d = colon + 1; d < eol && (*d == ' ' || (*d >= '0' && *d <= '9')); d++);
+        snprintf(desc, sizeof(desc), "%.*s", (int)(eol - d), d);
+        for (char *c = desc; *c; c++) {
+            if (*c == ',') *c = ';';
+        }
+        fprintf(fp, "%s,%lld,%lld,%s\n", irq, (long long)cpu_delta, (long long)total_delta, desc);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote interrupt counts to %s\n", name);
+}
+
+/**
+ * Stop watching and save what we saw
+ */
+static void stop_os_events(const char *output_file)
+{
+    char *irq_after;
+    
+    if (tracefs) {
+        tracefs_write("tracing_on", "0");
+        for (size_t i = 0; i < NUM_OS_TRACE_EVENTS; i++) {
+            char file[128];
+            
+            snprintf(file, sizeof(file), "events/%s/enable", os_trace_events[i]);
+            tracefs_write(file, "0");
+        }
+        save_os_trace(output_file);
+        restore_tracefs_settings();
+    }
+    
+    irq_after = snapshot_interrupts();
+    if (irq_before && irq_after) {
+        save_irq_deltas(output_file, irq_after);
+    } else {
+        fprintf(stderr, "APU: WARNING - no /proc/interrupts snapshot\n");
+    }
+    free(irq_after);
+    free(irq_before);
+    irq_before = NULL;
+}
+
+/**
+ * Turn on the RPU's priority lane
+ */
+static int set_rpu_lanes(void)
+{
+    hp_lane[0] = MAGIC_ACK;
+    shared_mem[1] = 1;
+    __sync_synchronize();
+    shared_mem[0] = MAGIC_LANES;
+    ring_rpu();
+    
+    if (wait_for_ack(100000) != 0) {
+        fprintf(stderr, "APU: ERROR - RPU did not turn on the priority lane\n");
+        return -1;
+    }
+    
+    printf("APU: Priority lane at 0x%08lX, %u messages/s\n",
+           SHARED_MEM_BASE + HP_LANE_OFFSET, hp_rate_hz);
+    return 0;
+}
+
+/**
+ * Priority-lane sender thread
+ *
+ * Every 1/hp_rate_hz seconds, write a small message into the lane line
+ * and ring the RPU, while the main thread keeps the bulk lane busy. The
+ * lane holds one message: if the last one is still there when the next
+ * period starts we count it late and skip the period, so a stalled RPU
+ * shows up as hp_late instead of a queue.
+ */
+static void *hp_sender(void *arg)
+{
+    volatile uint8_t *data = (volatile uint8_t *)&hp_lane[4];
+    uint64_t period_ns = 1000000000ULL / hp_rate_hz;
+    struct timespec next;
+    uint32_t seq = 0;
+    
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    
+    while (!hp_stop) {
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        
+        if (hp_lane[0] != MAGIC_ACK) {
+            hp_late++;
+            continue;
+        }
+        
+        for (uint32_t i = 0; i < HP_MSG_SIZE; i++) {
+            data[i] = (uint8_t)(seq + i);
+        }
+        hp_lane[1] = HP_MSG_SIZE;
+        hp_lane[3] = seq;
+        hp_lane[2] = read_timer();
+        __sync_synchronize();
+        hp_lane[0] = MAGIC_START;
+        ring_rpu();
+        
+        seq++;
+        hp_sent = seq;
+    }
+    
+    // Leave the lane free for DONE, the RPU stops looking at it after that
+    uint32_t start = read_timer();
+    while (hp_lane[0] != MAGIC_ACK && read_timer() - start < HP_TIMEOUT_TICKS) {
+        cpu_relax();
+    }
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Print median/p99/max of one group of priority-lane latencies
+ */
+static void print_hp_stats(const char *label, double *lat, uint32_t n)
+{
+    if (n == 0) {
+        printf("  %-14s %8s\n", label, "none");
+        return;
+    }
+    qsort(lat, n, sizeof(lat[0]), compare_double);
+    printf("  %-14s %8u %12.3f %12.3f %12.3f\n", label, n,
+           lat[n / 2], lat[(uint32_t)(n * 0.99)], lat[n - 1]);
+}
+
+/**
+ * Write the priority-lane records to <output>_hp.csv and print latency
+ * with the bulk lane idle vs busy
+ */
+static void save_hp_results(const char *output_file)
+{
+    uint32_t count = hp_results_mem[0];
+    double *idle, *busy;
+    uint32_t n_idle = 0, n_busy = 0;
+    char name[512];
+    FILE *fp;
+    
+    if (count > MAX_HP_RESULTS) {
+        fprintf(stderr, "APU: Invalid priority-lane count: %u\n", count);
+        return;
+    }
+    
+    sibling_name(name, sizeof(name), output_file, "_hp.csv");
+    fp = fopen(name, "w");
+    idle = malloc((count + 1) * sizeof(double));
+    busy = malloc((count + 1) * sizeof(double));
+    if (!fp || !idle || !busy) {
+        perror("Cannot write priority-lane results");
+        if (fp) fclose(fp);
+        free(idle);
+        free(busy);
+        return;
+    }
+    
+    fprintf(fp, "# hp_rate_hz=%u\n", hp_rate_hz);
+    fprintf(fp, "# hp_sent=%u\n", hp_sent);
+    fprintf(fp, "# hp_late=%u\n", hp_late);
+    fprintf(fp, "seq,apu_timestamp,rpu_timestamp,delta_ticks,delta_us,bulk_size\n");
+    
+    for (uint32_t i = 0; i < count; i++) {
+        volatile hp_entry_t *e = &((volatile hp_entry_t *)&hp_results_mem[1])[i];
+        uint32_t delta = e->rpu_timestamp - e->apu_timestamp;
+        double delta_us = delta / TIMER_FREQ_MHZ;
+        
+        fprintf(fp, "%u,%u,%u,%u,%.3f,%u\n", e->seq, e->apu_timestamp, e->rpu_timestamp,
+                delta, delta_us, e->bulk_size);
+        if (e->bulk_size > 0) {
+            busy[n_busy++] = delta_us;
+        } else {
+            idle[n_idle++] = delta_us;
+        }
+    }
+    fclose(fp);
+    
+    printf("\nPriority lane: %u sent, %u received, %u late\n", hp_sent, count, hp_late);
+    printf("  %-14s %8s %12s %12s %12s\n", "Bulk lane", "Samples", "Median (us)", "p99 (us)", "Max (us)");
+    print_hp_stats("idle", idle, n_idle);
+    print_hp_stats("mid-packet", busy, n_busy);
+    printf("APU: Wrote priority-lane results to %s\n", name);
+    
+    free(idle);
+    free(busy);
+}
+
+/**
+ * Parse "all" or a comma separated list of attribute names
+ */
+static int parse_attr_list(const char *arg)
+{
+    char buf[128];
+    char *tok, *save = NULL;
+    
+    if (strcmp(arg, "all") == 0) {
+        for (uint32_t i = 0; i < NUM_ATTRS; i++) {
+            attr_list[i] = i;
+        }
+        num_attrs = NUM_ATTRS;
+        return 0;
+    }
+    
+    snprintf(buf, sizeof(buf), "%s", arg);
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        uint32_t i;
+        
+        for (i = 0; i < NUM_ATTRS && strcmp(tok, attr_names[i]) != 0; i++);
+        if (i == NUM_ATTRS || num_attrs == NUM_ATTRS) {
+            fprintf(stderr, "APU: Unknown memory attribute '%s'\n", tok);
+            return -1;
+        }
+        attr_list[num_attrs++] = i;
+    }
+    return num_attrs > 0 ? 0 : -1;
+}
+
+/**
+ * Send one packet through the next slot, without waiting for the RPU
+ *
+ * We only block when the slot we want still belongs to the RPU, so while
+ * it invalidates slot k we're already copying into slot k+1.
+ */
+static int send_packet_nbuf(uint32_t size, uint8_t *payload)
+{
+    uint32_t seq = packet_seq++;
+    uint32_t flags = packet_flags(seq);
+    volatile uint32_t *hdr = slot_header(seq % num_slots);
+    uint32_t t0;
+    
+    trace_event(seq, TRACE_APU_SLOT_WAIT, PHASE_BEGIN, size);
+    if (wait_for_slot(hdr) != 0) {
+        fprintf(stderr, "APU: WARNING - Slot %u never freed (packet size %u)\n",
+                seq % num_slots, size);
+        return -1;
+    }
+    trace_event(seq, TRACE_APU_SLOT_WAIT, PHASE_END, size);
+    
+    trace_event(seq, TRACE_APU_COPY, PHASE_BEGIN, size);
+    t0 = read_timer();
+    stamp_start(seq, t0);
+    if (payload && size > 0) {
+        memcpy((void *)((uint8_t *)hdr + SLOT_HEADER_SIZE), payload, size);
+    }
+    copy_ticks += read_timer() - t0;
+    trace_event(seq, TRACE_APU_COPY, PHASE_END, size);
+    
+    trace_event(seq, TRACE_APU_META, PHASE_BEGIN, size);
+    hdr[1] = size;
+    hdr[2] = read_timer();
+    hdr[3] = flags;
+    trace_event(seq, TRACE_APU_META, PHASE_END, size);
+    
+    // Hand the slot over
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_BEGIN, size);
+    __sync_synchronize();
+    hdr[0] = MAGIC_START;
+    trace_event(seq, TRACE_APU_DOORBELL, PHASE_END, size);
+    
+    return 0;
+}
+
+/**
+ * Wait until the RPU has consumed every slot
+ */
+static int drain_slots(void)
+{
+    int ret = 0;
+    
+    for (uint32_t i = 0; i < num_slots; i++) {
+        if (wait_for_slot(slot_header(i)) != 0) {
+            fprintf(stderr, "APU: WARNING - Slot %u not drained\n", i);
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Append APU and RPU counter columns for result i
+ */
+static void write_pmu_columns(FILE *fp, uint32_t i)
+{
+    volatile pmu_entry_t *e = &((volatile pmu_entry_t *)pmu_mem)[i];
+    int valid = (e->valid == 0xA5A5A5A5) && (e->seq < packet_seq);
+    
+    for (int k = 0; k < APU_PMU_EVENTS; k++) {
+        fprintf(fp, ",%lld", valid ? (long long)apu_counters[e->seq][k] : -1LL);
+    }
+    for (int k = 0; k <= RPU_PMU_EVENTS; k++) {
+        fprintf(fp, ",%lld", valid ? (long long)e->inv[k] : -1LL);
+    }
+    for (int k = 0; k <= RPU_PMU_EVENTS; k++) {
+        fprintf(fp, ",%lld", valid ? (long long)e->read[k] : -1LL);
+    }
+}
+
+/**
+ * Send the empty-loop calibration packets
+ *
+ * Zero-size packets through the normal path: no copy, no invalidate, so
+ * their delta is the fixed cost of the protocol (doorbell, poll detect, two
+ * timer reads). Sent before any mode switch so every mode gets the same loop.
+ */
+static int send_calibration_packets(void)
+{
+    int failed = 0;
+    
+    printf("APU: Measuring empty-loop overhead (%d packets)...\n", CALIB_PACKETS);
+    for (int i = 0; i < CALIB_PACKETS; i++) {
+        if (send_packet(0, NULL) != 0) {
+            failed++;
+        }
+        usleep(100);
+    }
+    last_size = 0;
+    
+    return failed;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Read mem_interference's status file
+ */
+static int read_load_status(const char *path, load_status_t *st)
+{
+    char line[128];
+    unsigned long long v;
+    FILE *f;
+    
+    memset(st, 0, sizeof(*st));
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    
+    while (fgets(line, sizeof(line), f)) {
+        sscanf(line, "kernel=%15s", st->kernel);
+        sscanf(line, "cores=%63s", st->cores);
+        sscanf(line, "target_mbps=%lf", &st->target_mbps);
+        sscanf(line, "running=%d", &st->running);
+        if (sscanf(line, "elapsed_ns=%llu", &v) == 1) st->elapsed_ns = v;
+        if (sscanf(line, "bytes=%llu", &v) == 1) st->bytes = v;
+    }
+    
+    fclose(f);
+    st->valid = 1;
+    return 0;
+}
+
+/**
+ * Tag the run with the background load measured during the sweep
+ */
+static void write_load_header(FILE *fp)
+{
+    load_status_t after;
+    double mbps = -1.0;
+    
+    if (read_load_status(load_status_file, &after) == 0 && load_before.valid &&
+        after.elapsed_ns > load_before.elapsed_ns) {
+        mbps = (after.bytes - load_before.bytes) * 1000.0 /
+               (after.elapsed_ns - load_before.elapsed_ns);
+    }
+    
+    if (mbps < 0) {
+        fprintf(stderr, "APU: WARNING - no interference bandwidth from %s\n", load_status_file);
+    } else {
+        printf("APU: Interference bandwidth during the sweep: %.0f MB/s\n", mbps);
+    }
+    
+    fprintf(fp, "# interference_kernel=%s\n", after.valid ? after.kernel : "unknown");
+    fprintf(fp, "# interference_cores=%s\n", after.valid ? after.cores : "unknown");
+    fprintf(fp, "# interference_target_mbps=%.1f\n", after.target_mbps);
+    fprintf(fp, "# interference_mbps=%.1f\n", mbps);
+}
+
+/**
+ * Write the run header: calibration results as "# key=value" lines
+ *
+ * Comment lines, so readers that don't know about them can skip them
+ * (pandas comment='#'). The analysis can subtract either bias from delta_us.
+ */
+static void write_run_header(FILE *fp, uint32_t count, int iterations_per_size)
+{
+    volatile calib_block_t *rpu_calib = (volatile calib_block_t *)calib_mem;
+    uint32_t empty[CALIB_PACKETS];
+    uint32_t n = 0;
+    uint64_t sum = 0, sum_sq = 0;
+    
+    for (uint32_t i = 0; i < count && n < CALIB_PACKETS; i++) {
+        volatile first_byte_entry_t *fb = &((volatile first_byte_entry_t *)first_byte_mem)[i];
+        
+        if (fb->seq < CALIB_PACKETS && results_mem[1 + i * 5 + 4] == 0xA5A5A5A5) {
+            uint32_t d = results_mem[1 + i * 5 + 3];
+            empty[n++] = d;
+            sum += d;
+            sum_sq += (uint64_t)d * d;
+        }
+    }
+    
+    fprintf(fp, "# timer_freq_mhz=%.1f\n", TIMER_FREQ_MHZ);
+    fprintf(fp, "# iterations=%d\n", iterations_per_size);
+    fprintf(fp, "# mode=%s\n", num_slots > 0 ? "nbuf" : chunk_size > 0 ? "stream" : "plain");
+    fprintf(fp, "# mapping=%s\n", hugepages ? "2m" : "4k");
+    fprintf(fp, "# inval_strategy=%s\n", inval_names[inval_strategy]);
+    fprintf(fp, "# ready_wait_s=%.3f\n", ready_wait_s);
+    fprintf(fp, "# setup_s=%.3f\n", setup_s);
+    fprintf(fp, "# sweep_s=%.3f\n", sweep_s);
+    if (wait_mode >= 0) {
+        fprintf(fp, "# rpu_wait=%s\n", wait_names[wait_mode]);
+    }
+    if (hp_rate_hz > 0) {
+        fprintf(fp, "# hp_rate_hz=%u\n", hp_rate_hz);
+    }
+    if (os_events) {
+        fprintf(fp, "# sender_cpu=%d\n", sender_cpu);
+        fprintf(fp, "# sender_pid=%d\n", (int)getpid());
+        fprintf(fp, "# os_trace=%s\n", tracefs ? "tracefs" : "irq-only");
+    }
+    if (hugepages) {
+        fprintf(fp, "# huge_mapped_kb=%ld\n", huge_mapped_kb());
+    }
+    fprintf(fp, "# apu_timer_read_ticks_mean=%.3f\n", apu_calib.mean_milliticks / 1000.0);
+    fprintf(fp, "# apu_timer_read_ticks_std=%.3f\n", apu_calib.std_milliticks / 1000.0);
+    fprintf(fp, "# apu_timer_read_ticks_min=%u\n", apu_calib.min_ticks);
+    fprintf(fp, "# apu_timer_read_ticks_max=%u\n", apu_calib.max_ticks);
+    
+    if (rpu_calib->magic == CALIB_MAGIC) {
+        fprintf(fp, "# rpu_timer_read_ticks_mean=%.3f\n", rpu_calib->mean_milliticks / 1000.0);
+        fprintf(fp, "# rpu_timer_read_ticks_std=%.3f\n", rpu_calib->std_milliticks / 1000.0);
+        fprintf(fp, "# rpu_timer_read_ticks_min=%u\n", rpu_calib->min_ticks);
+        fprintf(fp, "# rpu_timer_read_ticks_max=%u\n", rpu_calib->max_ticks);
+        fprintf(fp, "# rpu_inval_full_ticks=%u\n", rpu_calib->inval_full_ticks);
+        fprintf(fp, "# rpu_inval_crossover_bytes=%u\n", rpu_calib->inval_crossover);
+        for (int k = 0; k < INVAL_CALIB_SIZES; k++) {
+            fprintf(fp, "# rpu_inval_range_ticks_%u=%u\n", INVAL_CALIB_MIN << k,
+                    rpu_calib->inval_range_ticks[k]);
+        }
+    } else {
+        fprintf(stderr, "APU: WARNING - no timer calibration from the RPU\n");
+    }
+    
+    if (n > 0) {
+        double mean = (double)sum / n;
+        double var = (double)sum_sq / n - mean * mean;
+        
+        qsort(empty, n, sizeof(empty[0]), compare_u32);
+        fprintf(fp, "# empty_loop_samples=%u\n", n);
+        fprintf(fp, "# empty_loop_us_median=%.3f\n", empty[n / 2] / TIMER_FREQ_MHZ);
+        fprintf(fp, "# empty_loop_us_mean=%.3f\n", mean / TIMER_FREQ_MHZ);
+        fprintf(fp, "# empty_loop_us_std=%.3f\n", isqrt64(var > 0 ? (uint64_t)(var * 1e6) : 0) / 1000.0 / TIMER_FREQ_MHZ);
+        fprintf(fp, "# empty_loop_us_min=%.3f\n", empty[0] / TIMER_FREQ_MHZ);
+        printf("APU: Empty-loop overhead %.3f us median over %u packets\n",
+               empty[n / 2] / TIMER_FREQ_MHZ, n);
+    }
+    
+    if (load_status_file) {
+        write_load_header(fp);
+    }
+}
+
+/**
+ * Read results back from the RPU results area
+ *
+ * The empty-loop calibration packets only go into the run header.
+ */
+static int read_results(FILE *fp)
+{
+    uint32_t count = results_mem[0];
+    uint64_t polls = 0, wakeups = 0;
+    uint32_t measured = 0;
+    
+    printf("APU: Reading %u results from RPU...\n", count);
+    
+    if (count == 0 || count > MAX_RESULTS) {
+        fprintf(stderr, "APU: Invalid result count: %u\n", count);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t offset = 1 + (i * 5);
+        
+        uint32_t pkt_size = results_mem[offset + 0];
+        uint32_t apu_ts = results_mem[offset + 1];
+        uint32_t rpu_ts = results_mem[offset + 2];
+        uint32_t delta_ticks = results_mem[offset + 3];
+        uint32_t valid = results_mem[offset + 4];
+        
+        if (valid != 0xA5A5A5A5) {
+            fprintf(stderr, "APU: Invalid result marker at index %u\n", i);
+            continue;
+        }
+        
+        volatile first_byte_entry_t *fb = &((volatile first_byte_entry_t *)first_byte_mem)[i];
+        if (fb->seq < CALIB_PACKETS) {
+            continue;
+        }
+        
+        double delta_us = (double)delta_ticks / TIMER_FREQ_MHZ;
+        
+        // Time-to-first-byte and total, both from the start of our copy
+        double ttfb_us = -1.0, total_us = -1.0;
+        if (fb->seq < packet_seq) {
+            ttfb_us = (uint32_t)(fb->timestamp - start_ts[fb->seq]) / TIMER_FREQ_MHZ;
+            total_us = (uint32_t)(rpu_ts - start_ts[fb->seq]) / TIMER_FREQ_MHZ;
+        }
+        
+        fprintf(fp, "%u,%u,%u,%u,%.3f,%.3f,%.3f",
+                pkt_size, apu_ts, rpu_ts, delta_ticks, delta_us, ttfb_us, total_us);
+        
+        if (num_attrs > 0) {
+            fprintf(fp, ",%s", fb->seq < packet_seq ? attr_names[packet_attr[fb->seq]] : "unknown");
+        }
+        
+        // The sample's window on the OS clock, copy start to RPU timestamp
+        if (os_events) {
+            if (fb->seq < packet_seq) {
+                uint64_t ns = (uint64_t)(uint32_t)(rpu_ts - start_ts[fb->seq]) * 1000 / TIMER_FREQ_MHZ;
+                fprintf(fp, ",%llu,%llu", (unsigned long long)start_mono[fb->seq],
+                        (unsigned long long)(start_mono[fb->seq] + ns));
+            } else {
+                fprintf(fp, ",-1,-1");
+            }
+        }
+        
+        if (wait_mode >= 0) {
+            volatile wait_entry_t *w = &((volatile wait_entry_t *)wait_mem)[i];
+            fprintf(fp, ",%u,%u", w->polls, w->wakeups);
+            polls += w->polls;
+            wakeups += w->wakeups;
+            measured++;
+        }
+        
+        if (pmu_enabled) {
+            write_pmu_columns(fp, i);
+        }
+        fprintf(fp, "\n");
+    }
+    
+    printf("APU: Successfully read %u results\n", count);
+    if (measured > 0) {
+        printf("APU: RPU idle wait '%s': %.1f polls, %.1f wakeups per packet\n",
+               wait_names[wait_mode], (double)polls / measured, (double)wakeups / measured);
+    }
+    
+    return 0;
+}
+
+/**
+ * Write and print the effective per-packet cost of an N-buffer run
+ *
+ * Compare -b 1 (copy and invalidate strictly serialized) with -b 2 or
+ * more: with enough overlap per_packet_us drops towards max(copy, invalidate).
+ */
+static void save_throughput(const char *output_file, const double *per_packet_us,
+                            const double *copy_us)
+{
+    char name[512];
+    FILE *fp;
+    
+    sibling_name(name, sizeof(name), output_file, "_throughput.csv");
+    fp = fopen(name, "w");
+    if (!fp) {
+        perror("Cannot open throughput file");
+        return;
+    }
+    
+    printf("\n%-10s %8s %16s %12s\n", "Size", "Buffers", "Per packet (us)", "Copy (us)");
+    fprintf(fp, "packet_size,buffers,per_packet_us,copy_us\n");
+    for (size_t i = 0; i < NUM_SIZES; i++) {
+        printf("%-10u %8u %16.3f %12.3f\n", packet_sizes[i], num_slots,
+               per_packet_us[i], copy_us[i]);
+        fprintf(fp, "%u,%u,%.3f,%.3f\n", packet_sizes[i], num_slots,
+                per_packet_us[i], copy_us[i]);
+    }
+    
+    fclose(fp);
+    printf("APU: Wrote throughput summary to %s\n", name);
+}
+
+/**
+ * Run the experiment
+ */
+static int run_experiment(int iterations_per_size, const char *output_file)
+{
+    FILE *fp;
+    uint8_t *payload;
+    size_t size_idx;
+    int iter;
+    int total_packets = 0;
+    int failed_packets = 0;
+    pthread_t hp_thread;
+    double t0 = now_s(), t_ready, t_sweep;
+    double per_packet_us[NUM_SIZES];
+    double copy_us[NUM_SIZES];
+    
+    printf("\n========================================\n");
+    printf("APU Performance Measurement Sender\n");
+    printf("(TTC0 Timer Version)\n");
+    printf("========================================\n");
+    printf("Iterations per size: %d\n", iterations_per_size);
+    printf("Number of packet sizes: %zu\n", NUM_SIZES);
+    printf("Total packets to send: %zu\n", NUM_SIZES * iterations_per_size * num_sweeps);
+    printf("Output file: %s\n", output_file);
+    if (num_slots > 0) {
+        printf("Buffers: %u (back-to-back, no inter-packet delay)\n", num_slots);
+    }
+    printf("========================================\n\n");
     
     // Allocate buffer for the largest packet we'll send
     payload = (uint8_t *)malloc(packet_sizes[NUM_SIZES - 1]);
@@ -284,30 +2181,441 @@ static int run_experiment(int iterations_per_size, const char *output_file)
         free(payload);
         return -1;
     }
+    t_ready = now_s();
+    ready_wait_s = t_ready - t0;
+    
+    if (start_rpu_run(iterations_per_size) != 0) {
+        free(payload);
+        return -1;
+    }
+    
+    if (load_status_file) {
+        if (read_load_status(load_status_file, &load_before) != 0 || !load_before.running) {
+            fprintf(stderr, "APU: WARNING - mem_interference doesn't seem to be running (%s)\n",
+                    load_status_file);
+        } else {
+            printf("APU: Background load: %s on CPUs %s\n", load_before.kernel, load_before.cores);
+        }
+    }
+    
+    if (wait_mode >= 0 && set_rpu_wait() != 0) {
+        abort_rpu_run();
+        free(payload);
+        return -1;
+    }
+    
+    if (hp_rate_hz > 0 && set_rpu_lanes() != 0) {
+        abort_rpu_run();
+        free(payload);
+        return -1;
+    }
+    
+    if (send_calibration_packets() != 0) {
+        fprintf(stderr, "APU: WARNING - some calibration packets got no ACK\n");
+    }
+    
+    if (num_slots > 0 && start_nbuf() != 0) {
+        abort_rpu_run();
+        free(payload);
+        return -1;
+    }
+    
+    // Stale markers from an earlier run could match a sequence number
+    if (chunk_size > 0) {
+        for (uint32_t k = 0; k < MAX_CHUNKS; k++) {
+            marker_mem[k] = 0;
+        }
+        printf("APU: Streaming mode, %u-byte chunks\n", chunk_size);
+    }
+    
+    // Control messages run alongside the whole sweep
+    if (hp_rate_hz > 0 && pthread_create(&hp_thread, NULL, hp_sender, NULL) != 0) {
+        perror("Failed to start the priority-lane sender");
+        abort_rpu_run();
+        free(payload);
+        return -1;
+    }
     
     printf("APU: Starting experiment...\n\n");
+    if (os_events) {
+        start_os_events();
+    }
     
-    // Test each packet size
-    for (size_idx = 0; size_idx < NUM_SIZES; size_idx++) {
-        uint32_t pkt_size = packet_sizes[size_idx];
-        
-        printf("APU: Testing packet size: %u bytes\n", pkt_size);
+    t_sweep = now_s();
+    setup_s = t_sweep - t_ready;
+    
+    // One full sweep, or one per memory attribute with -m
+    for (uint32_t sweep = 0; sweep < num_sweeps; sweep++) {
+        if (num_attrs > 0 && set_rpu_mem_attr(attr_list[sweep]) != 0) {
+            failed_packets += NUM_SIZES * iterations_per_size;
+            continue;
+        }
         
-        // Run multiple iterations for each size to get statistics
-        for (iter = 0; iter < iterations_per_size; iter++) {
-            if (send_packet(pkt_size, payload) == 0) {
-                total_packets++;
-            } else {
-                failed_packets++;
+        // Test each packet size
+        for (size_idx = 0; size_idx < NUM_SIZES; size_idx++) {
+            uint32_t pkt_size = packet_sizes[size_idx];
+            
+            uint32_t size_start;
+            
+            printf("APU: Testing packet size: %u bytes\n", pkt_size);
+            copy_ticks = 0;
+            size_start = read_timer();
+            
+            // Run multiple iterations for each size to get statistics
+            for (iter = 0; iter < iterations_per_size; iter++) {
+                uint64_t pmu_before[APU_PMU_EVENTS], pmu_after[APU_PMU_EVENTS];
+                uint32_t seq = packet_seq;
+                int ret;
+                
+                if (num_attrs > 0) {
+                    packet_attr[seq] = attr_list[sweep];
+                }
+                
+                if (pmu_enabled) {
+                    read_pmu(pmu_before);
+                }
+                
+                if (num_slots > 0) {
+                    ret = send_packet_nbuf(pkt_size, payload);
+                } else if (chunk_size > 0) {
+                    ret = send_packet_stream(pkt_size, payload);
+                } else {
+                    ret = send_packet(pkt_size, payload);
+                }
+                
+                if (pmu_enabled) {
+                    read_pmu(pmu_after);
+                    for (int k = 0; k < APU_PMU_EVENTS; k++) {
+                        apu_counters[seq][k] = pmu_slot[k] >= 0 ?
+                            (int64_t)(pmu_after[k] - pmu_before[k]) : -1;
+                    }
+                }
+                
+                if (ret == 0) {
+                    total_packets++;
+                } else {
+                    failed_packets++;
+                }
+                
+                // Small delay between packets, N-buffer mode runs back-to-back
+                if (num_slots == 0) {
+                    usleep(100);  /* 100us */
+                }
+            }
+            
+            /*
+             * Effective per-packet cost: wall time for the whole batch, including
+             * draining the last slots. Only meaningful without the usleep().
+             */
+            if (num_slots > 0) {
+                drain_slots();
+                per_packet_us[size_idx] = (uint32_t)(read_timer() - size_start) /
+                                          TIMER_FREQ_MHZ / iterations_per_size;
+                copy_us[size_idx] = copy_ticks / TIMER_FREQ_MHZ / iterations_per_size;
             }
             
-            // Small delay between packets
-            usleep(100);  /* 100us */
+            printf("APU: Completed %d iterations for size %u\n", 
+                   iterations_per_size, pkt_size);
         }
-        
-        printf("APU: Completed %d iterations for size %u\n", 
-               iterations_per_size, pkt_size);
+    }
+    
+    if (hp_rate_hz > 0) {
+        hp_stop = 1;
+        pthread_join(hp_thread, NULL);
+    }
+    
+    sweep_s = now_s() - t_sweep;
+    
+    if (os_events) {
+        stop_os_events(output_file);
     }
     
     printf("\nAPU: Sending DONE signal...\n");
-    shared_mem[0] = MAGIC_DONE;
\ No newline at end of file
+    shared_mem[0] = MAGIC_DONE;
+    ring_rpu();
+    
+    // The RPU flushes its results, then goes back to READY for the next run
+    wait_for_rpu_results();
+    
+    // Open output file
+    fp = fopen(output_file, "w");
+    if (!fp) {
+        perror("Cannot open output file");
+        free(payload);
+        return -1;
+    }
+    
+    // Run header (calibration), then the CSV header
+    write_run_header(fp, results_mem[0] <= MAX_RESULTS ? results_mem[0] : 0, iterations_per_size);
+    fprintf(fp, "packet_size,apu_timestamp,rpu_timestamp,delta_ticks,delta_us,ttfb_us,total_us");
+    if (num_attrs > 0) {
+        fprintf(fp, ",mem_attr");
+    }
+    if (os_events) {
+        fprintf(fp, ",start_mono_ns,end_mono_ns");
+    }
+    if (wait_mode >= 0) {
+        fprintf(fp, ",rpu_polls,rpu_wakeups");
+    }
+    if (pmu_enabled) {
+        fprintf(fp, ",apu_l1d_refill,apu_l2d_refill,apu_bus_access,apu_stall_cycles,apu_dtlb_refill"
+                    ",rpu_inv_cycles,rpu_inv_dcache_miss,rpu_inv_ext_mem_req,rpu_inv_lsu_stall"
+                    ",rpu_read_cycles,rpu_read_dcache_miss,rpu_read_ext_mem_req,rpu_read_lsu_stall");
+    }
+    fprintf(fp, "\n");
+    
+    // Pull the measurements back from the RPU
+    if (read_results(fp) != 0) {
+        fprintf(stderr, "APU: Failed to read results\n");
+    }
+    
+    if (trace_enabled) {
+        save_traces(output_file);
+    }
+    
+    if (num_slots > 0) {
+        save_throughput(output_file, per_packet_us, copy_us);
+    }
+    
+    if (hp_rate_hz > 0) {
+        save_hp_results(output_file);
+    }
+    
+    printf("\n========================================\n");
+    printf("Experiment Complete\n");
+    printf("========================================\n");
+    printf("Total packets sent: %d\n", total_packets);
+    printf("Failed packets: %d\n", failed_packets);
+    printf("Success rate: %.1f%%\n", 100.0 * total_packets / (total_packets + failed_packets));
+    printf("========================================\n");
+    
+    fclose(fp);
+    free(payload);
+    
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options] [iterations] [output.csv]\n", prog);
+    printf("  -b N  N-buffer mode with N slots (1-%d): fill the next slot while\n", MAX_SLOTS);
+    printf("        the RPU invalidates the current one, packets go back-to-back\n");
+    printf("        (writes <output>_throughput.csv, compare -b 1 with -b 2)\n");
+    printf("  -m L  Repeat the sweep for each RPU memory attribute in L (comma separated\n");
+    printf("        from wb,wt,nc,device,so, or \"all\"), RPU reads the payload\n");
+    printf("        while timed (adds a mem_attr column)\n");
+    printf("  -s N  Streaming mode: send the payload in N-byte chunks (power of two,\n");
+    printf("        %d-%d) so the RPU can start on chunk k while we write k+1\n",
+           MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+    printf("  -d N  Partial updates: after the first packet of each size only\n");
+    printf("        rewrite N cache lines of the payload\n");
+    printf("  -e    With -d, publish the dirty extents so the RPU only\n");
+    printf("        invalidates those (compare against a run without -e)\n");
+    printf("  -i F  Running next to mem_interference, tag the results with the\n");
+    printf("        bandwidth from its status file F\n");
+    printf("  -w M  RPU idle wait between packets: spin (poll loop) or ipi (WFI, woken\n");
+    printf("        by an IPI after every doorbell), adds rpu_polls/rpu_wakeups columns\n");
+    printf("        (ipi does not work with -b, the slot loop always spins)\n");
+    printf("  -q HZ Priority lane: send a %d-byte control message HZ times a second\n", HP_MSG_SIZE);
+    printf("        on its own cache line while the sweep keeps the bulk lane busy\n");
+    printf("        (writes <output>_hp.csv, use -b 2 to saturate the bulk lane)\n");
+    printf("  -I S  RPU payload invalidate: auto (from its startup calibration),\n");
+    printf("        range or full (whole cache) for every size\n");
+    printf("  -S    Stop the resident RPU firmware and exit, no run\n");
+    printf("  -k    Record OS events on the sender's CPU (pins us to it): /proc/interrupts\n");
+    printf("        deltas and tracefs sched/IRQ events, writes <output>_irq.csv and\n");
+    printf("        <output>_ftrace.txt (see analysis/attribute_outliers.py)\n");
+    printf("  -H    Map the shared window with 2 MB blocks (needs shmem_hugemap.ko,\n");
+    printf("        compare against a run without -H)\n");
+    printf("  -p    Sample PMU counters around every transfer on both APU and RPU\n");
+    printf("        (adds counter columns to the CSV)\n");
+    printf("  -t    Trace every packet on both APU and RPU\n");
+    printf("        (writes <output>_apu_trace.csv and <output>_rpu_trace.csv,\n");
+    printf("         convert with analysis/trace_to_perfetto.py)\n");
+    printf("  -h    Show this help\n");
+}
+
+/**
+ * Main
+ */
+int main(int argc, char *argv[])
+{
+    int iterations_per_size = 100;
+    const char *output_file = "performance_results.csv";
+    size_t max_packets;
+    int shutdown_only = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "b:d:i:m:q:s:w:I:eHkSpth")) != -1) {
+        switch (opt) {
+        case 'b':
+            num_slots = strtoul(optarg, NULL, 0);
+            if (num_slots < 1 || num_slots > MAX_SLOTS) {
+                fprintf(stderr, "APU: -b needs 1 to %d buffers\n", MAX_SLOTS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'd':
+            dirty_lines = strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            extents_enabled = 1;
+            break;
+        case 'i':
+            load_status_file = optarg;
+            break;
+        case 'm':
+            if (parse_attr_list(optarg) != 0) {
+                fprintf(stderr, "APU: -m needs \"all\" or a list from wb,wt,nc,device,so\n");
+                return EXIT_FAILURE;
+            }
+            num_sweeps = num_attrs;
+            break;
+        case 'q':
+            hp_rate_hz = strtoul(optarg, NULL, 0);
+            if (hp_rate_hz < 1 || hp_rate_hz > 100000) {
+                fprintf(stderr, "APU: -q needs 1 to 100000 messages per second\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            chunk_size = strtoul(optarg, NULL, 0);
+            if (chunk_size < MIN_CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE ||
+                (chunk_size & (chunk_size - 1)) != 0) {
+                fprintf(stderr, "APU: -s needs a power of two between %d and %d\n",
+                        MIN_CHUNK_SIZE, MAX_CHUNK_SIZE);
+                return EXIT_FAILURE;
+            }
+            while (((uint32_t)MIN_CHUNK_SIZE << chunk_shift) < chunk_size) {
+                chunk_shift++;
+            }
+            break;
+        case 'w':
+            for (wait_mode = 0; wait_mode < 2 && strcmp(optarg, wait_names[wait_mode]) != 0; wait_mode++);
+            if (wait_mode == 2) {
+                fprintf(stderr, "APU: -w needs spin or ipi\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'I':
+            for (inval_strategy = 0; inval_strategy < 3 && strcmp(optarg, inval_names[inval_strategy]) != 0; inval_strategy++);
+            if (inval_strategy == 3) {
+                fprintf(stderr, "APU: -I needs auto, range or full\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'H':
+            hugepages = 1;
+            break;
+        case 'k':
+            os_events = 1;
+            break;
+        case 'S':
+            shutdown_only = 1;
+            break;
+        case 'p':
+            pmu_enabled = 1;
+            break;
+        case 't':
+            trace_enabled = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    
+    if (optind < argc) {
+        iterations_per_size = atoi(argv[optind++]);
+    }
+    if (optind < argc) {
+        output_file = argv[optind++];
+    }
+    
+    if (shutdown_only) {
+        int ret;
+        
+        if (map_memory() < 0) {
+            return EXIT_FAILURE;
+        }
+        ret = shutdown_rpu();
+        unmap_memory();
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (extents_enabled && dirty_lines == 0) {
+        fprintf(stderr, "APU: -e needs -d N (number of dirty lines per update)\n");
+        return EXIT_FAILURE;
+    }
+    
+    if ((num_slots > 0 || chunk_size > 0) && dirty_lines > 0) {
+        fprintf(stderr, "APU: -d/-e only work in plain single-buffer mode (no -b/-s)\n");
+        return EXIT_FAILURE;
+    }
+    if (num_slots > 0 && chunk_size > 0) {
+        fprintf(stderr, "APU: -b and -s can't be combined\n");
+        return EXIT_FAILURE;
+    }
+    // The slot loop on the RPU spins on the slot headers, it never sleeps in WFI
+    if (num_slots > 0 && wait_mode == WAIT_IPI) {
+        fprintf(stderr, "APU: -b can't be combined with -w ipi\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (num_attrs > 0 && (num_slots > 0 || chunk_size > 0 || dirty_lines > 0)) {
+        fprintf(stderr, "APU: -m only works with the plain protocol (no -b/-s/-d)\n");
+        return EXIT_FAILURE;
+    }
+    max_packets = CALIB_PACKETS + NUM_SIZES * iterations_per_size * num_sweeps;
+    if (max_packets > MAX_RESULTS) {
+        fprintf(stderr, "APU: WARNING - %zu packets but the RPU keeps only %d results\n",
+                max_packets, MAX_RESULTS);
+    }
+    
+    packet_attr = calloc(max_packets, sizeof(*packet_attr));
+    start_ts = calloc(max_packets, sizeof(*start_ts));
+    if (os_events) {
+        start_mono = calloc(max_packets, sizeof(*start_mono));
+    }
+    if (!start_ts || !packet_attr || (os_events && !start_mono)) {
+        perror("Failed to allocate timestamp buffer");
+        return EXIT_FAILURE;
+    }
+    
+    if (trace_enabled) {
+        apu_trace = calloc(APU_TRACE_CAPACITY, sizeof(trace_entry_t));
+        if (!apu_trace) {
+            perror("Failed to allocate trace buffer");
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (pmu_enabled) {
+        apu_counters = calloc(max_packets, sizeof(*apu_counters));
+        if (!apu_counters) {
+            perror("Failed to allocate counter buffer");
+            return EXIT_FAILURE;
+        }
+        pmu_leader = open_pmu();
+    }
+    
+    if (map_memory() < 0) {
+        return EXIT_FAILURE;
+    }
+    
+    init_timer();
+    calibrate_timer();
+    
+    if (run_experiment(iterations_per_size, output_file) < 0) {
+        unmap_memory();
+        return EXIT_FAILURE;
+    }
+    
+    unmap_memory();
+    close_pmu();
+    
+    printf("\nTest completed successfully!\n");
+    printf("Results saved to: %s\n\n", output_file);
+    
+    return EXIT_SUCCESS;
+}
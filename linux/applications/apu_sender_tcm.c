@@ -7,10 +7,7 @@
 #include <sys/mman.h>
 #include <time.h>
 #include <errno.h>
-
-/* TCM Setup */
-#define TCM_BASE            0xFFE00000UL
-#define TCM_SIZE            0x10000UL     /* 64KB */
+#include "tcm_protocol.h"
 
 /* TTC0 Timer 0 Registers */
 #define TTC0_BASE           0xFF110000UL
@@ -36,28 +33,6 @@ static const uint32_t packet_sizes[] = {
 };
 #define NUM_SIZES (sizeof(packet_sizes) / sizeof(packet_sizes[0]))
 
-/* Shared Data Structure (matches RPU) */
-typedef struct {
-    volatile uint32_t command;
-    volatile uint32_t packet_size;    /* Size of data to process */
-    volatile uint32_t apu_timestamp;  /* When APU sent */
-    volatile uint32_t rpu_timestamp;  /* When RPU received */
-    volatile uint32_t status;
-    volatile uint32_t _pad[3];  // padding to get 32 bytes total
-    /* Data payload starts here */
-    volatile uint8_t data[4096];  /* Rest of TCM for data */
-} __attribute__((packed, aligned(16))) TCM_Protocol;  // 16-byte alignment
-
-/* Command codes */
-#define CMD_IDLE        0x00000000
-#define CMD_PROCESS     0x12345678
-#define CMD_SHUTDOWN    0xDEADBEEF
-
-/* Status codes */
-#define STATUS_READY    0xAAAAAAAA
-#define STATUS_BUSY     0xBBBBBBBB
-#define STATUS_DONE     0xCCCCCCCC
-
 /* Global pointers */
 static volatile TCM_Protocol *tcm_proto = NULL;
 static volatile uint32_t *timer_regs = NULL;
@@ -179,24 +154,6 @@ static int wait_for_rpu_ready(int timeout_sec)
     return -1;
 }
 
-/**
- * Wait for RPU done
- */
-static int wait_for_done(int timeout_us)
-{
-    int elapsed = 0;
-    
-    while (elapsed < timeout_us) {
-        if (tcm_proto->status == STATUS_DONE) {
-            return 0;
-        }
-        //usleep(1);
-        elapsed++;
-    }
-    
-    return -1;
-}
-
 /**
  * Send one packet
  */
@@ -205,7 +162,7 @@ static int send_packet(uint32_t size, uint8_t *payload, uint32_t *delta_ticks)
     uint32_t ts_start, ts_end;
     
     /* Make sure size fits in TCM */
-    if (size > 4096) {
+    if (size > TCM_PAYLOAD_MAX) {
         fprintf(stderr, "APU: Packet size %u too large for TCM\n", size);
         return -1;
     }
@@ -255,7 +212,8 @@ static int run_experiment(int iterations_per_size, const char *output_file)
 {
     FILE *fp;
     uint8_t *payload;
-    int size_idx, iter;
+    size_t size_idx;
+    int iter;
     int total_packets = 0;
     int failed_packets = 0;
     
@@ -0,0 +1,369 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+/*
+ * Memory-bandwidth interference generator
+ *
+ * Every sweep so far ran on an idle board, while in production the other
+ * A53 cores keep DDR busy. This runs next to apu_sender_ddr and loads
+ * memory from the chosen cores, one pinned worker each, with one of:
+ *
+ *   copy  - memcpy between two buffers, a read and a write stream
+ *   chase - dependent loads through a random cycle of cache lines,
+ *           latency bound and invisible to the prefetcher
+ *   write - store-only stream (memset)
+ *
+ * Each worker can be throttled to a target bandwidth. Once a second the
+ * cumulative traffic is written to a status file; apu_sender_ddr -i FILE
+ * reads it before and after its sweep and tags the results with the
+ * bandwidth measured in between.
+ */
+
+#define DEFAULT_STATUS_FILE "/tmp/mem_interference.status"
+#define DEFAULT_BUFFER_MB   32              /* Well past the 1 MB A53 L2 */
+#define CHUNK_SIZE          (64 * 1024)     /* Work between two throttle checks */
+#define CACHE_LINE_SIZE     64
+#define MAX_WORKERS         4
+#define MIN_SLEEP_NS        50000           /* Spin below this, nanosleep is too coarse */
+
+enum { KERNEL_COPY, KERNEL_CHASE, KERNEL_WRITE, NUM_KERNELS };
+
+static const char *kernel_names[NUM_KERNELS] = { "copy", "chase", "write" };
+
+typedef struct {
+    pthread_t thread;
+    int cpu;
+    uint8_t *src;
+    uint8_t *dst;
+    volatile uint64_t bytes;    /* DDR traffic so far, summed by the main thread */
+} worker_t;
+
+static worker_t workers[MAX_WORKERS];
+static int num_workers = 0;
+static int kernel = KERNEL_COPY;
+static size_t buffer_size = (size_t)DEFAULT_BUFFER_MB << 20;
+static double target_mbps = 0;  /* Per worker, 0 = as fast as it goes */
+static volatile sig_atomic_t stop = 0;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void handle_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * Link the buffer's cache lines into one random cycle (Sattolo)
+ *
+ * Each line holds the index of the next, so every load depends on the
+ * previous one and the order gives the prefetcher nothing to go on.
+ */
+static void build_chase(uint8_t *buf, size_t size, unsigned int seed)
+{
+    size_t lines = size / CACHE_LINE_SIZE;
+    uint32_t *order = malloc(lines * sizeof(*order));
+    
+    if (!order) {
+        perror("Failed to allocate chase order");
+        exit(EXIT_FAILURE);
+    }
+    
+    for (size_t i = 0; i < lines; i++) {
+        order[i] = i;
+    }
+    for (size_t i = lines - 1; i > 0; i--) {
+        size_t j = rand_r(&seed) % i;
+        uint32_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    
+    for (size_t i = 0; i < lines; i++) {
+        *(uint64_t *)(buf + (size_t)order[i] * CACHE_LINE_SIZE) =
+            order[(i + 1) % lines];
+    }
+    
+    free(order);
+}
+
+/**
+ * Stay on schedule for the target bandwidth
+ *
+ * Sleeps (or spins for short gaps) until the bytes moved so far are
+ * allowed, so the average holds even if single chunks are bursty.
+ */
+static void throttle(uint64_t start, uint64_t bytes)
+{
+    if (target_mbps <= 0) return;
+    
+    uint64_t due = start + (uint64_t)(bytes * 1000.0 / target_mbps);
+    uint64_t now = now_ns();
+    
+    if (now >= due) return;
+    
+    if (due - now > MIN_SLEEP_NS) {
+        struct timespec ts = { (due - now) / 1000000000ULL, (due - now) % 1000000000ULL };
+        nanosleep(&ts, NULL);
+    }
+    while (now_ns() < due);
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = (worker_t *)arg;
+    cpu_set_t set;
+    size_t off = 0;
+    uint64_t next = 0;
+    uint64_t start;
+    
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "LOAD: WARNING - can't pin to CPU %d: %s\n", w->cpu, strerror(errno));
+    }
+    
+    start = now_ns();
+    
+    while (!stop) {
+        switch (kernel) {
+        case KERNEL_COPY:
+            memcpy(w->dst + off, w->src + off, CHUNK_SIZE);
+            w->bytes += 2 * CHUNK_SIZE;
+            break;
+        case KERNEL_WRITE:
+            memset(w->dst + off, (int)(off >> 16), CHUNK_SIZE);
+            w->bytes += CHUNK_SIZE;
+            break;
+        case KERNEL_CHASE:
+            for (int i = 0; i < CHUNK_SIZE / CACHE_LINE_SIZE; i++) {
+                next = *(volatile uint64_t *)(w->src + next * CACHE_LINE_SIZE);
+            }
+            w->bytes += CHUNK_SIZE;
+            break;
+        }
+        
+        off += CHUNK_SIZE;
+        if (off + CHUNK_SIZE > buffer_size) {
+            off = 0;
+        }
+        
+        throttle(start, w->bytes);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Publish the totals, written to a temp file and renamed so readers
+ * never see half a file
+ */
+static void write_status(const char *path, const char *cores, uint64_t elapsed_ns,
+                         uint64_t bytes, double current_mbps, int running)
+{
+    char tmp[512];
+    FILE *fp;
+    
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if (!fp) {
+        perror("Failed to write status file");
+        return;
+    }
+    
+    fprintf(fp, "kernel=%s\n", kernel_names[kernel]);
+    fprintf(fp, "cores=%s\n", cores);
+    fprintf(fp, "target_mbps=%.1f\n", target_mbps * num_workers);
+    fprintf(fp, "buffer_mb=%zu\n", buffer_size >> 20);
+    fprintf(fp, "elapsed_ns=%llu\n", (unsigned long long)elapsed_ns);
+    fprintf(fp, "bytes=%llu\n", (unsigned long long)bytes);
+    fprintf(fp, "current_mbps=%.1f\n", current_mbps);
+    fprintf(fp, "running=%d\n", running);
+    fclose(fp);
+    
+    rename(tmp, path);
+}
+
+/**
+ * Parse "1,2,3" into worker CPUs
+ */
+static int parse_cores(const char *list)
+{
+    char *copy = strdup(list);
+    char *save = NULL;
+    
+    num_workers = 0;
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (num_workers == MAX_WORKERS) {
+            free(copy);
+            return -1;
+        }
+        workers[num_workers++].cpu = atoi(tok);
+    }
+    
+    free(copy);
+    return num_workers > 0 ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n", prog);
+    printf("  -k K     Kernel: copy, chase or write (default copy)\n");
+    printf("  -c LIST  CPUs to load, comma separated, up to %d (default 1,2,3,\n", MAX_WORKERS);
+    printf("           run the sender with taskset -c 0)\n");
+    printf("  -b MBPS  Target bandwidth in MB/s, split over the workers\n");
+    printf("           (default 0 = unthrottled)\n");
+    printf("  -m MB    Buffer per worker in MB (default %d)\n", DEFAULT_BUFFER_MB);
+    printf("  -t SEC   Stop after SEC seconds (default: run until SIGINT/SIGTERM)\n");
+    printf("  -s FILE  Status file (default %s)\n", DEFAULT_STATUS_FILE);
+    printf("  -h       Show this help\n");
+    printf("\nRun next to the sender and pass it the status file:\n");
+    printf("  %s -k copy -b 2000 &\n", prog);
+    printf("  taskset -c 0 ./apu_sender_ddr -i %s 100 loaded.csv\n", DEFAULT_STATUS_FILE);
+}
+
+/**
+ * Main
+ */
+int main(int argc, char *argv[])
+{
+    const char *status_file = DEFAULT_STATUS_FILE;
+    const char *cores = "1,2,3";
+    double total_mbps = 0;
+    int duration = 0;
+    uint64_t start, last_ns, last_bytes = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "k:c:b:m:t:s:h")) != -1) {
+        switch (opt) {
+        case 'k':
+            for (kernel = 0; kernel < NUM_KERNELS; kernel++) {
+                if (strcmp(optarg, kernel_names[kernel]) == 0) break;
+            }
+            if (kernel == NUM_KERNELS) {
+                fprintf(stderr, "LOAD: -k needs copy, chase or write\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            cores = optarg;
+            break;
+        case 'b':
+            total_mbps = atof(optarg);
+            break;
+        case 'm':
+            buffer_size = (size_t)strtoul(optarg, NULL, 0) << 20;
+            break;
+        case 't':
+            duration = atoi(optarg);
+            break;
+        case 's':
+            status_file = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    
+    if (parse_cores(cores) != 0) {
+        fprintf(stderr, "LOAD: -c needs 1 to %d CPUs\n", MAX_WORKERS);
+        return EXIT_FAILURE;
+    }
+    if (buffer_size < CHUNK_SIZE) {
+        fprintf(stderr, "LOAD: -m needs at least 1 MB\n");
+        return EXIT_FAILURE;
+    }
+    target_mbps = total_mbps / num_workers;
+    
+    printf("========================================\n");
+    printf("Memory Bandwidth Interference\n");
+    printf("========================================\n");
+    printf("Kernel:   %s\n", kernel_names[kernel]);
+    printf("CPUs:     %s\n", cores);
+    printf("Target:   %s\n", total_mbps > 0 ? "throttled" : "unthrottled");
+    if (total_mbps > 0) {
+        printf("          %.0f MB/s total\n", total_mbps);
+    }
+    printf("Buffer:   %zu MB per worker\n", buffer_size >> 20);
+    printf("Status:   %s\n", status_file);
+    printf("========================================\n\n");
+    
+    // Buffers are touched here so page faults don't count as load
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].src = aligned_alloc(CACHE_LINE_SIZE, buffer_size);
+        workers[i].dst = aligned_alloc(CACHE_LINE_SIZE, buffer_size);
+        if (!workers[i].src || !workers[i].dst) {
+            perror("Failed to allocate buffers");
+            return EXIT_FAILURE;
+        }
+        memset(workers[i].src, 0x5A, buffer_size);
+        memset(workers[i].dst, 0, buffer_size);
+        
+        if (kernel == KERNEL_CHASE) {
+            build_chase(workers[i].src, buffer_size, 1 + i);
+        }
+    }
+    
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    
+    start = now_ns();
+    last_ns = start;
+    for (int i = 0; i < num_workers; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    
+    while (!stop) {
+        uint64_t bytes = 0, now;
+        double current;
+        
+        sleep(1);
+        now = now_ns();
+        
+        for (int i = 0; i < num_workers; i++) {
+            bytes += workers[i].bytes;
+        }
+        
+        current = (bytes - last_bytes) * 1000.0 / (now - last_ns);
+        write_status(status_file, cores, now - start, bytes, current, 1);
+        printf("LOAD: %.0f MB/s\n", current);
+        fflush(stdout);
+        
+        last_ns = now;
+        last_bytes = bytes;
+        
+        if (duration > 0 && now - start >= (uint64_t)duration * 1000000000ULL) {
+            stop = 1;
+        }
+    }
+    
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    
+    last_bytes = 0;
+    for (int i = 0; i < num_workers; i++) {
+        last_bytes += workers[i].bytes;
+    }
+    write_status(status_file, cores, now_ns() - start, last_bytes, 0.0, 0);
+    
+    printf("\nLOAD: Average %.0f MB/s over %.1f s\n",
+           last_bytes * 1000.0 / (now_ns() - start), (now_ns() - start) / 1e9);
+    
+    return EXIT_SUCCESS;
+}
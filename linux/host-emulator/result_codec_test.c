@@ -0,0 +1,242 @@
+/*
+ * Round-trip test for result_codec.h
+ *
+ * Encodes a sweep shaped like a real run (steady send rate with jitter, a
+ * few outliers, the TTC0 counter wrapping mid-run) into a TCM-sized results
+ * area, decodes it and checks every sample. Then corrupts one block and
+ * checks that only that block's samples are lost, and that a full area
+ * refuses further samples instead of overwriting committed blocks.
+ *
+ * Build and run: make check
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "result_codec.h"
+
+#define AREA_SIZE           (56 * 1024)   /* TCM left after the protocol area */
+#define ITERATIONS          500
+#define MAX_SAMPLES         20000
+
+static const uint32_t sizes[] = { 1, 4, 16, 32, 64, 128, 256, 512, 1024 };
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+typedef struct {
+    uint32_t size;
+    uint32_t apu_ts;
+    uint32_t delta;
+} sample_t;
+
+typedef struct {
+    const sample_t *expected;   /* NULL = only collect */
+    sample_t got[MAX_SAMPLES];
+    uint32_t count;
+} decoded_t;
+
+static uint8_t area[AREA_SIZE];
+static sample_t sweep[MAX_SAMPLES];
+static decoded_t out;
+static int failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL: " __VA_ARGS__); \
+        printf("\n"); \
+        failures++; \
+    } \
+} while (0)
+
+static uint32_t lcg_state = 12345;
+
+static uint32_t lcg(void)
+{
+    lcg_state = lcg_state * 1103515245U + 12345U;
+    return lcg_state >> 16;
+}
+
+static void collect(void *ctx, uint32_t size, uint32_t apu_ts, uint32_t rpu_ts, uint32_t delta)
+{
+    decoded_t *d = ctx;
+
+    if (rpu_ts != apu_ts + delta) {
+        printf("FAIL: sample %u rpu_ts %u != apu_ts + delta\n", d->count, rpu_ts);
+        failures++;
+    }
+    if (d->count < MAX_SAMPLES) {
+        d->got[d->count].size = size;
+        d->got[d->count].apu_ts = apu_ts;
+        d->got[d->count].delta = delta;
+    }
+    d->count++;
+}
+
+/**
+ * Fill sweep[] with ITERATIONS packets per size, returns the sample count
+ *
+ * Starts just below the 32-bit wrap so the counter rolls over mid-run.
+ */
+static uint32_t make_sweep(void)
+{
+    uint32_t n = 0, ts = 0xFFFFFFFFU - 150000U;
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        for (int i = 0; i < ITERATIONS; i++, n++) {
+            uint32_t delta = 150 + sizes[s] / 8 + lcg() % 20;
+
+            if (lcg() % 100 == 0) {
+                delta += 5000 + lcg() % 50000;   /* Outlier */
+            }
+            ts += 10000 + lcg() % 64;            /* ~100 us gap */
+            sweep[n].size = sizes[s];
+            sweep[n].apu_ts = ts;
+            sweep[n].delta = delta;
+        }
+    }
+    return n;
+}
+
+static uint32_t encode(uint32_t n, uint32_t capacity, int *full_at)
+{
+    rc_encoder_t enc;
+    uint32_t bytes;
+
+    *full_at = -1;
+    memset(area, 0xEE, sizeof(area));
+    rc_encoder_init(&enc, area, capacity);
+    for (uint32_t i = 0; i < n; i++) {
+        if (rc_encode(&enc, sweep[i].size, sweep[i].apu_ts, sweep[i].delta) != 0) {
+            *full_at = (int)i;
+            break;
+        }
+    }
+    bytes = rc_encoder_finish(&enc);
+    CHECK(bytes <= capacity, "stream is %u bytes, area is %u", bytes, capacity);
+    return bytes;
+}
+
+static int same(const sample_t *a, const sample_t *b)
+{
+    return a->size == b->size && a->apu_ts == b->apu_ts && a->delta == b->delta;
+}
+
+/**
+ * Encode and decode the whole sweep, every sample must come back
+ */
+static void test_round_trip(uint32_t n)
+{
+    uint32_t bad, bytes;
+    int full_at, total;
+
+    bytes = encode(n, AREA_SIZE, &full_at);
+    CHECK(full_at < 0, "area full at sample %d of %u", full_at, n);
+
+    out.count = 0;
+    total = rc_decode(area, AREA_SIZE, collect, &out, &bad);
+    CHECK(total == (int)n, "decoded %d samples, encoded %u", total, n);
+    CHECK(bad == 0, "%u bad blocks in a clean stream", bad);
+    for (uint32_t i = 0; i < n && i < out.count; i++) {
+        if (!same(&out.got[i], &sweep[i])) {
+            CHECK(0, "sample %u: got {%u, %u, %u}, expected {%u, %u, %u}", i,
+                  out.got[i].size, out.got[i].apu_ts, out.got[i].delta,
+                  sweep[i].size, sweep[i].apu_ts, sweep[i].delta);
+            break;
+        }
+    }
+
+    printf("round trip: %u samples in %u bytes (%.2f bytes/sample, raw 20)\n",
+           n, bytes, (double)bytes / n);
+}
+
+/**
+ * Flip one byte in the second block's data, only that block may be lost
+ */
+static void test_corrupt_block(uint32_t n)
+{
+    uint8_t *block1, *block2;
+    uint32_t bad, lost, len1;
+    int full_at, total;
+
+    encode(n, AREA_SIZE, &full_at);
+    block1 = area + RC_STREAM_HEADER;
+    len1 = rc_get_u16(block1 + 4);
+    block2 = block1 + RC_BLOCK_HEADER + len1;
+    lost = rc_get_u16(block2 + 2);
+    block2[RC_BLOCK_HEADER + 3] ^= 0x40;
+
+    out.count = 0;
+    total = rc_decode(area, AREA_SIZE, collect, &out, &bad);
+    CHECK(bad == 1, "%u bad blocks after corrupting one", bad);
+    CHECK(total == (int)(n - lost), "decoded %d samples, expected %u", total, n - lost);
+
+    // Block 1 comes through as is, then decoding picks up after block 2
+    uint32_t first = rc_get_u16(block1 + 2);
+    for (uint32_t i = 0; i < out.count; i++) {
+        uint32_t src = i < first ? i : i + lost;
+
+        if (!same(&out.got[i], &sweep[src])) {
+            CHECK(0, "sample %u after the bad block doesn't match sample %u", i, src);
+            break;
+        }
+    }
+
+    // A bad block header (lost framing) ends decoding, also counted as bad
+    encode(n, AREA_SIZE, &full_at);
+    block2[0] ^= 0xFF;
+    out.count = 0;
+    total = rc_decode(area, AREA_SIZE, collect, &out, &bad);
+    CHECK(bad == 1 && total == (int)first, "bad block magic: %d samples, %u bad blocks",
+          total, bad);
+
+    printf("corrupt block: %u samples rejected, %u kept\n", lost, n - lost);
+}
+
+/**
+ * A small area fills up: rc_encode() says so and what was committed decodes
+ */
+static void test_full_area(uint32_t n)
+{
+    uint32_t bad;
+    int full_at, total;
+
+    encode(n, 1024, &full_at);
+    CHECK(full_at > 0, "1 KB area never reported full");
+
+    out.count = 0;
+    total = rc_decode(area, 1024, collect, &out, &bad);
+    CHECK(bad == 0, "%u bad blocks in a full area", bad);
+    CHECK(total > 0 && total <= full_at, "full area decoded %d samples, full at %d",
+          total, full_at);
+
+    printf("full area: 1 KB holds %d samples\n", total);
+}
+
+/**
+ * Raw results start with the sample count, never the stream magic
+ */
+static void test_raw_detection(void)
+{
+    uint32_t bad;
+
+    memset(area, 0, sizeof(area));
+    rc_put_u32(area, 1000);
+    CHECK(rc_decode(area, AREA_SIZE, collect, &out, &bad) == -1,
+          "raw results taken for a compact stream");
+}
+
+int main(void)
+{
+    uint32_t n = make_sweep();
+
+    test_round_trip(n);
+    test_corrupt_block(n);
+    test_full_area(n);
+    test_raw_detection();
+
+    if (failures) {
+        printf("result_codec: %d checks FAILED\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("result_codec: all checks passed\n");
+    return EXIT_SUCCESS;
+}
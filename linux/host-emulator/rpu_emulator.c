@@ -0,0 +1,381 @@
+/*
+ * Host-side RPU emulator
+ *
+ * Runs the unmodified RPU receiver firmware as a normal Linux process so the
+ * protocol can be exercised and profiled without the KR260.
+ *
+ * How it works:
+ * - The "physical address space" is a sparse POSIX shm file (/dev/shm/rpu_emulator)
+ *   where file offset == physical address.
+ * - We map the windows the firmware uses (shared DDR, TTC0, TCM) at their real
+ *   physical addresses, so the firmware's hardcoded pointers just work.
+ * - The APU sender built with -DHOST_BACKEND mmaps the same file instead of
+ *   /dev/mem, using the same offsets. No other change on the APU side.
+ * - A ticker thread keeps TTC0's counter register updated at 100 MHz from
+ *   CLOCK_MONOTONIC, so both sides share one timebase like on the board.
+ * - Cache maintenance calls are hooks: counted, timed and optionally slowed
+ *   down by a fixed cost per call / per cache line.
+ * - WFI waits for the APU's write to the IPI trigger register.
+ *
+ * The firmware is compiled with -Dmain=rpu_firmware_main against shim/.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "xil_cache.h"
+#include "xpseudo_asm.h"
+#include "xil_mpu.h"
+
+/* Emulated physical memory (file offset == physical address) */
+#define EMU_SHM_NAME        "/rpu_emulator"
+#define EMU_PHYS_SIZE       0x100000000ULL  /* 4 GB, sparse */
+
+/* TTC0 Timer 0 Registers (must match the firmware) */
+#define TTC0_BASE           0xFF110000UL
+#define TTC0_CNT_CTRL       0x0C
+#define TTC0_CNT_VAL        0x18
+
+/* IPI channel 0 (APU) trigger register and the RPU0 bit in it */
+#define IPI_BASE            0xFF300000UL
+#define IPI_APU_TRIG        (IPI_BASE + 0x00)
+#define IPI_RPU0_MASK       0x00000100UL
+#define WFI_MAX_US          100000  /* WFI may wake spuriously, never sleep forever */
+#define TTC_NS_PER_TICK     10              /* 100 MHz */
+
+/* R5 D-cache line */
+#define RPU_CACHE_LINE      32
+
+/* First MPU region the BSP leaves free */
+#define FIRST_FREE_MPU_REGION   10
+
+/* R5 core clock, only used to fake the PMU cycle counter */
+#define RPU_CLOCK_MHZ       500
+
+/* Physical windows the firmware touches, mapped at their real addresses */
+struct phys_window {
+    const char *name;
+    uintptr_t base;
+    size_t size;
+};
+
+static const struct phys_window windows[] = {
+    { "DDR shared", 0x3E000000UL, 0x00800000UL },
+    { "TTC0",       TTC0_BASE,    0x00001000UL },
+    { "TCM",        0xFFE00000UL, 0x00010000UL },
+    { "IPI",        IPI_BASE,     0x00020000UL },
+    { "GIC",        0xF9000000UL, 0x00002000UL },
+};
+#define NUM_WINDOWS (sizeof(windows) / sizeof(windows[0]))
+
+/* Cache hook statistics */
+struct cache_stats {
+    uint64_t calls;
+    uint64_t lines;
+    uint64_t ns;
+};
+
+enum { OP_INVALIDATE, OP_FLUSH, OP_INVALIDATE_ALL, OP_FLUSH_ALL, NUM_OPS };
+
+static const char *op_names[NUM_OPS] = {
+    "InvalidateRange", "FlushRange", "Invalidate (all)", "Flush (all)"
+};
+
+static struct cache_stats stats[NUM_OPS];
+
+/* Simulated cost of cache maintenance, 0 = free */
+static uint64_t cost_per_op_ns = 0;
+static uint64_t cost_per_line_ns = 0;
+
+static volatile int stop_ticker = 0;
+
+/* Entry point of the firmware, renamed at compile time */
+int rpu_firmware_main(void);
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Busy wait, we want to model CPU time, not sleep time
+ */
+static void burn_ns(uint64_t ns)
+{
+    if (ns == 0) return;
+
+    uint64_t end = now_ns() + ns;
+    while (now_ns() < end);
+}
+
+/**
+ * Common path for all the cache hooks
+ */
+static void cache_op(int op, uint64_t lines)
+{
+    uint64_t start = now_ns();
+
+    burn_ns(cost_per_op_ns + lines * cost_per_line_ns);
+
+    stats[op].calls++;
+    stats[op].lines += lines;
+    stats[op].ns += now_ns() - start;
+}
+
+static uint64_t range_lines(INTPTR adr, u32 len)
+{
+    if (len == 0) return 0;
+
+    uintptr_t first = (uintptr_t)adr & ~(uintptr_t)(RPU_CACHE_LINE - 1);
+    uintptr_t last = ((uintptr_t)adr + len - 1) & ~(uintptr_t)(RPU_CACHE_LINE - 1);
+    return (last - first) / RPU_CACHE_LINE + 1;
+}
+
+/* Cache maintenance hooks (xil_cache.h) */
+void Xil_DCacheEnable(void) {}
+void Xil_DCacheDisable(void) {}
+
+void Xil_DCacheInvalidate(void)
+{
+    cache_op(OP_INVALIDATE_ALL, 32768 / RPU_CACHE_LINE);
+}
+
+void Xil_DCacheFlush(void)
+{
+    cache_op(OP_FLUSH_ALL, 32768 / RPU_CACHE_LINE);
+}
+
+void Xil_DCacheInvalidateRange(INTPTR adr, u32 len)
+{
+    cache_op(OP_INVALIDATE, range_lines(adr, len));
+}
+
+void Xil_DCacheFlushRange(INTPTR adr, u32 len)
+{
+    cache_op(OP_FLUSH, range_lines(adr, len));
+}
+
+/*
+ * CP15 hooks (xpseudo_asm.h)
+ *
+ * There's no R5 PMU on the host. The cycle counter is derived from the
+ * wall clock so cycle deltas stay meaningful, event counters read as 0.
+ */
+u32 emu_mfcp(const char *reg)
+{
+    if (strcmp(reg, XREG_CP15_PERF_CYCLE_COUNTER) == 0) {
+        return (u32)(now_ns() * RPU_CLOCK_MHZ / 1000);
+    }
+    return 0;
+}
+
+void emu_mtcp(const char *reg, u32 value)
+{
+    (void)reg;
+    (void)value;
+}
+
+/*
+ * WFI hook (xpseudo_asm.h)
+ *
+ * There's no GIC behind the IPI window, so we wake on the APU's write to
+ * its trigger register directly. The write stays latched until a WFI
+ * consumes it, like a pending interrupt would.
+ */
+void emu_wfi(void)
+{
+    volatile uint32_t *trig = (volatile uint32_t *)IPI_APU_TRIG;
+
+    for (int us = 0; us < WFI_MAX_US; us += 10) {
+        if (__atomic_exchange_n(trig, 0, __ATOMIC_SEQ_CST) & IPI_RPU0_MASK) {
+            return;
+        }
+        usleep(10);
+    }
+}
+
+/*
+ * MPU hooks (xil_mpu.h)
+ *
+ * Host memory is always cacheable and coherent, so attribute changes
+ * can't change timing here. Log them so a run can be checked.
+ */
+u32 Xil_GetNextMPURegion(void)
+{
+    return FIRST_FREE_MPU_REGION;
+}
+
+u16 Xil_SetMPURegionByRegNum(u32 reg_num, INTPTR addr, u64 size, u32 attrib)
+{
+    printf("EMU: MPU region %u = 0x%08lX, %llu KB, attributes 0x%03X\n", reg_num,
+           (unsigned long)addr, (unsigned long long)(size / 1024), attrib);
+    fflush(stdout);
+    return 0;
+}
+
+/**
+ * Keep TTC0's counter register moving at 100 MHz
+ *
+ * Spins on its own core. Honours the "counter disabled" bit in CNT_CTRL
+ * so init_timer() on either side behaves like on the board.
+ */
+static void *ttc_ticker(void *arg)
+{
+    volatile uint32_t *cnt_ctrl = (volatile uint32_t *)(TTC0_BASE + TTC0_CNT_CTRL);
+    volatile uint32_t *cnt_val = (volatile uint32_t *)(TTC0_BASE + TTC0_CNT_VAL);
+
+    (void)arg;
+
+    while (!stop_ticker) {
+        if (!(*cnt_ctrl & 0x01)) {
+            *cnt_val = (uint32_t)(now_ns() / TTC_NS_PER_TICK);
+        }
+    }
+
+    return NULL;
+}
+
+static void *firmware_thread(void *arg)
+{
+    (void)arg;
+    rpu_firmware_main();
+    return NULL;
+}
+
+/**
+ * Create the emulated physical memory and map our windows at their real addresses
+ */
+static int map_phys_windows(void)
+{
+    int fd = shm_open(EMU_SHM_NAME, O_CREAT | O_RDWR, 0666);
+    if (fd < 0) {
+        perror("EMU: shm_open");
+        return -1;
+    }
+
+    if (ftruncate(fd, EMU_PHYS_SIZE) < 0) {
+        perror("EMU: ftruncate");
+        close(fd);
+        return -1;
+    }
+
+    for (size_t i = 0; i < NUM_WINDOWS; i++) {
+        void *addr = mmap((void *)windows[i].base, windows[i].size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_FIXED_NOREPLACE,
+                          fd, windows[i].base);
+        if (addr == MAP_FAILED || addr != (void *)windows[i].base) {
+            fprintf(stderr, "EMU: Cannot map %s at 0x%08lX: %s\n",
+                    windows[i].name, (unsigned long)windows[i].base, strerror(errno));
+            close(fd);
+            return -1;
+        }
+
+        // Lets an APU side using -H share 2 MB pages (with shmem THP set to advise)
+        madvise(addr, windows[i].size, MADV_HUGEPAGE);
+
+        // Fresh "power-on" state
+        memset(addr, 0, windows[i].size);
+
+        printf("EMU: %-10s mapped at 0x%08lX (%zu KB)\n",
+               windows[i].name, (unsigned long)windows[i].base, windows[i].size / 1024);
+    }
+
+    // TTC0 comes out of reset with the counter disabled
+    *(volatile uint32_t *)(TTC0_BASE + TTC0_CNT_CTRL) = 0x01;
+
+    close(fd);
+    return 0;
+}
+
+static void print_stats(void)
+{
+    printf("\n========================================\n");
+    printf("EMU: Cache maintenance hook statistics\n");
+    printf("========================================\n");
+    printf("%-18s %10s %12s %12s %10s\n", "Operation", "Calls", "Lines", "Time (us)", "ns/call");
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        double per_call = stats[op].calls ? (double)stats[op].ns / stats[op].calls : 0.0;
+        printf("%-18s %10llu %12llu %12.1f %10.1f\n", op_names[op],
+               (unsigned long long)stats[op].calls,
+               (unsigned long long)stats[op].lines,
+               stats[op].ns / 1000.0, per_call);
+    }
+    printf("========================================\n");
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-o ns_per_op] [-l ns_per_line]\n", prog);
+    printf("  -o NS   Simulated cost of every cache maintenance call (default 0)\n");
+    printf("  -l NS   Simulated cost per %d-byte cache line (default 0)\n", RPU_CACHE_LINE);
+    printf("\nRuns until SIGINT/SIGTERM, then prints cache hook statistics.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t ticker, fw;
+    sigset_t sigs, alrm;
+    int opt, sig;
+
+    while ((opt = getopt(argc, argv, "o:l:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            cost_per_op_ns = strtoull(optarg, NULL, 0);
+            break;
+        case 'l':
+            cost_per_line_ns = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    printf("EMU: Host-side RPU emulator\n");
+    printf("EMU: Cache cost model: %llu ns/op + %llu ns/line\n",
+           (unsigned long long)cost_per_op_ns, (unsigned long long)cost_per_line_ns);
+
+    if (map_phys_windows() < 0) {
+        shm_unlink(EMU_SHM_NAME);
+        return EXIT_FAILURE;
+    }
+
+    // Only the main thread handles signals, so we can print stats cleanly
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGINT);
+    sigaddset(&sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+    // The FreeRTOS POSIX port ticks with SIGALRM, it must land in the firmware's threads
+    sigemptyset(&alrm);
+    sigaddset(&alrm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alrm, NULL);
+    pthread_create(&ticker, NULL, ttc_ticker, NULL);
+
+    pthread_sigmask(SIG_UNBLOCK, &alrm, NULL);
+    pthread_create(&fw, NULL, firmware_thread, NULL);
+    pthread_sigmask(SIG_BLOCK, &alrm, NULL);
+
+    // The firmware never returns (it hangs like on the R5), so wait to be stopped
+    sigwait(&sigs, &sig);
+
+    stop_ticker = 1;
+    pthread_join(ticker, NULL);
+
+    print_stats();
+
+    shm_unlink(EMU_SHM_NAME);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+/*
+ * Host shim for the R5 cache maintenance API.
+ *
+ * Host memory is coherent, so these don't have to do anything for
+ * correctness. The emulator implements them as hooks that count every
+ * operation and can optionally burn a configurable amount of time per
+ * call / per cache line (see rpu_emulator.c).
+ */
+#ifndef XIL_CACHE_H
+#define XIL_CACHE_H
+
+#include "xil_types.h"
+
+void Xil_DCacheEnable(void);
+void Xil_DCacheDisable(void);
+void Xil_DCacheInvalidate(void);
+void Xil_DCacheFlush(void);
+void Xil_DCacheInvalidateRange(INTPTR adr, u32 len);
+void Xil_DCacheFlushRange(INTPTR adr, u32 len);
+
+#endif /* XIL_CACHE_H */
@@ -0,0 +1,23 @@
+/*
+ * Host shim for register access.
+ *
+ * The emulator maps the peripheral windows (TTC0 etc.) at their physical
+ * addresses, so a register access is just a volatile load/store like on
+ * the real R5.
+ */
+#ifndef XIL_IO_H
+#define XIL_IO_H
+
+#include "xil_types.h"
+
+static inline u32 Xil_In32(UINTPTR addr)
+{
+    return *(volatile u32 *)addr;
+}
+
+static inline void Xil_Out32(UINTPTR addr, u32 value)
+{
+    *(volatile u32 *)addr = value;
+}
+
+#endif /* XIL_IO_H */
@@ -0,0 +1,16 @@
+/*
+ * Host shim for the R5 MPU API.
+ *
+ * There's no MPU on the host, the emulator just records which attributes
+ * the firmware asked for so they show up in its log.
+ */
+#ifndef XIL_MPU_H
+#define XIL_MPU_H
+
+#include "xil_types.h"
+#include "xreg_cortexr5.h"
+
+u32 Xil_GetNextMPURegion(void);
+u16 Xil_SetMPURegionByRegNum(u32 reg_num, INTPTR addr, u64 size, u32 attrib);
+
+#endif /* XIL_MPU_H */
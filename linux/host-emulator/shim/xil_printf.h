@@ -0,0 +1,12 @@
+/*
+ * Host shim for xil_printf, the console is just stdout here.
+ */
+#ifndef XIL_PRINTF_H
+#define XIL_PRINTF_H
+
+#include <stdio.h>
+#include "xil_types.h"
+
+#define xil_printf(...) do { printf(__VA_ARGS__); fflush(stdout); } while (0)
+
+#endif /* XIL_PRINTF_H */
@@ -0,0 +1,26 @@
+/*
+ * Host shim for the barrier and coprocessor macros from xpseudo_asm_gcc.h.
+ */
+#ifndef XPSEUDO_ASM_H
+#define XPSEUDO_ASM_H
+
+#include "xil_types.h"
+#include "xreg_cortexr5.h"
+
+#define dsb()   __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define dmb()   __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define isb()   __atomic_signal_fence(__ATOMIC_SEQ_CST)
+
+/* CP15 accesses go to the emulator (see rpu_emulator.c) */
+u32 emu_mfcp(const char *reg);
+void emu_mtcp(const char *reg, u32 value);
+
+#define mfcp(rn)        emu_mfcp(rn)
+#define mtcp(rn, v)     emu_mtcp((rn), (v))
+
+/* WFI returns once the APU rings the IPI (see rpu_emulator.c) */
+void emu_wfi(void);
+
+#define wfi()           emu_wfi()
+
+#endif /* XPSEUDO_ASM_H */
@@ -0,0 +1,28 @@
+/*
+ * Host shim for the Cortex-R5 CP15 register names.
+ *
+ * On the R5 these are the operand strings for mrc/mcr. Here they're just
+ * names that the emulator's mfcp/mtcp hooks can compare against.
+ */
+#ifndef XREG_CORTEXR5_H
+#define XREG_CORTEXR5_H
+
+#define XREG_CP15_PERF_MONITOR_CTRL     "p15, 0, %0,  c9, c12, 0"
+#define XREG_CP15_COUNT_ENABLE_SET      "p15, 0, %0,  c9, c12, 1"
+#define XREG_CP15_COUNT_ENABLE_CLR      "p15, 0, %0,  c9, c12, 2"
+#define XREG_CP15_EVENT_CNTR_SEL        "p15, 0, %0,  c9, c12, 5"
+#define XREG_CP15_PERF_CYCLE_COUNTER    "p15, 0, %0,  c9, c13, 0"
+#define XREG_CP15_EVENT_TYPE_SEL        "p15, 0, %0,  c9, c13, 1"
+#define XREG_CP15_PERF_MONITOR_COUNT    "p15, 0, %0,  c9, c13, 2"
+
+/* MPU region attributes, same values as the BSP */
+#define STRONG_ORDERD_SHARED            0x00000000U
+#define DEVICE_SHARED                   0x00000001U
+#define DEVICE_NONSHARED                0x00000010U
+#define NORM_NSHARED_WT_NWA             0x00000002U
+#define NORM_NSHARED_WB_NWA             0x00000003U
+#define NORM_NSHARED_NCACHE             0x00000008U
+#define NORM_NSHARED_WB_WA              0x0000000BU
+#define PRIV_RW_USER_RW                 (0x00000003U << 8U)
+
+#endif /* XREG_CORTEXR5_H */
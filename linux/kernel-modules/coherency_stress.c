@@ -3,11 +3,22 @@
 #include <linux/init.h>
 #include <linux/mm.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/delay.h>
+#include <linux/io.h>
+#include <linux/ioport.h>
+#include <linux/mutex.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/preempt.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
 #include <asm/pgtable.h>
 #include <asm/io.h>
+#include <asm/arch_timer.h>
+#include "ddr_layout.h"
 
 #define MODULE_NAME "coherency_test"
 #define TEST_SIZE PAGE_SIZE
@@ -26,6 +37,135 @@ static struct proc_dir_entry *proc_entry;
 #define PATTERN_OLD 0x0F0F0F0F  // "Old" value sitting in DDR
 #define PATTERN_NEW 0xF0F0F0F0  // "New" value we keep in cache only
 
+/*
+ * Timed mode: how long stale data stays visible
+ *
+ * Write "COUNT MEM MAINT GAP_US" to /proc/coherency_stale, e.g.
+ * "1000 wb clean 100". We store COUNT sequence values into one line of the
+ * shared window, GAP_US apart, and note the TTC0 time of each store.
+ * rpu_coherency_test_mod notes the TTC0 time it first reads each value, so
+ * the difference is how long the RPU kept seeing the previous one.
+ *   MEM:   wb (cacheable), nc (normal non-cacheable), dev (device)
+ *   MAINT: none, clean (DC CVAC), civac (DC CIVAC), each followed by DSB
+ * Reading /proc/coherency_stale gives the last run as CSV.
+ *
+ * The window is ordinary System RAM in the stock device tree, and arm64
+ * refuses both ioremap() and a write-combine memremap() of RAM. Timed
+ * mode therefore needs the window reserved no-map (rpu_window in the
+ * device tree, see the README). Control and results pages are then
+ * ioremap_wc()ed, "wb" is memremap()ed cacheable, "nc" ioremap_wc()ed and
+ * "dev" ioremap()ed.
+ */
+#define STALE_NAME              "coherency_stale"
+#define STALE_PHYS              (SHARED_MEM_BASE + STALE_OFFSET)
+#define STALE_CTRL_OFFSET       0x0000        /* magic, count, observed */
+#define STALE_DATA_OFFSET       0x1000        /* seq, on its own page so only it gets remapped */
+#define STALE_RESULTS_OFFSET    0x2000        /* {seq, rpu_ts} per value the RPU saw */
+#define STALE_MAX_COUNT         4096
+#define STALE_MAGIC_RUN         0x57A1E001UL  /* ctrl[1] = count */
+#define STALE_MAGIC_READY       0x57A1E002UL  /* RPU has the baseline value */
+#define STALE_MAGIC_STOP        0x57A1E003UL  /* No more values coming */
+#define STALE_MAGIC_DONE        0x57A1E004UL  /* ctrl[2] = values observed */
+#define STALE_TIMEOUT_MS        2000
+#define STALE_SETTLE_MS         100           /* Time the last value gets to show up */
+
+CHAN_ASSERT_BEFORE(STALE_RESULTS_OFFSET, STALE_MAX_COUNT * 8, STALE_SIZE);
+
+#define TTC0_BASE               0xFF110000UL
+#define TTC0_CNT_VAL            0x18
+#define TIMER_NS_PER_TICK       10            /* TTC0 runs at 100 MHz */
+
+enum { STALE_MEM_WB, STALE_MEM_NC, STALE_MEM_DEV };
+enum { STALE_MAINT_NONE, STALE_MAINT_CLEAN, STALE_MAINT_CIVAC };
+
+static const char * const stale_mem_names[] = { "wb", "nc", "dev" };
+static const char * const stale_maint_names[] = { "none", "clean", "civac" };
+
+struct stale_run {
+    u32 count;
+    u32 gap_us;
+    int mem;
+    int maint;
+    u32 observed;
+    u32 apu_ts[STALE_MAX_COUNT];
+    u32 rpu_ts[STALE_MAX_COUNT];
+    u8 seen[STALE_MAX_COUNT];
+    u32 delay[STALE_MAX_COUNT];   /* Sorted delays in ticks of the values seen */
+};
+
+static struct proc_dir_entry *stale_entry;
+static void __iomem *ttc0;
+static void __iomem *stale_ctrl;
+static void __iomem *stale_results;
+static struct stale_run *last_run;
+static DEFINE_MUTEX(stale_lock);
+
+/*
+ * Kernel sender: the apu_sender_ddr packet sweep, run from kernel context
+ *
+ * Write "ITERATIONS [preempt|irqoff]" to /proc/coherency_sender while
+ * rpu_receiver_ddr sits at MAGIC_READY. Each packet (payload copy,
+ * metadata, MAGIC_START, spin until MAGIC_ACK) runs with preemption off,
+ * and with "irqoff" with local IRQs off as well. Like timed mode it needs
+ * the window reserved no-map, and ioremap_wc()s it: Normal-NC, the same
+ * memory type /dev/mem O_SYNC gives the userspace sender on the stock
+ * device tree. Compared to that only the OS is gone: no page faults, no
+ * scheduling, no usleep() between ACK polls. That makes it the floor for
+ * the userspace numbers.
+ *
+ * Control words carry TTC0 time as usual, so the RPU's delta means the
+ * same thing. Our own timing (copy, copy start to ACK) uses the arch
+ * counter, a system register read instead of an uncached load across the
+ * interconnect. Reading /proc/coherency_sender gives the last run in the
+ * userspace CSV format plus copy_ns and roundtrip_ns.
+ */
+#define SENDER_NAME             "coherency_sender"
+#define FLAG_SEQ_SHIFT          8
+#define PAYLOAD_OFFSET          CONTROL_SIZE  /* After magic, size, timestamp, flags */
+#define INVAL_STRAT_AUTO        0
+#define RESULT_VALID            0xA5A5A5A5UL
+#define SENDER_MAX_PAYLOAD      PAYLOAD_MAX
+#define SENDER_NUM_SIZES        ARRAY_SIZE(sender_sizes)
+#define SENDER_MAX_ITERATIONS   (MAX_RESULTS / SENDER_NUM_SIZES)
+#define SENDER_READY_MS         2000
+#define SENDER_RESULTS_MS       1000
+#define SENDER_ACK_TIMEOUT_US   10000         /* Same as the userspace sender */
+#define SENDER_GAP_US           100           /* Between packets, as in userspace */
+
+/* Same sweep as apu_sender_ddr */
+static const u32 sender_sizes[] = {
+    1, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+
+enum { SENDER_PREEMPT_OFF, SENDER_IRQ_OFF };
+static const char * const sender_mode_names[] = { "preempt", "irqoff" };
+
+/* What we know about one packet, joined with the RPU's result afterwards */
+struct sender_packet {
+    u32 size;
+    u32 start_ttc;      /* TTC0 at copy start */
+    u32 copy_ns;        /* Payload copy, arch counter */
+    u32 roundtrip_ns;   /* Copy start to MAGIC_ACK seen, arch counter */
+};
+
+struct sender_run {
+    u32 iterations;
+    int mode;
+    u32 cntfrq;
+    u32 packets;
+    u32 failed;
+    u64 sweep_ns;
+    struct sender_packet pkt[MAX_RESULTS];
+    /* RPU results, copied out of the window once it's back at READY */
+    u32 count;
+    u32 rpu[MAX_RESULTS][5];    /* size, apu_ts, rpu_ts, delta_ticks, valid */
+    u32 first_byte[MAX_RESULTS][2];
+};
+
+static struct proc_dir_entry *sender_entry;
+static struct sender_run *sender_last;
+static DEFINE_MUTEX(sender_lock);
+
 /*
  * Proc file read handler, shows physical address and current buffer state
  */
@@ -69,6 +209,638 @@ static const struct proc_ops coherency_proc_fops = {
     .proc_release = single_release,
 };
 
+/*
+ * Map the sequence line with the memory type under test
+ */
+static void __iomem *stale_map_data(int mem)
+{
+    phys_addr_t phys = STALE_PHYS + STALE_DATA_OFFSET;
+    
+    switch (mem) {
+    case STALE_MEM_WB:
+        return (void __force __iomem *)memremap(phys, PAGE_SIZE, MEMREMAP_WB);
+    case STALE_MEM_NC:
+        return ioremap_wc(phys, PAGE_SIZE);
+    default:
+        return ioremap(phys, PAGE_SIZE);
+    }
+}
+
+static void stale_unmap_data(void __iomem *data, int mem)
+{
+    if (mem == STALE_MEM_WB) {
+        memunmap((void __force *)data);
+    } else {
+        iounmap(data);
+    }
+}
+
+/*
+ * Whether the kernel maps this range as RAM, in which case ioremap() refuses it
+ */
+static bool window_is_ram(phys_addr_t phys, size_t size)
+{
+    return region_intersects(phys, size, IORESOURCE_SYSTEM_RAM,
+                             IORES_DESC_NONE) != REGION_DISJOINT;
+}
+
+static void stale_maintain(void __iomem *data, int maint)
+{
+    if (maint == STALE_MAINT_CLEAN) {
+        __asm__ __volatile__ ("dc cvac, %0" :: "r" (data) : "memory");
+    } else if (maint == STALE_MAINT_CIVAC) {
+        __asm__ __volatile__ ("dc civac, %0" :: "r" (data) : "memory");
+    }
+    __asm__ __volatile__ ("dsb sy" ::: "memory");
+}
+
+/*
+ * Sleep-poll a control word until it holds magic
+ */
+static int wait_ctrl(void __iomem *ctrl, u32 magic, unsigned int timeout_ms)
+{
+    unsigned long deadline = jiffies + msecs_to_jiffies(timeout_ms);
+    
+    while (readl(ctrl) != magic) {
+        if (time_after(jiffies, deadline)) {
+            return -ETIMEDOUT;
+        }
+        usleep_range(100, 200);
+    }
+    return 0;
+}
+
+static int stale_cmp(const void *a, const void *b)
+{
+    u32 x = *(const u32 *)a;
+    u32 y = *(const u32 *)b;
+    
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * One timed run, the RPU side has to be sitting in its stale-window loop
+ */
+static int stale_do_run(struct stale_run *run)
+{
+    void __iomem *data;
+    unsigned long flags;
+    u32 seq, i, n;
+    int ret;
+    
+    data = stale_map_data(run->mem);
+    if (!data) {
+        return -ENOMEM;
+    }
+    
+    // Known starting value, pushed all the way out whatever the mapping
+    writel_relaxed(0, data);
+    stale_maintain(data, STALE_MAINT_CIVAC);
+    
+    writel(run->count, stale_ctrl + 4);
+    writel(0, stale_ctrl + 8);
+    writel(STALE_MAGIC_RUN, stale_ctrl);
+    
+    ret = wait_ctrl(stale_ctrl, STALE_MAGIC_READY, STALE_TIMEOUT_MS);
+    if (ret) {
+        pr_err("%s: RPU never answered, is rpu_coherency_test_mod running?\n", STALE_NAME);
+        goto out;
+    }
+    
+    for (seq = 1; seq <= run->count; seq++) {
+        // Timestamp and store back to back, nothing in between
+        local_irq_save(flags);
+        run->apu_ts[seq - 1] = readl_relaxed(ttc0 + TTC0_CNT_VAL);
+        writel_relaxed(seq, data);
+        stale_maintain(data, run->maint);
+        local_irq_restore(flags);
+        
+        if (run->gap_us) {
+            usleep_range(run->gap_us, run->gap_us + run->gap_us / 10 + 1);
+        } else {
+            cond_resched();
+        }
+    }
+    
+    msleep(STALE_SETTLE_MS);
+    writel(STALE_MAGIC_STOP, stale_ctrl);
+    
+    ret = wait_ctrl(stale_ctrl, STALE_MAGIC_DONE, STALE_TIMEOUT_MS);
+    if (ret) {
+        pr_err("%s: RPU didn't finish the run\n", STALE_NAME);
+        goto out;
+    }
+    
+    // First sighting of each value, the RPU only logs changes
+    n = min_t(u32, readl(stale_ctrl + 8), STALE_MAX_COUNT);
+    for (i = 0; i < n; i++) {
+        seq = readl(stale_results + i * 8);
+        if (seq >= 1 && seq <= run->count && !run->seen[seq - 1]) {
+            run->seen[seq - 1] = 1;
+            run->rpu_ts[seq - 1] = readl(stale_results + i * 8 + 4);
+        }
+    }
+    
+    for (i = 0; i < run->count; i++) {
+        if (run->seen[i]) {
+            run->delay[run->observed++] = run->rpu_ts[i] - run->apu_ts[i];
+        }
+    }
+    sort(run->delay, run->observed, sizeof(u32), stale_cmp, NULL);
+    
+out:
+    // Don't leave a dirty line behind for the next run
+    stale_maintain(data, STALE_MAINT_CIVAC);
+    stale_unmap_data(data, run->mem);
+    return ret;
+}
+
+static int stale_parse_name(const char *name, const char * const *names, int n)
+{
+    int i;
+    
+    for (i = 0; i < n; i++) {
+        if (!strcmp(name, names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Proc file write handler, "COUNT MEM MAINT GAP_US" starts a run
+ */
+static ssize_t stale_proc_write(struct file *file, const char __user *ubuf,
+                                size_t len, loff_t *ppos)
+{
+    char buf[64], mem[8], maint[8];
+    struct stale_run *run;
+    int ret;
+    
+    if (len >= sizeof(buf)) {
+        return -EINVAL;
+    }
+    if (copy_from_user(buf, ubuf, len)) {
+        return -EFAULT;
+    }
+    buf[len] = '\0';
+    
+    run = vzalloc(sizeof(*run));
+    if (!run) {
+        return -ENOMEM;
+    }
+    
+    if (sscanf(buf, "%u %7s %7s %u", &run->count, mem, maint, &run->gap_us) != 4 ||
+        run->count == 0 || run->count > STALE_MAX_COUNT) {
+        pr_err("%s: Expected \"COUNT MEM MAINT GAP_US\", COUNT up to %d\n",
+               STALE_NAME, STALE_MAX_COUNT);
+        vfree(run);
+        return -EINVAL;
+    }
+    
+    run->mem = stale_parse_name(mem, stale_mem_names, ARRAY_SIZE(stale_mem_names));
+    run->maint = stale_parse_name(maint, stale_maint_names, ARRAY_SIZE(stale_maint_names));
+    if (run->mem < 0 || run->maint < 0) {
+        pr_err("%s: MEM is wb|nc|dev, MAINT is none|clean|civac\n", STALE_NAME);
+        vfree(run);
+        return -EINVAL;
+    }
+    
+    mutex_lock(&stale_lock);
+    ret = stale_do_run(run);
+    if (ret) {
+        vfree(run);
+    } else {
+        vfree(last_run);
+        last_run = run;
+        pr_info("%s: %s/%s, %u of %u values observed\n", STALE_NAME,
+                mem, maint, run->observed, run->count);
+    }
+    mutex_unlock(&stale_lock);
+    
+    return ret ? ret : len;
+}
+
+/*
+ * Proc file read handler, last run as CSV with a '# key=value' header
+ */
+static int stale_proc_show(struct seq_file *m, void *v)
+{
+    struct stale_run *run;
+    u32 i;
+    
+    mutex_lock(&stale_lock);
+    run = last_run;
+    if (!run) {
+        seq_printf(m, "# no run yet, write \"COUNT MEM MAINT GAP_US\" here\n");
+        mutex_unlock(&stale_lock);
+        return 0;
+    }
+    
+    seq_printf(m, "# mem=%s\n", stale_mem_names[run->mem]);
+    seq_printf(m, "# maint=%s\n", stale_maint_names[run->maint]);
+    seq_printf(m, "# count=%u\n", run->count);
+    seq_printf(m, "# gap_us=%u\n", run->gap_us);
+    seq_printf(m, "# observed=%u\n", run->observed);
+    if (run->observed) {
+        seq_printf(m, "# delay_ns_min=%u\n", run->delay[0] * TIMER_NS_PER_TICK);
+        seq_printf(m, "# delay_ns_median=%u\n",
+                   run->delay[run->observed / 2] * TIMER_NS_PER_TICK);
+        seq_printf(m, "# delay_ns_p99=%u\n",
+                   run->delay[(run->observed - 1) * 99 / 100] * TIMER_NS_PER_TICK);
+        seq_printf(m, "# delay_ns_max=%u\n",
+                   run->delay[run->observed - 1] * TIMER_NS_PER_TICK);
+    }
+    
+    // Values the RPU never saw (overwritten first) get delay_ns = -1
+    seq_printf(m, "seq,apu_ts,rpu_ts,delay_ns\n");
+    for (i = 0; i < run->count; i++) {
+        if (run->seen[i]) {
+            seq_printf(m, "%u,%u,%u,%u\n", i + 1, run->apu_ts[i], run->rpu_ts[i],
+                       (run->rpu_ts[i] - run->apu_ts[i]) * TIMER_NS_PER_TICK);
+        } else {
+            seq_printf(m, "%u,%u,0,-1\n", i + 1, run->apu_ts[i]);
+        }
+    }
+    
+    mutex_unlock(&stale_lock);
+    return 0;
+}
+
+static int stale_proc_open(struct inode *inode, struct file *file)
+{
+    return single_open_size(file, stale_proc_show, NULL, STALE_MAX_COUNT * 48);
+}
+
+static const struct proc_ops stale_proc_fops = {
+    .proc_open = stale_proc_open,
+    .proc_read = seq_read,
+    .proc_write = stale_proc_write,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+/*
+ * Arch counter ticks to ns
+ */
+static inline u32 sender_cnt_ns(u64 ticks, u32 cntfrq)
+{
+    return (u32)div_u64(ticks * NSEC_PER_SEC, cntfrq);
+}
+
+/*
+ * One packet, the same steps as send_packet() in apu_sender_ddr
+ */
+static int sender_packet(void __iomem *win, const u8 *payload, u32 seq,
+                         struct sender_packet *p, int mode, u32 cntfrq)
+{
+    u64 t0, t1, t2, deadline;
+    unsigned long flags = 0;
+    int ret = 0;
+    
+    if (mode == SENDER_IRQ_OFF) {
+        local_irq_save(flags);
+    } else {
+        preempt_disable();
+    }
+    
+    t0 = __arch_counter_get_cntvct();
+    p->start_ttc = readl_relaxed(ttc0 + TTC0_CNT_VAL);
+    memcpy_toio(win + PAYLOAD_OFFSET, payload, p->size);
+    t1 = __arch_counter_get_cntvct();
+    
+    writel_relaxed(p->size, win + 4);
+    writel_relaxed(readl_relaxed(ttc0 + TTC0_CNT_VAL), win + 8);
+    writel_relaxed(seq << FLAG_SEQ_SHIFT, win + 12);
+    
+    // writel() orders everything above before the doorbell
+    writel(MAGIC_START, win);
+    
+    deadline = t0 + div_u64((u64)cntfrq * SENDER_ACK_TIMEOUT_US, USEC_PER_SEC);
+    do {
+        t2 = __arch_counter_get_cntvct();
+        if (readl_relaxed(win) == MAGIC_ACK) {
+            break;
+        }
+        cpu_relax();
+    } while (t2 < deadline);
+    
+    if (readl_relaxed(win) != MAGIC_ACK) {
+        ret = -ETIMEDOUT;
+    }
+    
+    if (mode == SENDER_IRQ_OFF) {
+        local_irq_restore(flags);
+    } else {
+        preempt_enable();
+    }
+    
+    p->copy_ns = sender_cnt_ns(t1 - t0, cntfrq);
+    p->roundtrip_ns = sender_cnt_ns(t2 - t0, cntfrq);
+    return ret;
+}
+
+/*
+ * Hand the resident RPU a run descriptor, same layout as run_desc_t
+ */
+static int sender_start_run(void __iomem *win, u32 iterations)
+{
+    void __iomem *desc = win + CONFIG_OFFSET;
+    u32 i;
+    
+    writel_relaxed(task_pid_nr(current), desc);
+    writel_relaxed(INVAL_STRAT_AUTO, desc + 4);
+    writel_relaxed(iterations, desc + 8);
+    writel_relaxed(SENDER_NUM_SIZES, desc + 12);
+    for (i = 0; i < SENDER_NUM_SIZES; i++) {
+        writel_relaxed(sender_sizes[i], desc + 16 + i * 4);
+    }
+    writel(MAGIC_CONFIG, win);
+    
+    // The RPU clears its results areas first, give it a second like userspace
+    return wait_ctrl(win, MAGIC_ACK, SENDER_RESULTS_MS);
+}
+
+/*
+ * Whole sweep, rpu_receiver_ddr has to be at MAGIC_READY
+ */
+static int sender_do_run(struct sender_run *run)
+{
+    void __iomem *win;
+    u8 *payload;
+    u32 size_idx, iter, seq = 0, i;
+    u64 t_sweep;
+    int ret;
+    
+    win = ioremap_wc(SHARED_MEM_BASE, SHARED_MEM_SIZE);
+    payload = vmalloc(SENDER_MAX_PAYLOAD);
+    if (!win || !payload) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    for (i = 0; i < SENDER_MAX_PAYLOAD; i++) {
+        payload[i] = (u8)i;
+    }
+    
+    ret = wait_ctrl(win, MAGIC_READY, SENDER_READY_MS);
+    if (ret) {
+        pr_err("%s: RPU not at READY, is rpu_receiver_ddr running?\n", SENDER_NAME);
+        goto out;
+    }
+    ret = sender_start_run(win, run->iterations);
+    if (ret) {
+        pr_err("%s: RPU did not accept the run descriptor\n", SENDER_NAME);
+        goto out;
+    }
+    
+    t_sweep = ktime_get_ns();
+    for (size_idx = 0; size_idx < SENDER_NUM_SIZES; size_idx++) {
+        for (iter = 0; iter < run->iterations; iter++, seq++) {
+            struct sender_packet *p = &run->pkt[seq];
+            
+            p->size = sender_sizes[size_idx];
+            if (sender_packet(win, payload, seq, p, run->mode, run->cntfrq)) {
+                run->failed++;
+            }
+            
+            // The gap is the only place we let the rest of the system run
+            usleep_range(SENDER_GAP_US, SENDER_GAP_US + 10);
+        }
+    }
+    run->sweep_ns = ktime_get_ns() - t_sweep;
+    run->packets = seq;
+    
+    writel(MAGIC_DONE, win);
+    if (wait_ctrl(win, MAGIC_READY, SENDER_RESULTS_MS)) {
+        pr_warn("%s: RPU not back to READY after DONE, reading results anyway\n", SENDER_NAME);
+    }
+    
+    run->count = min_t(u32, readl(win + RESULTS_OFFSET), MAX_RESULTS);
+    for (i = 0; i < run->count; i++) {
+        memcpy_fromio(run->rpu[i], win + RESULTS_OFFSET + 4 + i * RESULT_ENTRY_SIZE,
+                      RESULT_ENTRY_SIZE);
+        memcpy_fromio(run->first_byte[i], win + FIRST_BYTE_OFFSET + i * FIRST_BYTE_ENTRY_SIZE,
+                      FIRST_BYTE_ENTRY_SIZE);
+    }
+    
+out:
+    vfree(payload);
+    if (win) {
+        iounmap(win);
+    }
+    return ret;
+}
+
+/*
+ * Proc file write handler, "ITERATIONS [preempt|irqoff]" runs a sweep
+ */
+static ssize_t sender_proc_write(struct file *file, const char __user *ubuf,
+                                 size_t len, loff_t *ppos)
+{
+    char buf[64], mode[8] = "preempt";
+    struct sender_run *run;
+    int ret;
+    
+    if (len >= sizeof(buf)) {
+        return -EINVAL;
+    }
+    if (copy_from_user(buf, ubuf, len)) {
+        return -EFAULT;
+    }
+    buf[len] = '\0';
+    
+    run = vzalloc(sizeof(*run));
+    if (!run) {
+        return -ENOMEM;
+    }
+    
+    if (sscanf(buf, "%u %7s", &run->iterations, mode) < 1 ||
+        run->iterations == 0 || run->iterations > SENDER_MAX_ITERATIONS) {
+        pr_err("%s: Expected \"ITERATIONS [preempt|irqoff]\", ITERATIONS up to %zu\n",
+               SENDER_NAME, SENDER_MAX_ITERATIONS);
+        vfree(run);
+        return -EINVAL;
+    }
+    
+    run->mode = stale_parse_name(mode, sender_mode_names, ARRAY_SIZE(sender_mode_names));
+    if (run->mode < 0) {
+        pr_err("%s: Mode is preempt or irqoff\n", SENDER_NAME);
+        vfree(run);
+        return -EINVAL;
+    }
+    run->cntfrq = arch_timer_get_cntfrq();
+    
+    mutex_lock(&sender_lock);
+    ret = sender_do_run(run);
+    if (ret) {
+        vfree(run);
+    } else {
+        vfree(sender_last);
+        sender_last = run;
+        pr_info("%s: %u packets (%s), %u without ACK, %u results from the RPU\n",
+                SENDER_NAME, run->packets, mode, run->failed, run->count);
+    }
+    mutex_unlock(&sender_lock);
+    
+    return ret ? ret : len;
+}
+
+/*
+ * Print a duration in ns as µs with three decimals, no FP in here
+ */
+static void sender_print_us(struct seq_file *m, u64 ns)
+{
+    seq_printf(m, ",%llu.%03llu", ns / 1000, ns % 1000);
+}
+
+/*
+ * Proc file read handler, last run in the apu_sender_ddr CSV format
+ */
+static int sender_proc_show(struct seq_file *m, void *v)
+{
+    struct sender_run *run;
+    u32 i;
+    
+    mutex_lock(&sender_lock);
+    run = sender_last;
+    if (!run) {
+        seq_printf(m, "# no run yet, write \"ITERATIONS [preempt|irqoff]\" here\n");
+        mutex_unlock(&sender_lock);
+        return 0;
+    }
+    
+    seq_printf(m, "# timer_freq_mhz=%u.0\n", 1000 / TIMER_NS_PER_TICK);
+    seq_printf(m, "# iterations=%u\n", run->iterations);
+    seq_printf(m, "# mode=plain\n");
+    seq_printf(m, "# sender=kernel\n");
+    seq_printf(m, "# kernel_mode=%s\n", sender_mode_names[run->mode]);
+    seq_printf(m, "# kernel_mem_attr=normal-nc\n");
+    seq_printf(m, "# inval_strategy=auto\n");
+    seq_printf(m, "# sweep_s=%llu.%03llu\n", run->sweep_ns / NSEC_PER_SEC,
+               run->sweep_ns % NSEC_PER_SEC / NSEC_PER_MSEC);
+    seq_printf(m, "# arch_counter_hz=%u\n", run->cntfrq);
+    seq_printf(m, "# packets=%u\n", run->packets);
+    seq_printf(m, "# no_ack=%u\n", run->failed);
+    
+    seq_printf(m, "packet_size,apu_timestamp,rpu_timestamp,delta_ticks,delta_us,ttfb_us,total_us,"
+                  "copy_ns,roundtrip_ns\n");
+    for (i = 0; i < run->count; i++) {
+        u32 *r = run->rpu[i];
+        u32 seq = run->first_byte[i][0];
+        struct sender_packet *p;
+        
+        if (r[4] != RESULT_VALID || seq >= run->packets) {
+            continue;
+        }
+        p = &run->pkt[seq];
+        
+        // ttfb and total from the start of our copy, same as userspace
+        seq_printf(m, "%u,%u,%u,%u", r[0], r[1], r[2], r[3]);
+        sender_print_us(m, (u64)r[3] * TIMER_NS_PER_TICK);
+        sender_print_us(m, (u64)(run->first_byte[i][1] - p->start_ttc) * TIMER_NS_PER_TICK);
+        sender_print_us(m, (u64)(r[2] - p->start_ttc) * TIMER_NS_PER_TICK);
+        seq_printf(m, ",%u,%u\n", p->copy_ns, p->roundtrip_ns);
+    }
+    
+    mutex_unlock(&sender_lock);
+    return 0;
+}
+
+static int sender_proc_open(struct inode *inode, struct file *file)
+{
+    return single_open_size(file, sender_proc_show, NULL, MAX_RESULTS * 112);
+}
+
+static const struct proc_ops sender_proc_fops = {
+    .proc_open = sender_proc_open,
+    .proc_read = seq_read,
+    .proc_write = sender_proc_write,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+/*
+ * Timed mode, needs its control and results pages mapped
+ */
+static void stale_timed_init(void)
+{
+    stale_ctrl = ioremap_wc(STALE_PHYS + STALE_CTRL_OFFSET, PAGE_SIZE);
+    stale_results = ioremap_wc(STALE_PHYS + STALE_RESULTS_OFFSET,
+                               STALE_SIZE - STALE_RESULTS_OFFSET);
+    if (!stale_ctrl || !stale_results) {
+        pr_warn("%s: Can't map the stale-test pages, timed mode disabled\n", MODULE_NAME);
+        return;
+    }
+    
+    stale_entry = proc_create(STALE_NAME, 0644, NULL, &stale_proc_fops);
+    if (!stale_entry) {
+        pr_warn("%s: Failed to create /proc/%s\n", MODULE_NAME, STALE_NAME);
+        return;
+    }
+    
+    pr_info("%s: Timed mode: echo \"COUNT MEM MAINT GAP_US\" > /proc/%s\n",
+            MODULE_NAME, STALE_NAME);
+}
+
+/*
+ * Kernel sender, maps the window itself for every run
+ */
+static void sender_init(void)
+{
+    sender_entry = proc_create(SENDER_NAME, 0644, NULL, &sender_proc_fops);
+    if (!sender_entry) {
+        pr_warn("%s: Failed to create /proc/%s\n", MODULE_NAME, SENDER_NAME);
+        return;
+    }
+    
+    pr_info("%s: Kernel sender: echo \"ITERATIONS [preempt|irqoff]\" > /proc/%s\n",
+            MODULE_NAME, SENDER_NAME);
+}
+
+/*
+ * Timed mode and kernel sender setup, the plain OLD/NEW test doesn't depend on them
+ */
+static void stale_init(void)
+{
+    // Both map the window with ioremap*(), which arm64 refuses for RAM
+    if (window_is_ram(SHARED_MEM_BASE, SHARED_MEM_SIZE)) {
+        pr_warn("%s: Shared window is System RAM, timed mode and kernel sender disabled "
+                "(reserve it no-map, see rpu_window in the device tree)\n", MODULE_NAME);
+        return;
+    }
+    
+    // Both timestamp with TTC0, otherwise they don't share anything
+    ttc0 = ioremap(TTC0_BASE, PAGE_SIZE);
+    if (!ttc0) {
+        pr_warn("%s: Can't map TTC0, timed mode and kernel sender disabled\n", MODULE_NAME);
+        return;
+    }
+    
+    stale_timed_init();
+    sender_init();
+}
+
+static void stale_exit(void)
+{
+    if (sender_entry) {
+        proc_remove(sender_entry);
+    }
+    if (stale_entry) {
+        proc_remove(stale_entry);
+    }
+    if (stale_results) {
+        iounmap(stale_results);
+    }
+    if (stale_ctrl) {
+        iounmap(stale_ctrl);
+    }
+    if (ttc0) {
+        iounmap(ttc0);
+    }
+    vfree(last_run);
+    vfree(sender_last);
+}
+
 /*
  * Module init
  */
@@ -152,6 +924,8 @@ static int __init coherency_init(void)
         return -ENOMEM;
     }
     
+    stale_init();
+    
     pr_info("===========================================\n");
     pr_info("%s: Initialization complete!\n", MODULE_NAME);
     pr_info("%s: Read /proc/%s for test information\n", MODULE_NAME, MODULE_NAME);
@@ -174,6 +948,7 @@ static void __exit coherency_exit(void)
     if (proc_entry) {
         proc_remove(proc_entry);
     }
+    stale_exit();
     
     if (virt_addr) {
         // Show final buffer contents before freeing
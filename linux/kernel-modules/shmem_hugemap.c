@@ -0,0 +1,235 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/atomic.h>
+#include <linux/version.h>
+
+/*
+ * Shared window with 2 MB block mappings
+ *
+ * /dev/mem maps the APU <-> RPU window with 4 KB pages, so a 64 KB payload
+ * plus the results area at +4 MB walk through a lot of TLB entries. This
+ * driver exposes the same carveout as /dev/rpu_shmem and serves faults
+ * with PMD (2 MB block) entries, falling back to 4 KB pages only where a
+ * block doesn't fit. Memory type follows /dev/mem: open with O_SYNC for
+ * the Normal non-cacheable mapping the benchmarks use, without for
+ * cacheable, so -H changes the page size and nothing else.
+ *
+ * Needs CONFIG_TRANSPARENT_HUGEPAGE and THP set to "always" or "madvise"
+ * (/sys/kernel/mm/transparent_hugepage/enabled), otherwise the kernel
+ * never asks for a PMD and everything is 4 KB. /proc/rpu_shmem shows how
+ * many faults were served each way.
+ */
+
+#define MODULE_NAME "rpu_shmem"
+
+/* Carveout, must match SHARED_MEM_BASE/SIZE on both cores */
+static unsigned long shmem_base = 0x3E000000UL;
+static unsigned long shmem_size = 0x00800000UL;
+module_param(shmem_base, ulong, 0444);
+MODULE_PARM_DESC(shmem_base, "Physical base of the shared window (2 MB aligned)");
+module_param(shmem_size, ulong, 0444);
+MODULE_PARM_DESC(shmem_size, "Size of the shared window");
+
+static atomic_t pmd_faults = ATOMIC_INIT(0);
+static atomic_t pte_faults = ATOMIC_INIT(0);
+
+static struct proc_dir_entry *proc_entry;
+
+/*
+ * 4 KB fault, used for whatever part of a mapping can't take a block
+ */
+static vm_fault_t shmem_fault(struct vm_fault *vmf)
+{
+    struct vm_area_struct *vma = vmf->vma;
+    unsigned long off = (vmf->address - vma->vm_start) + (vma->vm_pgoff << PAGE_SHIFT);
+    
+    if (off >= shmem_size) {
+        return VM_FAULT_SIGBUS;
+    }
+    
+    atomic_inc(&pte_faults);
+    return vmf_insert_pfn(vma, vmf->address, (shmem_base + off) >> PAGE_SHIFT);
+}
+
+/*
+ * 2 MB fault, the whole block has to be inside both the VMA and the
+ * carveout and be 2 MB aligned in both address spaces
+ */
+static vm_fault_t shmem_fault_pmd(struct vm_fault *vmf)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    struct vm_area_struct *vma = vmf->vma;
+    unsigned long addr = vmf->address & PMD_MASK;
+    unsigned long off = (addr - vma->vm_start) + (vma->vm_pgoff << PAGE_SHIFT);
+    vm_fault_t ret;
+    
+    if (addr < vma->vm_start || addr + PMD_SIZE > vma->vm_end) {
+        return VM_FAULT_FALLBACK;
+    }
+    if (off + PMD_SIZE > shmem_size || !IS_ALIGNED(shmem_base + off, PMD_SIZE)) {
+        return VM_FAULT_FALLBACK;
+    }
+    
+    ret = vmf_insert_pfn_pmd(vmf, phys_to_pfn_t(shmem_base + off, PFN_DEV),
+                             vmf->flags & FAULT_FLAG_WRITE);
+    if (ret == VM_FAULT_NOPAGE) {
+        atomic_inc(&pmd_faults);
+    }
+    return ret;
+#else
+    return VM_FAULT_FALLBACK;
+#endif
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+static vm_fault_t shmem_huge_fault(struct vm_fault *vmf, unsigned int order)
+{
+    return order == PMD_ORDER ? shmem_fault_pmd(vmf) : VM_FAULT_FALLBACK;
+}
+#else
+static vm_fault_t shmem_huge_fault(struct vm_fault *vmf, enum page_entry_size pe_size)
+{
+    return pe_size == PE_SIZE_PMD ? shmem_fault_pmd(vmf) : VM_FAULT_FALLBACK;
+}
+#endif
+
+static const struct vm_operations_struct shmem_vm_ops = {
+    .fault = shmem_fault,
+    .huge_fault = shmem_huge_fault,
+};
+
+static int shmem_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    unsigned long off = vma->vm_pgoff << PAGE_SHIFT;
+    unsigned long len = vma->vm_end - vma->vm_start;
+    
+    if (off >= shmem_size || len > shmem_size - off) {
+        return -EINVAL;
+    }
+    
+    // Private (COW) mappings of device memory make no sense
+    if (!(vma->vm_flags & VM_SHARED)) {
+        return -EINVAL;
+    }
+    
+    /*
+     * Same attributes /dev/mem gives this carveout. It's System RAM, and
+     * for RAM arm64 /dev/mem turns O_SYNC into Normal-NC (writecombine),
+     * not the Device type pgprot_noncached() would give.
+     */
+    if (file->f_flags & O_SYNC) {
+        vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+    }
+    
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_set(vma, VM_PFNMAP | VM_IO | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE);
+#else
+    vma->vm_flags |= VM_PFNMAP | VM_IO | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE;
+#endif
+    vma->vm_ops = &shmem_vm_ops;
+    return 0;
+}
+
+/*
+ * Pick a 2 MB aligned address when the caller doesn't care, so blocks
+ * actually line up
+ */
+static unsigned long shmem_get_unmapped_area(struct file *file, unsigned long addr,
+                                             unsigned long len, unsigned long pgoff,
+                                             unsigned long flags)
+{
+    return thp_get_unmapped_area(file, addr, len, pgoff, flags);
+}
+
+static const struct file_operations shmem_fops = {
+    .owner = THIS_MODULE,
+    .mmap = shmem_mmap,
+    .get_unmapped_area = shmem_get_unmapped_area,
+};
+
+static struct miscdevice shmem_misc = {
+    .minor = MISC_DYNAMIC_MINOR,
+    .name = MODULE_NAME,
+    .fops = &shmem_fops,
+    .mode = 0600,
+};
+
+/*
+ * Proc file read handler, window and fault counters
+ */
+static int shmem_proc_show(struct seq_file *m, void *v)
+{
+    seq_printf(m, "phys_base: 0x%lx\n", shmem_base);
+    seq_printf(m, "size: %lu\n", shmem_size);
+    seq_printf(m, "pmd_faults: %d\n", atomic_read(&pmd_faults));
+    seq_printf(m, "pte_faults: %d\n", atomic_read(&pte_faults));
+    return 0;
+}
+
+static int shmem_proc_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, shmem_proc_show, NULL);
+}
+
+static const struct proc_ops shmem_proc_fops = {
+    .proc_open = shmem_proc_open,
+    .proc_read = seq_read,
+    .proc_lseek = seq_lseek,
+    .proc_release = single_release,
+};
+
+/*
+ * Module init
+ */
+static int __init shmem_init(void)
+{
+    int ret;
+    
+    if (!IS_ALIGNED(shmem_base, PMD_SIZE)) {
+        pr_warn("%s: Base 0x%lx isn't 2 MB aligned, only 4 KB mappings\n",
+                MODULE_NAME, shmem_base);
+    }
+    
+    ret = misc_register(&shmem_misc);
+    if (ret) {
+        pr_err("%s: Failed to register /dev/%s\n", MODULE_NAME, MODULE_NAME);
+        return ret;
+    }
+    
+    proc_entry = proc_create(MODULE_NAME, 0444, NULL, &shmem_proc_fops);
+    if (!proc_entry) {
+        pr_err("%s: Failed to create /proc/%s\n", MODULE_NAME, MODULE_NAME);
+        misc_deregister(&shmem_misc);
+        return -ENOMEM;
+    }
+    
+    pr_info("%s: /dev/%s maps 0x%lx-0x%lx with 2 MB blocks\n", MODULE_NAME,
+            MODULE_NAME, shmem_base, shmem_base + shmem_size - 1);
+    return 0;
+}
+
+/*
+ * Module cleanup
+ */
+static void __exit shmem_exit(void)
+{
+    proc_remove(proc_entry);
+    misc_deregister(&shmem_misc);
+    pr_info("%s: Module unloaded (%d PMD, %d PTE faults)\n", MODULE_NAME,
+            atomic_read(&pmd_faults), atomic_read(&pte_faults));
+}
+
+module_init(shmem_init);
+module_exit(shmem_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("APU/RPU shared window mapped with 2 MB blocks");
+MODULE_VERSION("1.0");
@@ -78,6 +78,7 @@ echo "[3/5] Deploying APU applications..."
 
 APU_FILES=(
     "apu_perf_test"
+    "apu_sender_ddr"
     "apu_coherency_test"
 )
 
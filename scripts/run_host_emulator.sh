@@ -0,0 +1,83 @@
+#!/bin/bash
+# Run the APU->RPU protocol entirely on the host (no board needed)
+#
+# Builds the RPU emulator and the host-backend APU sender, starts the
+# emulator in the background (like "echo start" to remoteproc), runs the
+# sender, stress-tests the MPSC queue and stops the emulator again. Works on any x86/ARM Linux box with
+# at least 3 free cores (firmware, TTC ticker, sender).
+
+set -e  # Bail out if anything fails
+
+# Basic config, can override with args
+ITERATIONS="${1:-100}"
+OUTPUT_FILE="${2:-host_emulator_results.csv}"
+EMU_ARGS="${EMU_ARGS:-}"   # e.g. EMU_ARGS="-o 200 -l 5" to model cache op cost
+
+# Figure out where everything lives
+PROJECT_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+EMU_DIR="${PROJECT_ROOT}/linux/host-emulator"
+RESULTS_DIR="${PROJECT_ROOT}/results"
+
+echo "========================================="
+echo "Host Emulator Test Execution"
+echo "========================================="
+echo "Iterations:  ${ITERATIONS} per packet size"
+echo "Output:      ${RESULTS_DIR}/${OUTPUT_FILE}"
+echo "Emulator:    ${EMU_ARGS:-no simulated cache cost}"
+echo "========================================="
+echo ""
+
+echo "[1/5] Building emulator..."
+make -C "$EMU_DIR" > /dev/null
+echo "Built!"
+echo ""
+
+echo "[2/5] Starting RPU emulator..."
+mkdir -p "$RESULTS_DIR"
+EMU_LOG="${RESULTS_DIR}/${OUTPUT_FILE%.csv}_rpu.log"
+"${EMU_DIR}/rpu_emu_ddr" $EMU_ARGS > "$EMU_LOG" 2>&1 &
+EMU_PID=$!
+
+# Make sure we don't leave it spinning if something fails
+trap 'kill -TERM $EMU_PID 2>/dev/null || true' EXIT
+sleep 1
+if ! kill -0 $EMU_PID 2>/dev/null; then
+    echo "ERROR: Emulator failed to start, see $EMU_LOG"
+    exit 1
+fi
+echo "  Emulator running (pid $EMU_PID, log: $EMU_LOG)"
+echo ""
+
+echo "[3/5] Running APU sender..."
+cd "$RESULTS_DIR"
+"${EMU_DIR}/apu_sender_ddr_host" "$ITERATIONS" "$OUTPUT_FILE"
+echo ""
+
+echo "[4/5] MPSC stress..."
+# The smallest legal queue is the one most likely to lose entries
+for SLOTS in 16 2; do
+    "${EMU_DIR}/apu_mpsc_sender_host" -p 8 -n 200 -q $SLOTS \
+        "${OUTPUT_FILE%.csv}_mpsc_q${SLOTS}.csv" > "${OUTPUT_FILE%.csv}_mpsc_q${SLOTS}.log"
+    echo "  -q $SLOTS: passed"
+done
+# A single slot can't work, the sender has to refuse it
+if "${EMU_DIR}/apu_mpsc_sender_host" -p 8 -n 200 -q 1 mpsc_q1.csv > /dev/null 2>&1; then
+    echo "ERROR: apu_mpsc_sender accepted a 1-slot queue"
+    exit 1
+fi
+echo "  -q 1: rejected"
+echo ""
+
+echo "[5/5] Stopping emulator..."
+kill -TERM $EMU_PID
+wait $EMU_PID || true
+trap - EXIT
+
+# Cache hook statistics end up at the bottom of the log
+sed -n '/Cache maintenance hook statistics/,$p' "$EMU_LOG"
+echo ""
+
+echo "========================================="
+echo "Done! Analyze with:"
+echo "  python3 analysis/analyze_performance.py ${RESULTS_DIR}/${OUTPUT_FILE}"
+echo "========================================="
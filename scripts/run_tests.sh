@@ -4,8 +4,16 @@ set -e  # Bail out if anything fails
 BOARD_IP="${1:-${BOARD_IP:-192.168.1.100}}"
 BOARD_USER="${BOARD_USER:-root}"
 ITERATIONS="${2:-100}"
-OUTPUT_FILE="performance_results.csv"
 FIRMWARE_NAME="rpu_perf_test.elf"
+SENDER="apu_sender_ddr"
+
+# Configurations to run back to back in one RPU boot, "name=sender options"
+# separated by ';'. Each one ends up in <name>.csv.
+CONFIGS="${CONFIGS:-baseline=;range=-I range;full=-I full;nbuf2=-b 2;ipi=-w ipi}"
+
+# Control word of the shared window, MAGIC_READY once the firmware is up
+CONTROL_WORD="0x3E000000"
+MAGIC_READY="0xAAAAAAAA"
 
 # Figure out where everything lives
 PROJECT_ROOT="$(cd "$(dirname "$0")/.." && pwd)"
@@ -15,9 +23,9 @@ echo "========================================="
 echo "Performance Test Execution"
 echo "========================================="
 echo "Target:      ${BOARD_USER}@${BOARD_IP}"
-echo "Firmware:    ${FIRMWARE_NAME}"
+echo "Firmware:    ${FIRMWARE_NAME} (resident, one boot)"
 echo "Iterations:  ${ITERATIONS} per packet size"
-echo "Output:      ${OUTPUT_FILE}"
+echo "Configs:     ${CONFIGS}"
 echo "========================================="
 echo ""
 
@@ -33,7 +41,7 @@ echo ""
 
 # Check if we already deployed the binaries
 echo "[2/6] Verifying deployment..."
-CHECK_CMD="test -f /lib/firmware/${FIRMWARE_NAME} && test -f /home/root/apu_perf_test && echo OK || echo MISSING"
+CHECK_CMD="test -f /lib/firmware/${FIRMWARE_NAME} && test -f /home/root/${SENDER} && echo OK || echo MISSING"
 if ! ssh "${BOARD_USER}@${BOARD_IP}" "$CHECK_CMD" | grep -q "OK"; then
     echo "ERROR: Required files not found on board"
     echo "Please run: ./scripts/deploy.sh"
@@ -69,114 +77,117 @@ fi
 echo "RPU ready!"
 echo ""
 
-# Load our firmware and start the RPU
+# Load our firmware and start the RPU, once for every configuration
 echo "[4/6] Loading RPU firmware..."
-ssh "${BOARD_USER}@${BOARD_IP}" << EOSSH
+BOOT_S=$(ssh "${BOARD_USER}@${BOARD_IP}" << EOSSH
 # Tell remoteproc which firmware to use
 echo "${FIRMWARE_NAME}" > /sys/class/remoteproc/remoteproc0/firmware
 
-# Fire it up
+# A READY left over from the last firmware would end the wait below at once
+if command -v devmem > /dev/null; then
+    devmem ${CONTROL_WORD} 32 0
+fi
+
+# Fire it up, and time it until the firmware reports READY (calibration included)
+START=\$(date +%s.%N)
 echo start > /sys/class/remoteproc/remoteproc0/state
 
-# Give it a moment to initialize
-sleep 2
+if command -v devmem > /dev/null; then
+    for i in \$(seq 1 300); do
+        [ "\$(devmem ${CONTROL_WORD} 32)" = "${MAGIC_READY}" ] && break
+        sleep 0.01
+    done
+else
+    # No devmem, fall back to a fixed wait
+    sleep 2
+fi
+END=\$(date +%s.%N)
+
 STATE=\$(cat /sys/class/remoteproc/remoteproc0/state)
 if [ "\$STATE" != "running" ]; then
-    echo "ERROR: RPU failed to start (state: \$STATE)"
-    echo "Check dmesg for errors:"
-    dmesg | tail -20 | grep -i remoteproc
+    echo "ERROR: RPU failed to start (state: \$STATE)" >&2
+    dmesg | tail -20 | grep -i remoteproc >&2
     exit 1
 fi
 
-echo "  RPU state: \$STATE"
-echo "  RPU firmware loaded and running!"
+echo "\$END \$START" | awk '{printf "%.3f", \$1 - \$2}'
 EOSSH
-
-if [ $? -ne 0 ]; then
+) || {
     echo "ERROR: Failed to start RPU"
     echo "Possible causes:"
     echo "  1. Firmware binary incompatible with platform"
     echo "  2. Memory regions not available"
     echo "  3. Permission issues"
     exit 1
-fi
+}
+echo "  RPU firmware running, boot + calibration took ${BOOT_S} s"
 echo ""
 
-# Now run the actual test from APU side
-echo "[5/6] Running APU performance test..."
-echo "This will take several minutes (14 packet sizes × ${ITERATIONS} iterations)..."
+# Every configuration against the same boot, the firmware goes back to READY after each
+echo "[5/6] Running configurations..."
+echo "Each one takes a few minutes (14 packet sizes x ${ITERATIONS} iterations)..."
 echo ""
 
-ssh "${BOARD_USER}@${BOARD_IP}" << EOSSH
-cd /home/root
-
-# Execute the test
-sudo ./apu_perf_test ${ITERATIONS} ${OUTPUT_FILE}
-
-# Make sure we got results
-if [ ! -f ${OUTPUT_FILE} ]; then
-    echo "ERROR: Results file not generated"
-    exit 1
-fi
-
-# Quick summary
-LINES=\$(wc -l < ${OUTPUT_FILE})
-echo ""
-echo "Test complete!"
-echo "Results: ${OUTPUT_FILE} (\$LINES lines)"
-EOSSH
-
-if [ $? -ne 0 ]; then
-    echo "ERROR: Test execution failed"
-    echo "Check RPU console output for errors"
-    exit 1
-fi
-echo ""
-
-# Pull results back to our machine
-echo "[6/6] Retrieving results..."
-mkdir -p "$RESULTS_DIR"
-TIMESTAMP=$(date +%Y%m%d_%H%M%S)
-LOCAL_FILE="${RESULTS_DIR}/${OUTPUT_FILE%.csv}_${TIMESTAMP}.csv"
-
-scp "${BOARD_USER}@${BOARD_IP}:/home/root/${OUTPUT_FILE}" "$LOCAL_FILE"
-
-if [ -f "$LOCAL_FILE" ]; then
-    LINES=$(wc -l < "$LOCAL_FILE")
-    SIZE=$(du -h "$LOCAL_FILE" | cut -f1)
-    echo "Results saved to: $LOCAL_FILE"
-    echo "  Lines: $LINES"
-    echo "  Size:  $SIZE"
-    
-    # Keep a "latest" version for convenience
-    cp "$LOCAL_FILE" "${RESULTS_DIR}/${OUTPUT_FILE}"
-    echo "  Copied to: ${RESULTS_DIR}/${OUTPUT_FILE}"
-else
-    echo "ERROR: Failed to retrieve results"
-    exit 1
-fi
+RUN_DIR="${RESULTS_DIR}/run_$(date +%Y%m%d_%H%M%S)"
+mkdir -p "$RUN_DIR"
+SUMMARY="${RUN_DIR}/summary.csv"
+echo "config,options,wall_s,setup_s,sweep_s" > "$SUMMARY"
+COMPARE_ARGS=""
+
+IFS=';' read -ra CONFIG_LIST <<< "$CONFIGS"
+for CONFIG in "${CONFIG_LIST[@]}"; do
+    NAME="${CONFIG%%=*}"
+    OPTIONS="${CONFIG#*=}"
+    echo "--- ${NAME}: ${SENDER} ${OPTIONS} ${ITERATIONS} ${NAME}.csv"
+
+    START=$(date +%s.%N)
+    if ! ssh "${BOARD_USER}@${BOARD_IP}" "cd /home/root && sudo ./${SENDER} ${OPTIONS} ${ITERATIONS} ${NAME}.csv" \
+            > "${RUN_DIR}/${NAME}.log" 2>&1; then
+        echo "ERROR: ${NAME} failed, see ${RUN_DIR}/${NAME}.log"
+        echo "Check RPU console output for errors"
+        exit 1
+    fi
+    END=$(date +%s.%N)
+
+    # Result files: the CSV plus whatever siblings the options produced
+    scp -q "${BOARD_USER}@${BOARD_IP}:/home/root/${NAME}*.csv" "$RUN_DIR/"
+
+    WALL=$(echo "$END $START" | awk '{printf "%.3f", $1 - $2}')
+    SETUP=$(sed -n 's/^# setup_s=//p' "${RUN_DIR}/${NAME}.csv")
+    SWEEP=$(sed -n 's/^# sweep_s=//p' "${RUN_DIR}/${NAME}.csv")
+    echo "${NAME},\"${OPTIONS}\",${WALL},${SETUP},${SWEEP}" >> "$SUMMARY"
+    COMPARE_ARGS="${COMPARE_ARGS} ${NAME}=${RUN_DIR}/${NAME}.csv"
+    echo "  done in ${WALL} s (setup ${SETUP} s, sweep ${SWEEP} s)"
+done
 echo ""
 
-# Clean shutdown of RPU
-echo "Stopping RPU..."
+# Clean shutdown: stop the server loop, then the RPU
+echo "[6/6] Stopping RPU..."
+ssh "${BOARD_USER}@${BOARD_IP}" "cd /home/root && sudo ./${SENDER} -S" > /dev/null || true
 ssh "${BOARD_USER}@${BOARD_IP}" "echo stop > /sys/class/remoteproc/remoteproc0/state" || true
 echo ""
 
+TOTAL_S=$(awk -F, 'NR > 1 { t += $3 } END { printf "%.3f", t }' "$SUMMARY")
+
 # All done, tell the user what to do next
 echo "========================================="
 echo "Test Execution Complete!"
 echo "========================================="
 echo ""
-echo "Results file: $LOCAL_FILE"
+echo "Results:             ${RUN_DIR}/"
+echo "RPU boot (once):     ${BOOT_S} s"
+echo "Configurations:      ${TOTAL_S} s, boot not included"
+echo "Per configuration:   ${SUMMARY}"
 echo ""
 echo "Next steps:"
 echo "  1. Analyze results:"
 echo "     cd ${PROJECT_ROOT}/analysis"
-echo "     python3 analyze_performance.py ${LOCAL_FILE} output/"
+echo "     python3 analyze_performance.py ${RUN_DIR}/baseline.csv --output-prefix output/baseline"
+echo "     python3 compare_configs.py${COMPARE_ARGS} --output-prefix output/configs"
 echo ""
 echo "  2. View plots in: output/"
 echo ""
-echo "  3. Re-run test with different iterations:"
-echo "     ./scripts/run_tests.sh ${BOARD_IP} 200"
+echo "  3. Re-run with other configurations:"
+echo "     CONFIGS=\"wb=-m wb;lanes=-b 2 -q 1000\" ./scripts/run_tests.sh ${BOARD_IP} 200"
 echo ""
-echo "========================================="
\ No newline at end of file
+echo "========================================="